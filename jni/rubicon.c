@@ -1,5 +1,9 @@
 #include <jni.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "python2.7/Python.h"
 
@@ -99,820 +103,4219 @@ PyMODINIT_FUNC initandroid(void) {
  **************************************************************************
  *************************************************************************/
 
-// The JNIEnv associated with the Python runtime
-JNIEnv *java = NULL;
+// The Java VM hosting the Python runtime
+static JavaVM *jvm = NULL;
+
+// The JNIEnv associated with the current thread
+static __thread JNIEnv *thread_env = NULL;
+
+// A key whose destructor detaches threads that Rubicon attached to the JVM
+static pthread_key_t detach_key;
+
+// The Python thread state of the thread that started the Python runtime
+static PyThreadState *main_thread_state = NULL;
 
 // The Python method dispatch handler
 static PyObject *method_handler = NULL;
 
+// The Python batch dispatch handler
+static PyObject *batch_handler = NULL;
+
+// The Python handler that assigns dispatch slots to interface methods
+static PyObject *slot_handler = NULL;
+
+/**************************************************************************
+ * Per-thread JNIEnv management.
+ *
+ * A JNIEnv is only valid on the thread that it was issued to, so the
+ * wrappers below look up the JNIEnv for the calling thread. Threads that
+ * aren't already known to the JVM (e.g., threads started by Python) are
+ * attached the first time they use Java, and detached when they exit.
+ *
+ * If a JNIEnv can't be obtained, there is no way to report the failure
+ * through the wrappers (or to Python), so the process is aborted.
+ *************************************************************************/
+static void detach_thread(void *value) {
+    if (jvm) {
+        LOG_D("Detaching thread from JVM");
+        (*jvm)->DetachCurrentThread(jvm);
+    }
+    thread_env = NULL;
+}
+
+static JNIEnv *java_env(void) {
+    JNIEnv *env = thread_env;
+    jint ret;
+
+    if (env == NULL) {
+        ret = (*jvm)->GetEnv(jvm, (void **)&env, JNI_VERSION_1_6);
+        if (ret == JNI_EDETACHED) {
+            LOG_D("Attaching thread to JVM");
+#ifdef ANDROID
+            ret = (*jvm)->AttachCurrentThread(jvm, &env, NULL);
+#else
+            ret = (*jvm)->AttachCurrentThread(jvm, (void **)&env, NULL);
+#endif
+            if (ret != JNI_OK) {
+                LOG_E("Unable to attach thread to JVM (error %d)", (int) ret);
+                fflush(stdout);
+                abort();
+            }
+            // Any non-NULL value will cause the detach destructor to be invoked.
+            pthread_setspecific(detach_key, env);
+        } else if (ret != JNI_OK) {
+            LOG_E("Unable to get JNIEnv for thread (error %d)", (int) ret);
+            fflush(stdout);
+            abort();
+        }
+        thread_env = env;
+    }
+    return env;
+}
+
+/**************************************************************************
+ * Cache of the Java classes, methods and fields used by the bridge itself.
+ *
+ * These are resolved once, when the library is loaded by the JVM, and
+ * held as global references; this means the callback path never needs to
+ * perform a class, method or field lookup.
+ *************************************************************************/
+static struct {
+    jclass Python;
+    jmethodID Python__track;
+    jmethodID Python__getSignature;
+
+    jclass PythonInstance;
+    jfieldID PythonInstance__instance;
+    jmethodID PythonInstance__stopDispatcher;
+
+    jclass Method;
+    jmethodID Method__getName;
+    jmethodID Method__getReturnType;
+    jmethodID Method__getParameterTypes;
+
+    jclass String;
+    jmethodID String__intern;
+
+    jclass ByteBuffer;
+    jmethodID ByteBuffer__asReadOnlyBuffer;
+
+    jclass RuntimeException;
+
+    jclass Void__TYPE;
+} reflect;
+
+/**************************************************************************
+ * Descriptions of the Java primitive types, and the classes that are used
+ * to box them.
+ *************************************************************************/
+typedef struct {
+    // The JNI type code for the primitive
+    char type;
+    // The name of the class used to box the primitive
+    const char *box_name;
+    // The name of the method used to unbox the primitive
+    const char *value_name;
+
+    // The class used to box the primitive (e.g., java.lang.Integer)
+    jclass box;
+    // The class representing the primitive itself (e.g., Integer.TYPE)
+    jclass primitive;
+    // The static factory used to box a primitive value (e.g., Integer.valueOf)
+    jmethodID valueOf;
+    // The method used to unbox a primitive value (e.g., Integer.intValue)
+    jmethodID value;
+} PrimitiveType;
+
+static PrimitiveType primitive_types[] = {
+    {'Z', "java/lang/Boolean", "booleanValue"},
+    {'B', "java/lang/Byte", "byteValue"},
+    {'C', "java/lang/Character", "charValue"},
+    {'S', "java/lang/Short", "shortValue"},
+    {'I', "java/lang/Integer", "intValue"},
+    {'J', "java/lang/Long", "longValue"},
+    {'F', "java/lang/Float", "floatValue"},
+    {'D', "java/lang/Double", "doubleValue"},
+    {0, NULL, NULL}
+};
+
+static PrimitiveType *primitive_type(char type) {
+    PrimitiveType *primitive;
+    for (primitive = primitive_types; primitive->type; primitive++) {
+        if (primitive->type == type) {
+            return primitive;
+        }
+    }
+    return NULL;
+}
+
+static jclass cache_primitive_class(JNIEnv *env, jclass box) {
+    jfieldID TYPE;
+    jobject local;
+    jclass global;
+
+    TYPE = (*env)->GetStaticFieldID(env, box, "TYPE", "Ljava/lang/Class;");
+    if (TYPE == NULL) {
+        LOG_E("Couldn't find TYPE field on boxing class");
+        return NULL;
+    }
+    local = (*env)->GetStaticObjectField(env, box, TYPE);
+    global = (*env)->NewGlobalRef(env, local);
+    (*env)->DeleteLocalRef(env, local);
+    return global;
+}
+
+static jclass cache_class(JNIEnv *env, const char *name) {
+    jclass local;
+    jclass global;
+
+    local = (*env)->FindClass(env, name);
+    if (local == NULL) {
+        LOG_E("Couldn't find Java class %s", name);
+        return NULL;
+    }
+    global = (*env)->NewGlobalRef(env, local);
+    (*env)->DeleteLocalRef(env, local);
+    if (global == NULL) {
+        LOG_E("Unable to create global reference to class %s", name);
+    }
+    return global;
+}
+
+JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *reserved) {
+    JNIEnv *env;
+    jclass Void;
+    PrimitiveType *primitive;
+    char signature[64];
+
+    if ((*vm)->GetEnv(vm, (void **)&env, JNI_VERSION_1_6) != JNI_OK) {
+        LOG_E("Unable to get JNIEnv for the Rubicon library");
+        return JNI_ERR;
+    }
+    jvm = vm;
+
+    if (pthread_key_create(&detach_key, detach_thread) != 0) {
+        LOG_E("Unable to create thread detach key");
+        return JNI_ERR;
+    }
+
+    reflect.Python = cache_class(env, "org/pybee/rubicon/Python");
+    if (reflect.Python == NULL) {
+        return JNI_ERR;
+    }
+    reflect.Python__track = (*env)->GetStaticMethodID(env, reflect.Python, "track", "(Ljava/lang/Object;J)V");
+    if (reflect.Python__track == NULL) {
+        LOG_E("Couldn't find method Python.track");
+        return JNI_ERR;
+    }
+    reflect.Python__getSignature = (*env)->GetStaticMethodID(env, reflect.Python, "getSignature", "(Ljava/lang/reflect/Method;)Ljava/lang/String;");
+    if (reflect.Python__getSignature == NULL) {
+        LOG_E("Couldn't find method Python.getSignature");
+        return JNI_ERR;
+    }
+
+    reflect.PythonInstance = cache_class(env, "org/pybee/rubicon/PythonInstance");
+    if (reflect.PythonInstance == NULL) {
+        return JNI_ERR;
+    }
+    reflect.PythonInstance__instance = (*env)->GetFieldID(env, reflect.PythonInstance, "instance", "J");
+    if (reflect.PythonInstance__instance == NULL) {
+        LOG_E("Couldn't find field PythonInstance.instance");
+        return JNI_ERR;
+    }
+    reflect.PythonInstance__stopDispatcher = (*env)->GetStaticMethodID(env, reflect.PythonInstance, "stopDispatcher", "()V");
+    if (reflect.PythonInstance__stopDispatcher == NULL) {
+        LOG_E("Couldn't find method PythonInstance.stopDispatcher");
+        return JNI_ERR;
+    }
+
+    reflect.Method = cache_class(env, "java/lang/reflect/Method");
+    if (reflect.Method == NULL) {
+        return JNI_ERR;
+    }
+    reflect.Method__getName = (*env)->GetMethodID(env, reflect.Method, "getName", "()Ljava/lang/String;");
+    if (reflect.Method__getName == NULL) {
+        LOG_E("Couldn't find method Method.getName");
+        return JNI_ERR;
+    }
+    reflect.Method__getReturnType = (*env)->GetMethodID(env, reflect.Method, "getReturnType", "()Ljava/lang/Class;");
+    if (reflect.Method__getReturnType == NULL) {
+        LOG_E("Couldn't find method Method.getReturnType");
+        return JNI_ERR;
+    }
+    reflect.Method__getParameterTypes = (*env)->GetMethodID(env, reflect.Method, "getParameterTypes", "()[Ljava/lang/Class;");
+    if (reflect.Method__getParameterTypes == NULL) {
+        LOG_E("Couldn't find method Method.getParameterTypes");
+        return JNI_ERR;
+    }
+
+    reflect.String = cache_class(env, "java/lang/String");
+    if (reflect.String == NULL) {
+        return JNI_ERR;
+    }
+    reflect.String__intern = (*env)->GetMethodID(env, reflect.String, "intern", "()Ljava/lang/String;");
+    if (reflect.String__intern == NULL) {
+        LOG_E("Couldn't find method String.intern");
+        return JNI_ERR;
+    }
+
+    reflect.ByteBuffer = cache_class(env, "java/nio/ByteBuffer");
+    if (reflect.ByteBuffer == NULL) {
+        return JNI_ERR;
+    }
+    reflect.ByteBuffer__asReadOnlyBuffer = (*env)->GetMethodID(env, reflect.ByteBuffer, "asReadOnlyBuffer", "()Ljava/nio/ByteBuffer;");
+    if (reflect.ByteBuffer__asReadOnlyBuffer == NULL) {
+        LOG_E("Couldn't find method ByteBuffer.asReadOnlyBuffer");
+        return JNI_ERR;
+    }
+
+    reflect.RuntimeException = cache_class(env, "java/lang/RuntimeException");
+    if (reflect.RuntimeException == NULL) {
+        return JNI_ERR;
+    }
+
+    Void = cache_class(env, "java/lang/Void");
+    if (Void == NULL) {
+        return JNI_ERR;
+    }
+    reflect.Void__TYPE = cache_primitive_class(env, Void);
+    (*env)->DeleteGlobalRef(env, Void);
+    if (reflect.Void__TYPE == NULL) {
+        return JNI_ERR;
+    }
+
+    for (primitive = primitive_types; primitive->type; primitive++) {
+        primitive->box = cache_class(env, primitive->box_name);
+        if (primitive->box == NULL) {
+            return JNI_ERR;
+        }
+        primitive->primitive = cache_primitive_class(env, primitive->box);
+        if (primitive->primitive == NULL) {
+            return JNI_ERR;
+        }
+        sprintf(signature, "(%c)L%s;", primitive->type, primitive->box_name);
+        primitive->valueOf = (*env)->GetStaticMethodID(env, primitive->box, "valueOf", signature);
+        if (primitive->valueOf == NULL) {
+            LOG_E("Couldn't find method %s.valueOf", primitive->box_name);
+            return JNI_ERR;
+        }
+        sprintf(signature, "()%c", primitive->type);
+        primitive->value = (*env)->GetMethodID(env, primitive->box, primitive->value_name, signature);
+        if (primitive->value == NULL) {
+            LOG_E("Couldn't find method %s.%s", primitive->box_name, primitive->value_name);
+            return JNI_ERR;
+        }
+    }
+
+    return JNI_VERSION_1_6;
+}
+
+JNIEXPORT void JNICALL JNI_OnUnload(JavaVM *vm, void *reserved) {
+    JNIEnv *env;
+    PrimitiveType *primitive;
+
+    if ((*vm)->GetEnv(vm, (void **)&env, JNI_VERSION_1_6) != JNI_OK) {
+        return;
+    }
+
+    if (reflect.Python) {
+        (*env)->DeleteGlobalRef(env, reflect.Python);
+    }
+    if (reflect.PythonInstance) {
+        (*env)->DeleteGlobalRef(env, reflect.PythonInstance);
+    }
+    if (reflect.Method) {
+        (*env)->DeleteGlobalRef(env, reflect.Method);
+    }
+    if (reflect.String) {
+        (*env)->DeleteGlobalRef(env, reflect.String);
+    }
+    if (reflect.ByteBuffer) {
+        (*env)->DeleteGlobalRef(env, reflect.ByteBuffer);
+    }
+    if (reflect.RuntimeException) {
+        (*env)->DeleteGlobalRef(env, reflect.RuntimeException);
+    }
+    if (reflect.Void__TYPE) {
+        (*env)->DeleteGlobalRef(env, reflect.Void__TYPE);
+    }
+    memset(&reflect, 0, sizeof(reflect));
+
+    for (primitive = primitive_types; primitive->type; primitive++) {
+        if (primitive->box) {
+            (*env)->DeleteGlobalRef(env, primitive->box);
+        }
+        if (primitive->primitive) {
+            (*env)->DeleteGlobalRef(env, primitive->primitive);
+        }
+        primitive->box = NULL;
+        primitive->primitive = NULL;
+        primitive->valueOf = NULL;
+        primitive->value = NULL;
+    }
+
+    pthread_key_delete(detach_key);
+    jvm = NULL;
+}
+
 /**************************************************************************
  * Wrappers around JNI methods, bound to the JNIEnv associated with the
- * Python runtime.
+ * calling thread.
  *
  * These methods should not be invoked until the Python runtime
  * has been started.
  *************************************************************************/
 jint GetVersion() {
-    return (*java)->GetVersion(java);
+    JNIEnv *env = java_env();
+    return (*env)->GetVersion(env);
 }
 jclass DefineClass(const char *name, jobject loader, const jbyte *buf, jsize len) {
-    return (*java)->DefineClass(java, name, loader, buf, len);
+    JNIEnv *env = java_env();
+    return (*env)->DefineClass(env, name, loader, buf, len);
 }
 jclass FindClass(const char *name) {
-    return (*java)->FindClass(java, name);
+    JNIEnv *env = java_env();
+    return (*env)->FindClass(env, name);
 }
 jmethodID FromReflectedMethod(jobject method) {
-    return (*java)->FromReflectedMethod(java, method);
+    JNIEnv *env = java_env();
+    return (*env)->FromReflectedMethod(env, method);
 }
 jfieldID FromReflectedField(jobject field) {
-    return (*java)->FromReflectedField(java, field);
+    JNIEnv *env = java_env();
+    return (*env)->FromReflectedField(env, field);
 }
 
 jobject ToReflectedMethod(jclass cls, jmethodID methodID, jboolean isStatic) {
-    return (*java)->ToReflectedMethod(java, cls, methodID, isStatic);
+    JNIEnv *env = java_env();
+    return (*env)->ToReflectedMethod(env, cls, methodID, isStatic);
 }
 
 jclass GetSuperclass(jclass sub) {
-    return (*java)->GetSuperclass(java, sub);
+    JNIEnv *env = java_env();
+    return (*env)->GetSuperclass(env, sub);
 }
 jboolean IsAssignableFrom(jclass sub, jclass sup) {
-    return (*java)->IsAssignableFrom(java, sub, sup);
+    JNIEnv *env = java_env();
+    return (*env)->IsAssignableFrom(env, sub, sup);
 }
 
 jobject ToReflectedField(jclass cls, jfieldID fieldID, jboolean isStatic) {
-    return (*java)->ToReflectedField(java, cls, fieldID, isStatic);
+    JNIEnv *env = java_env();
+    return (*env)->ToReflectedField(env, cls, fieldID, isStatic);
 }
 
 jint Throw(jthrowable obj) {
-    return (*java)->Throw(java, obj);
+    JNIEnv *env = java_env();
+    return (*env)->Throw(env, obj);
 }
 jint ThrowNew(jclass cls, const char *msg) {
-    return (*java)->ThrowNew(java, cls, msg);
+    JNIEnv *env = java_env();
+    return (*env)->ThrowNew(env, cls, msg);
 }
 jthrowable ExceptionOccurred() {
-    return (*java)->ExceptionOccurred(java);
+    JNIEnv *env = java_env();
+    return (*env)->ExceptionOccurred(env);
 }
 void ExceptionDescribe() {
-    (*java)->ExceptionDescribe(java);
+    JNIEnv *env = java_env();
+    (*env)->ExceptionDescribe(env);
 }
 void ExceptionClear() {
-    (*java)->ExceptionClear(java);
+    JNIEnv *env = java_env();
+    (*env)->ExceptionClear(env);
 }
 void FatalError(const char *msg) {
-    (*java)->FatalError(java, msg);
+    JNIEnv *env = java_env();
+    (*env)->FatalError(env, msg);
 }
 
 jint PushLocalFrame(jint capacity) {
-    return (*java)->PushLocalFrame(java, capacity);
+    JNIEnv *env = java_env();
+    return (*env)->PushLocalFrame(env, capacity);
 }
 jobject PopLocalFrame(jobject result) {
-    return (*java)->PopLocalFrame(java, result);
+    JNIEnv *env = java_env();
+    return (*env)->PopLocalFrame(env, result);
 }
 
 jobject NewGlobalRef(jobject lobj) {
-    return (*java)->NewGlobalRef(java, lobj);
+    JNIEnv *env = java_env();
+    return (*env)->NewGlobalRef(env, lobj);
 }
 void DeleteGlobalRef(jobject gref) {
-    (*java)->DeleteGlobalRef(java, gref);
+    JNIEnv *env = java_env();
+    (*env)->DeleteGlobalRef(env, gref);
 }
 void DeleteLocalRef(jobject obj) {
-    (*java)->DeleteLocalRef(java, obj);
+    JNIEnv *env = java_env();
+    (*env)->DeleteLocalRef(env, obj);
 }
 
 jboolean IsSameObject(jobject obj1, jobject obj2) {
-    return (*java)->IsSameObject(java, obj1, obj2);
+    JNIEnv *env = java_env();
+    return (*env)->IsSameObject(env, obj1, obj2);
 }
 
 jobject NewLocalRef(jobject ref) {
-    return (*java)->NewLocalRef(java, ref);
+    JNIEnv *env = java_env();
+    return (*env)->NewLocalRef(env, ref);
 }
 jint EnsureLocalCapacity(jint capacity) {
-    return (*java)->EnsureLocalCapacity(java, capacity);
+    JNIEnv *env = java_env();
+    return (*env)->EnsureLocalCapacity(env, capacity);
 }
 
 jobject AllocObject(jclass cls) {
-    return (*java)->AllocObject(java, cls);
+    JNIEnv *env = java_env();
+    return (*env)->AllocObject(env, cls);
 }
 jobject NewObject(jclass cls, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jobject result;
     va_start(args, methodID);
-    result = (*java)->NewObjectV(java, cls, methodID, args);
+    result = (*env)->NewObjectV(env, cls, methodID, args);
     va_end(args);
     return result;
 }
+jobject NewObjectA(jclass cls, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->NewObjectA(env, cls, methodID, args);
+}
 
 jclass GetObjectClass(jobject obj) {
-    return (*java)->GetObjectClass(java, obj);
+    JNIEnv *env = java_env();
+    return (*env)->GetObjectClass(env, obj);
 }
 jboolean IsInstanceOf(jobject obj, jclass cls) {
-    return (*java)->IsInstanceOf(java,obj,cls);
+    JNIEnv *env = java_env();
+    return (*env)->IsInstanceOf(env,obj,cls);
 }
 
 jmethodID GetMethodID(jclass cls, const char *name, const char *sig) {
-    return (*java)->GetMethodID(java, cls, name, sig);
+    JNIEnv *env = java_env();
+    return (*env)->GetMethodID(env, cls, name, sig);
 }
 
 jobject CallObjectMethod(jobject obj, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jobject result;
     va_start(args, methodID);
-    result = (*java)->CallObjectMethodV(java, obj, methodID, args);
+    result = (*env)->CallObjectMethodV(env, obj, methodID, args);
     va_end(args);
     return result;
 }
 jboolean CallBooleanMethod(jobject obj, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jboolean result;
     va_start(args, methodID);
-    result = (*java)->CallBooleanMethodV(java, obj, methodID, args);
+    result = (*env)->CallBooleanMethodV(env, obj, methodID, args);
     va_end(args);
     return result;
 }
 jbyte CallByteMethod(jobject obj, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jbyte result;
     va_start(args, methodID);
-    result = (*java)->CallByteMethodV(java, obj, methodID, args);
+    result = (*env)->CallByteMethodV(env, obj, methodID, args);
     va_end(args);
     return result;
 }
 jchar CallCharMethod(jobject obj, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jchar result;
     va_start(args, methodID);
-    result = (*java)->CallCharMethodV(java, obj, methodID, args);
+    result = (*env)->CallCharMethodV(env, obj, methodID, args);
     va_end(args);
     return result;
 }
 jshort CallShortMethod(jobject obj, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jshort result;
     va_start(args, methodID);
-    result = (*java)->CallShortMethodV(java, obj, methodID, args);
+    result = (*env)->CallShortMethodV(env, obj, methodID, args);
     va_end(args);
     return result;
 }
 jint CallIntMethod(jobject obj, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jint result;
     va_start(args, methodID);
-    result = (*java)->CallIntMethodV(java, obj, methodID, args);
+    result = (*env)->CallIntMethodV(env, obj, methodID, args);
     va_end(args);
     return result;
 }
 jlong CallLongMethod(jobject obj, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jlong result;
     va_start(args, methodID);
-    result = (*java)->CallLongMethodV(java, obj, methodID, args);
+    result = (*env)->CallLongMethodV(env, obj, methodID, args);
     va_end(args);
     return result;
 }
 jfloat CallFloatMethod(jobject obj, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jfloat result;
     va_start(args, methodID);
-    result = (*java)->CallFloatMethodV(java, obj, methodID, args);
+    result = (*env)->CallFloatMethodV(env, obj, methodID, args);
     va_end(args);
     return result;
 }
 jdouble CallDoubleMethod(jobject obj, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jdouble result;
     va_start(args, methodID);
-    result = (*java)->CallDoubleMethodV(java, obj, methodID, args);
+    result = (*env)->CallDoubleMethodV(env, obj, methodID, args);
     va_end(args);
     return result;
 }
 void CallVoidMethod(jobject obj, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     va_start(args, methodID);
-    (*java)->CallVoidMethodV(java, obj, methodID, args);
+    (*env)->CallVoidMethodV(env, obj, methodID, args);
     va_end(args);
 }
 
+jobject CallObjectMethodA(jobject obj, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->CallObjectMethodA(env, obj, methodID, args);
+}
+jboolean CallBooleanMethodA(jobject obj, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->CallBooleanMethodA(env, obj, methodID, args);
+}
+jbyte CallByteMethodA(jobject obj, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->CallByteMethodA(env, obj, methodID, args);
+}
+jchar CallCharMethodA(jobject obj, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->CallCharMethodA(env, obj, methodID, args);
+}
+jshort CallShortMethodA(jobject obj, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->CallShortMethodA(env, obj, methodID, args);
+}
+jint CallIntMethodA(jobject obj, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->CallIntMethodA(env, obj, methodID, args);
+}
+jlong CallLongMethodA(jobject obj, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->CallLongMethodA(env, obj, methodID, args);
+}
+jfloat CallFloatMethodA(jobject obj, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->CallFloatMethodA(env, obj, methodID, args);
+}
+jdouble CallDoubleMethodA(jobject obj, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->CallDoubleMethodA(env, obj, methodID, args);
+}
+void CallVoidMethodA(jobject obj, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    (*env)->CallVoidMethodA(env, obj, methodID, args);
+}
+
 jobject CallNonvirtualObjectMethod(jobject obj, jclass cls, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jobject result;
     va_start(args, methodID);
-    result = (*java)->CallNonvirtualObjectMethodV(java, obj, cls, methodID, args);
+    result = (*env)->CallNonvirtualObjectMethodV(env, obj, cls, methodID, args);
     va_end(args);
     return result;
 }
 jboolean CallNonvirtualBooleanMethod(jobject obj, jclass cls, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jboolean result;
     va_start(args, methodID);
-    result = (*java)->CallNonvirtualBooleanMethodV(java, obj, cls, methodID, args);
+    result = (*env)->CallNonvirtualBooleanMethodV(env, obj, cls, methodID, args);
     va_end(args);
     return result;
 }
 jbyte CallNonvirtualByteMethod(jobject obj, jclass cls, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jbyte result;
     va_start(args, methodID);
-    result = (*java)->CallNonvirtualByteMethodV(java, obj, cls, methodID, args);
+    result = (*env)->CallNonvirtualByteMethodV(env, obj, cls, methodID, args);
     va_end(args);
     return result;
 }
 jchar CallNonvirtualCharMethod(jobject obj, jclass cls,jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jchar result;
     va_start(args, methodID);
-    result = (*java)->CallNonvirtualCharMethodV(java, obj, cls, methodID, args);
+    result = (*env)->CallNonvirtualCharMethodV(env, obj, cls, methodID, args);
     va_end(args);
     return result;
 }
 jshort CallNonvirtualShortMethod(jobject obj, jclass cls, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jshort result;
     va_start(args, methodID);
-    result = (*java)->CallNonvirtualShortMethodV(java,obj,cls, methodID,args);
+    result = (*env)->CallNonvirtualShortMethodV(env,obj,cls, methodID,args);
     va_end(args);
     return result;
 }
 jint CallNonvirtualIntMethod(jobject obj, jclass cls, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jint result;
     va_start(args, methodID);
-    result = (*java)->CallNonvirtualIntMethodV(java, obj, cls, methodID, args);
+    result = (*env)->CallNonvirtualIntMethodV(env, obj, cls, methodID, args);
     va_end(args);
     return result;
 }
 jlong CallNonvirtualLongMethod(jobject obj, jclass cls, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jlong result;
     va_start(args, methodID);
-    result = (*java)->CallNonvirtualLongMethodV(java,obj,cls, methodID,args);
+    result = (*env)->CallNonvirtualLongMethodV(env,obj,cls, methodID,args);
     va_end(args);
     return result;
 }
 jfloat CallNonvirtualFloatMethod(jobject obj, jclass cls, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jfloat result;
     va_start(args, methodID);
-    result = (*java)->CallNonvirtualFloatMethodV(java,obj,cls, methodID,args);
+    result = (*env)->CallNonvirtualFloatMethodV(env,obj,cls, methodID,args);
     va_end(args);
     return result;
 }
 jdouble CallNonvirtualDoubleMethod(jobject obj, jclass cls, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jdouble result;
     va_start(args, methodID);
-    result = (*java)->CallNonvirtualDoubleMethodV(java,obj,cls, methodID,args);
+    result = (*env)->CallNonvirtualDoubleMethodV(env,obj,cls, methodID,args);
     va_end(args);
     return result;
 }
 void CallNonvirtualVoidMethod(jobject obj, jclass cls, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     va_start(args, methodID);
-    (*java)->CallNonvirtualVoidMethodV(java, obj, cls, methodID, args);
+    (*env)->CallNonvirtualVoidMethodV(env, obj, cls, methodID, args);
     va_end(args);
 }
 
+jobject CallNonvirtualObjectMethodA(jobject obj, jclass cls, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->CallNonvirtualObjectMethodA(env, obj, cls, methodID, args);
+}
+jboolean CallNonvirtualBooleanMethodA(jobject obj, jclass cls, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->CallNonvirtualBooleanMethodA(env, obj, cls, methodID, args);
+}
+jbyte CallNonvirtualByteMethodA(jobject obj, jclass cls, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->CallNonvirtualByteMethodA(env, obj, cls, methodID, args);
+}
+jchar CallNonvirtualCharMethodA(jobject obj, jclass cls, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->CallNonvirtualCharMethodA(env, obj, cls, methodID, args);
+}
+jshort CallNonvirtualShortMethodA(jobject obj, jclass cls, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->CallNonvirtualShortMethodA(env, obj, cls, methodID, args);
+}
+jint CallNonvirtualIntMethodA(jobject obj, jclass cls, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->CallNonvirtualIntMethodA(env, obj, cls, methodID, args);
+}
+jlong CallNonvirtualLongMethodA(jobject obj, jclass cls, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->CallNonvirtualLongMethodA(env, obj, cls, methodID, args);
+}
+jfloat CallNonvirtualFloatMethodA(jobject obj, jclass cls, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->CallNonvirtualFloatMethodA(env, obj, cls, methodID, args);
+}
+jdouble CallNonvirtualDoubleMethodA(jobject obj, jclass cls, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->CallNonvirtualDoubleMethodA(env, obj, cls, methodID, args);
+}
+void CallNonvirtualVoidMethodA(jobject obj, jclass cls, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    (*env)->CallNonvirtualVoidMethodA(env, obj, cls, methodID, args);
+}
+
 jfieldID GetFieldID(jclass cls, const char *name, const char *sig) {
-    return (*java)->GetFieldID(java, cls, name, sig);
+    JNIEnv *env = java_env();
+    return (*env)->GetFieldID(env, cls, name, sig);
 }
 
 jobject GetObjectField(jobject obj, jfieldID fieldID) {
-    return (*java)->GetObjectField(java, obj, fieldID);
+    JNIEnv *env = java_env();
+    return (*env)->GetObjectField(env, obj, fieldID);
 }
 jboolean GetBooleanField(jobject obj, jfieldID fieldID) {
-    return (*java)->GetBooleanField(java, obj, fieldID);
+    JNIEnv *env = java_env();
+    return (*env)->GetBooleanField(env, obj, fieldID);
 }
 jbyte GetByteField(jobject obj, jfieldID fieldID) {
-    return (*java)->GetByteField(java, obj, fieldID);
+    JNIEnv *env = java_env();
+    return (*env)->GetByteField(env, obj, fieldID);
 }
 jchar GetCharField(jobject obj, jfieldID fieldID) {
-    return (*java)->GetCharField(java, obj, fieldID);
+    JNIEnv *env = java_env();
+    return (*env)->GetCharField(env, obj, fieldID);
 }
 jshort GetShortField(jobject obj, jfieldID fieldID) {
-    return (*java)->GetShortField(java, obj, fieldID);
+    JNIEnv *env = java_env();
+    return (*env)->GetShortField(env, obj, fieldID);
 }
 jint GetIntField(jobject obj, jfieldID fieldID) {
-    return (*java)->GetIntField(java, obj, fieldID);
+    JNIEnv *env = java_env();
+    return (*env)->GetIntField(env, obj, fieldID);
 }
 jlong GetLongField(jobject obj, jfieldID fieldID) {
-    return (*java)->GetLongField(java, obj, fieldID);
+    JNIEnv *env = java_env();
+    return (*env)->GetLongField(env, obj, fieldID);
 }
 jfloat GetFloatField(jobject obj, jfieldID fieldID) {
-    return (*java)->GetFloatField(java, obj, fieldID);
+    JNIEnv *env = java_env();
+    return (*env)->GetFloatField(env, obj, fieldID);
 }
 jdouble GetDoubleField(jobject obj, jfieldID fieldID) {
-    return (*java)->GetDoubleField(java, obj, fieldID);
+    JNIEnv *env = java_env();
+    return (*env)->GetDoubleField(env, obj, fieldID);
 }
 
 void SetObjectField(jobject obj, jfieldID fieldID, jobject val) {
-    (*java)->SetObjectField(java, obj, fieldID, val);
+    JNIEnv *env = java_env();
+    (*env)->SetObjectField(env, obj, fieldID, val);
 }
 void SetBooleanField(jobject obj, jfieldID fieldID, jboolean val) {
-    (*java)->SetBooleanField(java, obj, fieldID, val);
+    JNIEnv *env = java_env();
+    (*env)->SetBooleanField(env, obj, fieldID, val);
 }
 void SetByteField(jobject obj, jfieldID fieldID, jbyte val) {
-    (*java)->SetByteField(java, obj, fieldID, val);
+    JNIEnv *env = java_env();
+    (*env)->SetByteField(env, obj, fieldID, val);
 }
 void SetCharField(jobject obj, jfieldID fieldID, jchar val) {
-    (*java)->SetCharField(java, obj, fieldID, val);
+    JNIEnv *env = java_env();
+    (*env)->SetCharField(env, obj, fieldID, val);
 }
 void SetShortField(jobject obj, jfieldID fieldID, jshort val) {
-    (*java)->SetShortField(java, obj, fieldID, val);
+    JNIEnv *env = java_env();
+    (*env)->SetShortField(env, obj, fieldID, val);
 }
 void SetIntField(jobject obj, jfieldID fieldID, jint val) {
-    (*java)->SetIntField(java, obj, fieldID, val);
+    JNIEnv *env = java_env();
+    (*env)->SetIntField(env, obj, fieldID, val);
 }
 void SetLongField(jobject obj, jfieldID fieldID, jlong val) {
-    (*java)->SetLongField(java, obj, fieldID, val);
+    JNIEnv *env = java_env();
+    (*env)->SetLongField(env, obj, fieldID, val);
 }
 void SetFloatField(jobject obj, jfieldID fieldID, jfloat val) {
-    (*java)->SetFloatField(java, obj, fieldID, val);
+    JNIEnv *env = java_env();
+    (*env)->SetFloatField(env, obj, fieldID, val);
 }
 void SetDoubleField(jobject obj, jfieldID fieldID, jdouble val) {
-    (*java)->SetDoubleField(java, obj, fieldID, val);
+    JNIEnv *env = java_env();
+    (*env)->SetDoubleField(env, obj, fieldID, val);
 }
 
 jmethodID GetStaticMethodID(jclass cls, const char *name, const char *sig) {
-    return (*java)->GetStaticMethodID(java, cls, name, sig);
+    JNIEnv *env = java_env();
+    return (*env)->GetStaticMethodID(env, cls, name, sig);
 }
 
 jobject CallStaticObjectMethod(jclass cls, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jobject result;
     va_start(args, methodID);
-    result = (*java)->CallStaticObjectMethodV(java, cls, methodID, args);
+    result = (*env)->CallStaticObjectMethodV(env, cls, methodID, args);
     va_end(args);
     return result;
 }
 jboolean CallStaticBooleanMethod(jclass cls, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jboolean result;
     va_start(args, methodID);
-    result = (*java)->CallStaticBooleanMethodV(java, cls, methodID, args);
+    result = (*env)->CallStaticBooleanMethodV(env, cls, methodID, args);
     va_end(args);
     return result;
 }
 jbyte CallStaticByteMethod(jclass cls, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jbyte result;
     va_start(args, methodID);
-    result = (*java)->CallStaticByteMethodV(java, cls, methodID, args);
+    result = (*env)->CallStaticByteMethodV(env, cls, methodID, args);
     va_end(args);
     return result;
 }
 jchar CallStaticCharMethod(jclass cls, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jchar result;
     va_start(args, methodID);
-    result = (*java)->CallStaticCharMethodV(java, cls, methodID, args);
+    result = (*env)->CallStaticCharMethodV(env, cls, methodID, args);
     va_end(args);
     return result;
 }
 jshort CallStaticShortMethod(jclass cls, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jshort result;
     va_start(args, methodID);
-    result = (*java)->CallStaticShortMethodV(java, cls, methodID, args);
+    result = (*env)->CallStaticShortMethodV(env, cls, methodID, args);
     va_end(args);
     return result;
 }
 jint CallStaticIntMethod(jclass cls, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jint result;
     va_start(args, methodID);
-    result = (*java)->CallStaticIntMethodV(java, cls, methodID, args);
+    result = (*env)->CallStaticIntMethodV(env, cls, methodID, args);
     va_end(args);
     return result;
 }
 jlong CallStaticLongMethod(jclass cls, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jlong result;
     va_start(args, methodID);
-    result = (*java)->CallStaticLongMethodV(java, cls, methodID, args);
+    result = (*env)->CallStaticLongMethodV(env, cls, methodID, args);
     va_end(args);
     return result;
 }
 jfloat CallStaticFloatMethod(jclass cls, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jfloat result;
     va_start(args, methodID);
-    result = (*java)->CallStaticFloatMethodV(java, cls, methodID, args);
+    result = (*env)->CallStaticFloatMethodV(env, cls, methodID, args);
     va_end(args);
     return result;
 }
 jdouble CallStaticDoubleMethod(jclass cls, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     jdouble result;
     va_start(args, methodID);
-    result = (*java)->CallStaticDoubleMethodV(java, cls, methodID, args);
+    result = (*env)->CallStaticDoubleMethodV(env, cls, methodID, args);
     va_end(args);
     return result;
 }
 void CallStaticVoidMethod(jclass cls, jmethodID methodID, ...) {
+    JNIEnv *env = java_env();
     va_list args;
     va_start(args, methodID);
-    (*java)->CallStaticVoidMethodV(java, cls, methodID, args);
+    (*env)->CallStaticVoidMethodV(env, cls, methodID, args);
     va_end(args);
 }
 
+jobject CallStaticObjectMethodA(jclass cls, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->CallStaticObjectMethodA(env, cls, methodID, args);
+}
+jboolean CallStaticBooleanMethodA(jclass cls, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->CallStaticBooleanMethodA(env, cls, methodID, args);
+}
+jbyte CallStaticByteMethodA(jclass cls, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->CallStaticByteMethodA(env, cls, methodID, args);
+}
+jchar CallStaticCharMethodA(jclass cls, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->CallStaticCharMethodA(env, cls, methodID, args);
+}
+jshort CallStaticShortMethodA(jclass cls, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->CallStaticShortMethodA(env, cls, methodID, args);
+}
+jint CallStaticIntMethodA(jclass cls, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->CallStaticIntMethodA(env, cls, methodID, args);
+}
+jlong CallStaticLongMethodA(jclass cls, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->CallStaticLongMethodA(env, cls, methodID, args);
+}
+jfloat CallStaticFloatMethodA(jclass cls, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->CallStaticFloatMethodA(env, cls, methodID, args);
+}
+jdouble CallStaticDoubleMethodA(jclass cls, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    return (*env)->CallStaticDoubleMethodA(env, cls, methodID, args);
+}
+void CallStaticVoidMethodA(jclass cls, jmethodID methodID, const jvalue *args) {
+    JNIEnv *env = java_env();
+    (*env)->CallStaticVoidMethodA(env, cls, methodID, args);
+}
+
 jfieldID GetStaticFieldID(jclass cls, const char *name, const char *sig) {
-    return (*java)->GetStaticFieldID(java, cls, name, sig);
+    JNIEnv *env = java_env();
+    return (*env)->GetStaticFieldID(env, cls, name, sig);
 }
 jobject GetStaticObjectField(jclass cls, jfieldID fieldID) {
-    return (*java)->GetStaticObjectField(java, cls, fieldID);
+    JNIEnv *env = java_env();
+    return (*env)->GetStaticObjectField(env, cls, fieldID);
 }
 jboolean GetStaticBooleanField(jclass cls, jfieldID fieldID) {
-    return (*java)->GetStaticBooleanField(java, cls, fieldID);
+    JNIEnv *env = java_env();
+    return (*env)->GetStaticBooleanField(env, cls, fieldID);
 }
 jbyte GetStaticByteField(jclass cls, jfieldID fieldID) {
-    return (*java)->GetStaticByteField(java, cls, fieldID);
+    JNIEnv *env = java_env();
+    return (*env)->GetStaticByteField(env, cls, fieldID);
 }
 jchar GetStaticCharField(jclass cls, jfieldID fieldID) {
-    return (*java)->GetStaticCharField(java, cls, fieldID);
+    JNIEnv *env = java_env();
+    return (*env)->GetStaticCharField(env, cls, fieldID);
 }
 jshort GetStaticShortField(jclass cls, jfieldID fieldID) {
-    return (*java)->GetStaticShortField(java, cls, fieldID);
+    JNIEnv *env = java_env();
+    return (*env)->GetStaticShortField(env, cls, fieldID);
 }
 jint GetStaticIntField(jclass cls, jfieldID fieldID) {
-    return (*java)->GetStaticIntField(java, cls, fieldID);
+    JNIEnv *env = java_env();
+    return (*env)->GetStaticIntField(env, cls, fieldID);
 }
 jlong GetStaticLongField(jclass cls, jfieldID fieldID) {
-    return (*java)->GetStaticLongField(java, cls, fieldID);
+    JNIEnv *env = java_env();
+    return (*env)->GetStaticLongField(env, cls, fieldID);
 }
 jfloat GetStaticFloatField(jclass cls, jfieldID fieldID) {
-    return (*java)->GetStaticFloatField(java, cls, fieldID);
+    JNIEnv *env = java_env();
+    return (*env)->GetStaticFloatField(env, cls, fieldID);
 }
 jdouble GetStaticDoubleField(jclass cls, jfieldID fieldID) {
-    return (*java)->GetStaticDoubleField(java, cls, fieldID);
+    JNIEnv *env = java_env();
+    return (*env)->GetStaticDoubleField(env, cls, fieldID);
 }
 
 void SetStaticObjectField(jclass cls, jfieldID fieldID, jobject value) {
-  (*java)->SetStaticObjectField(java, cls, fieldID, value);
+  JNIEnv *env = java_env();
+  (*env)->SetStaticObjectField(env, cls, fieldID, value);
 }
 void SetStaticBooleanField(jclass cls, jfieldID fieldID, jboolean value) {
-  (*java)->SetStaticBooleanField(java, cls, fieldID, value);
+  JNIEnv *env = java_env();
+  (*env)->SetStaticBooleanField(env, cls, fieldID, value);
 }
 void SetStaticByteField(jclass cls, jfieldID fieldID, jbyte value) {
-  (*java)->SetStaticByteField(java, cls, fieldID, value);
+  JNIEnv *env = java_env();
+  (*env)->SetStaticByteField(env, cls, fieldID, value);
 }
 void SetStaticCharField(jclass cls, jfieldID fieldID, jchar value) {
-  (*java)->SetStaticCharField(java, cls, fieldID, value);
+  JNIEnv *env = java_env();
+  (*env)->SetStaticCharField(env, cls, fieldID, value);
 }
 void SetStaticShortField(jclass cls, jfieldID fieldID, jshort value) {
-  (*java)->SetStaticShortField(java, cls, fieldID, value);
+  JNIEnv *env = java_env();
+  (*env)->SetStaticShortField(env, cls, fieldID, value);
 }
 void SetStaticIntField(jclass cls, jfieldID fieldID, jint value) {
-  (*java)->SetStaticIntField(java, cls, fieldID, value);
+  JNIEnv *env = java_env();
+  (*env)->SetStaticIntField(env, cls, fieldID, value);
 }
 void SetStaticLongField(jclass cls, jfieldID fieldID, jlong value) {
-  (*java)->SetStaticLongField(java, cls, fieldID, value);
+  JNIEnv *env = java_env();
+  (*env)->SetStaticLongField(env, cls, fieldID, value);
 }
 void SetStaticFloatField(jclass cls, jfieldID fieldID, jfloat value) {
-  (*java)->SetStaticFloatField(java, cls, fieldID, value);
+  JNIEnv *env = java_env();
+  (*env)->SetStaticFloatField(env, cls, fieldID, value);
 }
 void SetStaticDoubleField(jclass cls, jfieldID fieldID, jdouble value) {
-  (*java)->SetStaticDoubleField(java, cls, fieldID, value);
+  JNIEnv *env = java_env();
+  (*env)->SetStaticDoubleField(env, cls, fieldID, value);
 }
 
 jstring NewString(const jchar *unicode, jsize len) {
-    return (*java)->NewString(java, unicode, len);
+    JNIEnv *env = java_env();
+    return (*env)->NewString(env, unicode, len);
 }
 jsize GetStringLength(jstring str) {
-    return (*java)->GetStringLength(java, str);
+    JNIEnv *env = java_env();
+    return (*env)->GetStringLength(env, str);
 }
 const jchar *GetStringChars(jstring str, jboolean *isCopy) {
-    return (*java)->GetStringChars(java, str, isCopy);
+    JNIEnv *env = java_env();
+    return (*env)->GetStringChars(env, str, isCopy);
 }
 void ReleaseStringChars(jstring str, const jchar *chars) {
-    (*java)->ReleaseStringChars(java, str, chars);
+    JNIEnv *env = java_env();
+    (*env)->ReleaseStringChars(env, str, chars);
 }
 
 jstring NewStringUTF(const char *utf) {
-    return (*java)->NewStringUTF(java, utf);
+    JNIEnv *env = java_env();
+    return (*env)->NewStringUTF(env, utf);
 }
 jsize GetStringUTFLength(jstring str) {
-    return (*java)->GetStringUTFLength(java, str);
+    JNIEnv *env = java_env();
+    return (*env)->GetStringUTFLength(env, str);
 }
 const char* GetStringUTFChars(jstring str, jboolean *isCopy) {
-    return (*java)->GetStringUTFChars(java, str, isCopy);
+    JNIEnv *env = java_env();
+    return (*env)->GetStringUTFChars(env, str, isCopy);
 }
 void ReleaseStringUTFChars(jstring str, const char* chars) {
-    (*java)->ReleaseStringUTFChars(java, str, chars);
+    JNIEnv *env = java_env();
+    (*env)->ReleaseStringUTFChars(env, str, chars);
 }
 
 jsize GetArrayLength(jarray array) {
-    return (*java)->GetArrayLength(java, array);
+    JNIEnv *env = java_env();
+    return (*env)->GetArrayLength(env, array);
 }
 
 jobjectArray NewObjectArray(jsize len, jclass cls, jobject init) {
-    return (*java)->NewObjectArray(java, len, cls, init);
+    JNIEnv *env = java_env();
+    return (*env)->NewObjectArray(env, len, cls, init);
 }
 jobject GetObjectArrayElement(jobjectArray array, jsize index) {
-    return (*java)->GetObjectArrayElement(java, array, index);
+    JNIEnv *env = java_env();
+    return (*env)->GetObjectArrayElement(env, array, index);
 }
 void SetObjectArrayElement(jobjectArray array, jsize index, jobject val) {
-    (*java)->SetObjectArrayElement(java, array, index, val);
+    JNIEnv *env = java_env();
+    (*env)->SetObjectArrayElement(env, array, index, val);
 }
 
 jbooleanArray NewBooleanArray(jsize len) {
-    return (*java)->NewBooleanArray(java, len);
+    JNIEnv *env = java_env();
+    return (*env)->NewBooleanArray(env, len);
 }
 jbyteArray NewByteArray(jsize len) {
-    return (*java)->NewByteArray(java, len);
+    JNIEnv *env = java_env();
+    return (*env)->NewByteArray(env, len);
 }
 jcharArray NewCharArray(jsize len) {
-    return (*java)->NewCharArray(java, len);
+    JNIEnv *env = java_env();
+    return (*env)->NewCharArray(env, len);
 }
 jshortArray NewShortArray(jsize len) {
-    return (*java)->NewShortArray(java, len);
+    JNIEnv *env = java_env();
+    return (*env)->NewShortArray(env, len);
 }
 jintArray NewIntArray(jsize len) {
-    return (*java)->NewIntArray(java, len);
+    JNIEnv *env = java_env();
+    return (*env)->NewIntArray(env, len);
 }
 jlongArray NewLongArray(jsize len) {
-    return (*java)->NewLongArray(java, len);
+    JNIEnv *env = java_env();
+    return (*env)->NewLongArray(env, len);
 }
 jfloatArray NewFloatArray(jsize len) {
-    return (*java)->NewFloatArray(java, len);
+    JNIEnv *env = java_env();
+    return (*env)->NewFloatArray(env, len);
 }
 jdoubleArray NewDoubleArray(jsize len) {
-    return (*java)->NewDoubleArray(java, len);
+    JNIEnv *env = java_env();
+    return (*env)->NewDoubleArray(env, len);
 }
 
 jboolean * GetBooleanArrayElements(jbooleanArray array, jboolean *isCopy) {
-    return (*java)->GetBooleanArrayElements(java, array, isCopy);
+    JNIEnv *env = java_env();
+    return (*env)->GetBooleanArrayElements(env, array, isCopy);
 }
 jbyte * GetByteArrayElements(jbyteArray array, jboolean *isCopy) {
-    return (*java)->GetByteArrayElements(java, array, isCopy);
+    JNIEnv *env = java_env();
+    return (*env)->GetByteArrayElements(env, array, isCopy);
 }
 jchar * GetCharArrayElements(jcharArray array, jboolean *isCopy) {
-    return (*java)->GetCharArrayElements(java, array, isCopy);
+    JNIEnv *env = java_env();
+    return (*env)->GetCharArrayElements(env, array, isCopy);
 }
 jshort * GetShortArrayElements(jshortArray array, jboolean *isCopy) {
-    return (*java)->GetShortArrayElements(java, array, isCopy);
+    JNIEnv *env = java_env();
+    return (*env)->GetShortArrayElements(env, array, isCopy);
 }
 jint * GetIntArrayElements(jintArray array, jboolean *isCopy) {
-    return (*java)->GetIntArrayElements(java, array, isCopy);
+    JNIEnv *env = java_env();
+    return (*env)->GetIntArrayElements(env, array, isCopy);
 }
 jlong * GetLongArrayElements(jlongArray array, jboolean *isCopy) {
-    return (*java)->GetLongArrayElements(java, array, isCopy);
+    JNIEnv *env = java_env();
+    return (*env)->GetLongArrayElements(env, array, isCopy);
 }
 jfloat * GetFloatArrayElements(jfloatArray array, jboolean *isCopy) {
-    return (*java)->GetFloatArrayElements(java, array, isCopy);
+    JNIEnv *env = java_env();
+    return (*env)->GetFloatArrayElements(env, array, isCopy);
 }
 jdouble * GetDoubleArrayElements(jdoubleArray array, jboolean *isCopy) {
-    return (*java)->GetDoubleArrayElements(java, array, isCopy);
+    JNIEnv *env = java_env();
+    return (*env)->GetDoubleArrayElements(env, array, isCopy);
 }
 
 void ReleaseBooleanArrayElements(jbooleanArray array, jboolean *elems, jint mode) {
-    (*java)->ReleaseBooleanArrayElements(java, array, elems, mode);
+    JNIEnv *env = java_env();
+    (*env)->ReleaseBooleanArrayElements(env, array, elems, mode);
 }
 void ReleaseByteArrayElements(jbyteArray array, jbyte *elems, jint mode) {
-    (*java)->ReleaseByteArrayElements(java, array, elems, mode);
+    JNIEnv *env = java_env();
+    (*env)->ReleaseByteArrayElements(env, array, elems, mode);
 }
 void ReleaseCharArrayElements(jcharArray array, jchar *elems, jint mode) {
-    (*java)->ReleaseCharArrayElements(java, array, elems, mode);
+    JNIEnv *env = java_env();
+    (*env)->ReleaseCharArrayElements(env, array, elems, mode);
 }
 void ReleaseShortArrayElements(jshortArray array, jshort *elems, jint mode) {
-    (*java)->ReleaseShortArrayElements(java, array, elems, mode);
+    JNIEnv *env = java_env();
+    (*env)->ReleaseShortArrayElements(env, array, elems, mode);
 }
 void ReleaseIntArrayElements(jintArray array, jint *elems, jint mode) {
-    (*java)->ReleaseIntArrayElements(java, array, elems, mode);
+    JNIEnv *env = java_env();
+    (*env)->ReleaseIntArrayElements(env, array, elems, mode);
 }
 void ReleaseLongArrayElements(jlongArray array, jlong *elems, jint mode) {
-    (*java)->ReleaseLongArrayElements(java, array, elems, mode);
+    JNIEnv *env = java_env();
+    (*env)->ReleaseLongArrayElements(env, array, elems, mode);
 }
 void ReleaseFloatArrayElements(jfloatArray array, jfloat *elems, jint mode) {
-    (*java)->ReleaseFloatArrayElements(java, array, elems, mode);
+    JNIEnv *env = java_env();
+    (*env)->ReleaseFloatArrayElements(env, array, elems, mode);
 }
 void ReleaseDoubleArrayElements(jdoubleArray array, jdouble *elems, jint mode) {
-    (*java)->ReleaseDoubleArrayElements(java, array, elems, mode);
+    JNIEnv *env = java_env();
+    (*env)->ReleaseDoubleArrayElements(env, array, elems, mode);
 }
 
 void GetBooleanArrayRegion(jbooleanArray array, jsize start, jsize len, jboolean *buf) {
-    (*java)->GetBooleanArrayRegion(java, array, start, len, buf);
+    JNIEnv *env = java_env();
+    (*env)->GetBooleanArrayRegion(env, array, start, len, buf);
 }
 void GetByteArrayRegion(jbyteArray array, jsize start, jsize len, jbyte *buf) {
-    (*java)->GetByteArrayRegion(java, array, start, len, buf);
+    JNIEnv *env = java_env();
+    (*env)->GetByteArrayRegion(env, array, start, len, buf);
 }
 void GetCharArrayRegion(jcharArray array, jsize start, jsize len, jchar *buf) {
-    (*java)->GetCharArrayRegion(java, array, start, len, buf);
+    JNIEnv *env = java_env();
+    (*env)->GetCharArrayRegion(env, array, start, len, buf);
 }
 void GetShortArrayRegion(jshortArray array, jsize start, jsize len, jshort *buf) {
-    (*java)->GetShortArrayRegion(java, array, start, len, buf);
+    JNIEnv *env = java_env();
+    (*env)->GetShortArrayRegion(env, array, start, len, buf);
 }
 void GetIntArrayRegion(jintArray array, jsize start, jsize len, jint *buf) {
-    (*java)->GetIntArrayRegion(java, array, start, len, buf);
+    JNIEnv *env = java_env();
+    (*env)->GetIntArrayRegion(env, array, start, len, buf);
 }
 void GetLongArrayRegion(jlongArray array, jsize start, jsize len, jlong *buf) {
-    (*java)->GetLongArrayRegion(java, array, start, len, buf);
+    JNIEnv *env = java_env();
+    (*env)->GetLongArrayRegion(env, array, start, len, buf);
 }
 void GetFloatArrayRegion(jfloatArray array, jsize start, jsize len, jfloat *buf) {
-    (*java)->GetFloatArrayRegion(java, array, start, len, buf);
+    JNIEnv *env = java_env();
+    (*env)->GetFloatArrayRegion(env, array, start, len, buf);
 }
 void GetDoubleArrayRegion(jdoubleArray array, jsize start, jsize len, jdouble *buf) {
-    (*java)->GetDoubleArrayRegion(java, array, start, len, buf);
+    JNIEnv *env = java_env();
+    (*env)->GetDoubleArrayRegion(env, array, start, len, buf);
 }
 
 void SetBooleanArrayRegion(jbooleanArray array, jsize start, jsize len, const jboolean *buf) {
-    (*java)->SetBooleanArrayRegion(java, array, start, len, buf);
+    JNIEnv *env = java_env();
+    (*env)->SetBooleanArrayRegion(env, array, start, len, buf);
 }
 void SetByteArrayRegion(jbyteArray array, jsize start, jsize len, const jbyte *buf) {
-    (*java)->SetByteArrayRegion(java, array, start, len, buf);
+    JNIEnv *env = java_env();
+    (*env)->SetByteArrayRegion(env, array, start, len, buf);
 }
 void SetCharArrayRegion(jcharArray array, jsize start, jsize len, const jchar *buf) {
-    (*java)->SetCharArrayRegion(java, array, start, len, buf);
+    JNIEnv *env = java_env();
+    (*env)->SetCharArrayRegion(env, array, start, len, buf);
 }
 void SetShortArrayRegion(jshortArray array, jsize start, jsize len, const jshort *buf) {
-    (*java)->SetShortArrayRegion(java, array, start, len, buf);
+    JNIEnv *env = java_env();
+    (*env)->SetShortArrayRegion(env, array, start, len, buf);
 }
 void SetIntArrayRegion(jintArray array, jsize start, jsize len, const jint *buf) {
-    (*java)->SetIntArrayRegion(java, array, start, len, buf);
+    JNIEnv *env = java_env();
+    (*env)->SetIntArrayRegion(env, array, start, len, buf);
 }
 void SetLongArrayRegion(jlongArray array, jsize start, jsize len, const jlong *buf) {
-    (*java)->SetLongArrayRegion(java, array, start, len, buf);
+    JNIEnv *env = java_env();
+    (*env)->SetLongArrayRegion(env, array, start, len, buf);
 }
 void SetFloatArrayRegion(jfloatArray array, jsize start, jsize len, const jfloat *buf) {
-    (*java)->SetFloatArrayRegion(java, array, start, len, buf);
+    JNIEnv *env = java_env();
+    (*env)->SetFloatArrayRegion(env, array, start, len, buf);
 }
 void SetDoubleArrayRegion(jdoubleArray array, jsize start, jsize len, const jdouble *buf) {
-    (*java)->SetDoubleArrayRegion(java, array, start, len, buf);
+    JNIEnv *env = java_env();
+    (*env)->SetDoubleArrayRegion(env, array, start, len, buf);
 }
 
 jint RegisterNatives(jclass cls, const JNINativeMethod *methods, jint nMethods) {
-    return (*java)->RegisterNatives(java, cls, methods, nMethods);
+    JNIEnv *env = java_env();
+    return (*env)->RegisterNatives(env, cls, methods, nMethods);
 }
 jint UnregisterNatives(jclass cls) {
-    return (*java)->UnregisterNatives(java, cls);
+    JNIEnv *env = java_env();
+    return (*env)->UnregisterNatives(env, cls);
 }
 
 jint MonitorEnter(jobject obj) {
-    return (*java)->MonitorEnter(java, obj);
+    JNIEnv *env = java_env();
+    return (*env)->MonitorEnter(env, obj);
 }
 jint MonitorExit(jobject obj) {
-    return (*java)->MonitorExit(java, obj);
+    JNIEnv *env = java_env();
+    return (*env)->MonitorExit(env, obj);
 }
 
 jint GetJavaVM(JavaVM **vm) {
-    return (*java)->GetJavaVM(java,vm);
+    JNIEnv *env = java_env();
+    return (*env)->GetJavaVM(env,vm);
 }
 
 void GetStringRegion(jstring str, jsize start, jsize len, jchar *buf) {
-    (*java)->GetStringRegion(java, str, start, len, buf);
+    JNIEnv *env = java_env();
+    (*env)->GetStringRegion(env, str, start, len, buf);
 }
 void GetStringUTFRegion(jstring str, jsize start, jsize len, char *buf) {
-    (*java)->GetStringUTFRegion(java, str, start, len, buf);
+    JNIEnv *env = java_env();
+    (*env)->GetStringUTFRegion(env, str, start, len, buf);
 }
 
 void *GetPrimitiveArrayCritical(jarray array, jboolean *isCopy) {
-    return (*java)->GetPrimitiveArrayCritical(java, array, isCopy);
+    JNIEnv *env = java_env();
+    return (*env)->GetPrimitiveArrayCritical(env, array, isCopy);
 }
 void ReleasePrimitiveArrayCritical(jarray array, void *carray, jint mode) {
-    (*java)->ReleasePrimitiveArrayCritical(java, array, carray, mode);
+    JNIEnv *env = java_env();
+    (*env)->ReleasePrimitiveArrayCritical(env, array, carray, mode);
 }
 
 const jchar *GetStringCritical(jstring string, jboolean *isCopy) {
-    return (*java)->GetStringCritical(java, string, isCopy);
+    JNIEnv *env = java_env();
+    return (*env)->GetStringCritical(env, string, isCopy);
 }
 void ReleaseStringCritical(jstring string, const jchar *cstring) {
-    (*java)->ReleaseStringCritical(java, string, cstring);
+    JNIEnv *env = java_env();
+    (*env)->ReleaseStringCritical(env, string, cstring);
 }
 
 jweak NewWeakGlobalRef(jobject obj) {
-    return (*java)->NewWeakGlobalRef(java, obj);
+    JNIEnv *env = java_env();
+    return (*env)->NewWeakGlobalRef(env, obj);
 }
 void DeleteWeakGlobalRef(jweak ref) {
-    (*java)->DeleteWeakGlobalRef(java, ref);
+    JNIEnv *env = java_env();
+    (*env)->DeleteWeakGlobalRef(env, ref);
 }
 
 jboolean ExceptionCheck() {
-    return (*java)->ExceptionCheck(java);
+    JNIEnv *env = java_env();
+    return (*env)->ExceptionCheck(env);
 }
 
 jobject NewDirectByteBuffer(void* address, jlong capacity) {
-    return (*java)->NewDirectByteBuffer(java, address, capacity);
+    JNIEnv *env = java_env();
+    return (*env)->NewDirectByteBuffer(env, address, capacity);
 }
 void* GetDirectBufferAddress(jobject buf) {
-    return (*java)->GetDirectBufferAddress(java, buf);
+    JNIEnv *env = java_env();
+    return (*env)->GetDirectBufferAddress(env, buf);
 }
 jlong GetDirectBufferCapacity(jobject buf) {
-    return (*java)->GetDirectBufferCapacity(java, buf);
+    JNIEnv *env = java_env();
+    return (*env)->GetDirectBufferCapacity(env, buf);
 }
 jobjectRefType GetObjectRefType(jobject obj) {
-    return (*java)->GetObjectRefType(java, obj);
+    JNIEnv *env = java_env();
+    return (*env)->GetObjectRefType(env, obj);
 }
 
 
 /**************************************************************************
- * Method to start the Python runtime.
+ * Conversion of strings between Python and Java.
+ *
+ * Strings are copied directly between Java's UTF-16 representation and
+ * Python unicode objects. Short strings that are passed to Java can be
+ * cached as global references to interned Java strings, so that
+ * frequently used strings (such as map keys and property names) are only
+ * converted once.
  *************************************************************************/
-JNIEXPORT jint JNICALL Java_org_pybee_rubicon_Python_start(JNIEnv *env, jobject thisObj, jstring pythonHome, jstring pythonPath, jstring rubiconLib) {
-    int ret = 0;
-    char pythonPathVar[512];
-    char rubiconLibVar[256];
 
-    LOG_I("Start Python runtime...");
-    java = env;
+#ifdef WORDS_BIGENDIAN
+#define UTF16_BYTE_ORDER 1
+#else
+#define UTF16_BYTE_ORDER -1
+#endif
 
-    // Special environment to prefer .pyo, and don't write bytecode if .py are found
-    // because the process will not have write attribute on the device.
-    putenv("PYTHONOPTIMIZE=2");
-    putenv("PYTHONDONTWRITEBYTECODE=1");
-    putenv("PYTHONNOUSERSITE=1");
-    putenv("TARGET_ANDROID=1");
+// Strings up to this length are copied using a buffer on the stack;
+// longer strings are copied into a buffer on the Python heap.
+#define STRING_BUFFER_SIZE 256
 
-    if (pythonHome) {
-        LOG_D("PYTHONHOME=%s", (*env)->GetStringUTFChars(env, pythonHome, NULL));
-        Py_SetPythonHome((char *)(*env)->GetStringUTFChars(env, pythonHome, NULL));
-    } else {
-        LOG_D("Using default PYTHONHOME");
+// Strings up to this length are eligible for the string cache.
+#define MAX_CACHED_STRING_LENGTH 64
+
+// A dictionary of Python string: address of a global reference to the
+// equivalent interned Java string. Once the cache is full, no more strings
+// are added; cached references are only deleted when the cache is resized.
+// The cache is protected by the GIL.
+static PyObject *string_cache = NULL;
+static Py_ssize_t string_cache_size = 512;
+
+/*
+ * Convert a Java string into a Python unicode object. The Java string
+ * is not deleted. Returns a new reference, or NULL on error.
+ *
+ * The characters are always copied out of the string before they are
+ * decoded; decoding allocates Python objects, which can run arbitrary
+ * Python code (and JNI calls) through the garbage collector, so the
+ * string can't be pinned while it happens.
+ */
+static PyObject *java_string_to_python(JNIEnv *env, jstring str) {
+    jchar buffer[STRING_BUFFER_SIZE];
+    jchar *chars = buffer;
+    jsize length;
+    int byteorder = UTF16_BYTE_ORDER;
+    PyObject *result;
+
+    if (str == NULL) {
+        Py_RETURN_NONE;
+    }
+    length = (*env)->GetStringLength(env, str);
+    if (length > STRING_BUFFER_SIZE) {
+        chars = PyMem_Malloc(length * sizeof(jchar));
+        if (chars == NULL) {
+            return PyErr_NoMemory();
+        }
+    }
+    (*env)->GetStringRegion(env, str, 0, length, chars);
+    result = PyUnicode_DecodeUTF16((const char *) chars, length * sizeof(jchar), "replace", &byteorder);
+    if (chars != buffer) {
+        PyMem_Free(chars);
     }
+    return result;
+}
 
-    if (pythonPath) {
-        sprintf(pythonPathVar, "PYTHONPATH=%s", (*env)->GetStringUTFChars(env, pythonPath, NULL));
-        LOG_D("%s", pythonPathVar);
-        putenv(pythonPathVar);
+/*
+ * Create a Java string from a Python str or unicode object. A str is
+ * interpreted as UTF-8. Returns a new local reference, or NULL (with a
+ * Python exception set) on error.
+ */
+static jstring python_to_java_string(JNIEnv *env, PyObject *value) {
+    PyObject *unicode;
+    PyObject *utf16 = NULL;
+    jstring result;
+
+    if (PyString_Check(value)) {
+        // Pure ASCII strings can be passed to Java directly.
+        const unsigned char *c = (const unsigned char *) PyString_AS_STRING(value);
+        const unsigned char *end = c + PyString_GET_SIZE(value);
+        while (c < end && *c && *c < 0x80) {
+            c++;
+        }
+        if (c == end) {
+            result = (*env)->NewStringUTF(env, PyString_AS_STRING(value));
+            if (result == NULL) {
+                (*env)->ExceptionClear(env);
+                PyErr_NoMemory();
+            }
+            return result;
+        }
+        unicode = PyUnicode_FromEncodedObject(value, "utf-8", "replace");
     } else {
-        LOG_D("Using default PYTHONPATH");
+        unicode = PyUnicode_FromObject(value);
+    }
+    if (unicode == NULL) {
+        return NULL;
     }
 
-#ifdef ANDROID
-    // If we're on android, we need to specify the location of the Rubicon
-    // shared library as part of the environment.
-    if (rubiconLib) {
-        sprintf(rubiconLibVar, "RUBICON_LIBRARY=%s", (*env)->GetStringUTFChars(env, rubiconLib, NULL));
-        LOG_D("%s", rubiconLibVar);
-        putenv(rubiconLibVar);
-    } else {
-        LOG_D("Not setting RUBICON_LIBRARY");
+#if Py_UNICODE_SIZE == 2
+    result = (*env)->NewString(env, (const jchar *) PyUnicode_AS_UNICODE(unicode), PyUnicode_GET_SIZE(unicode));
+#else
+    utf16 = PyUnicode_EncodeUTF16(PyUnicode_AS_UNICODE(unicode), PyUnicode_GET_SIZE(unicode), NULL, UTF16_BYTE_ORDER);
+    if (utf16 == NULL) {
+        Py_DECREF(unicode);
+        return NULL;
     }
+    result = (*env)->NewString(env, (const jchar *) PyString_AS_STRING(utf16), PyString_GET_SIZE(utf16) / sizeof(jchar));
+    Py_DECREF(utf16);
 #endif
+    Py_DECREF(unicode);
 
-    // putenv("PYTHONVERBOSE=1");
+    if (result == NULL) {
+        (*env)->ExceptionClear(env);
+        PyErr_NoMemory();
+    }
+    return result;
+}
 
-    LOG_I("Initializing Python runtime...");
-    Py_Initialize();
-    // PySys_SetArgv(argc, argv);
+/*
+ * Delete every reference in the string cache.
+ */
+static void clear_string_cache(JNIEnv *env) {
+    Py_ssize_t pos = 0;
+    PyObject *key;
+    PyObject *address;
 
-    // If other modules are using threads, we need to initialize them before.
-    PyEval_InitThreads();
+    if (string_cache == NULL) {
+        return;
+    }
+    while (PyDict_Next(string_cache, &pos, &key, &address)) {
+        (*env)->DeleteGlobalRef(env, (jobject) PyLong_AsVoidPtr(address));
+    }
+    PyDict_Clear(string_cache);
+}
 
-#ifdef ANDROID
-    // Initialize and bootstrap the Android logging module
-    LOG_I("Initializing Android logging module...");
-    initandroid();
+/*
+ * Retrieve a Java string for a Python string that is being passed to Java.
+ *
+ * Short strings are served from (and, if there is space, added to) the
+ * string cache. If the returned reference is a cached global reference,
+ * *cached is set to true, and the reference must not be deleted by the
+ * caller. Otherwise, a new local reference is returned.
+ */
+static jstring python_to_java_string_cached(JNIEnv *env, PyObject *value, int *cached) {
+    Py_ssize_t length = PyString_Check(value) ? PyString_GET_SIZE(value) : PyUnicode_GET_SIZE(value);
+    PyObject *address;
+    jstring local;
+    jstring interned;
+    jstring global;
 
-    LOG_D("Bootstrap Android logging...");
-    ret = PyRun_SimpleString(
-        "import sys\n" \
-        "import android\n" \
-        "class LogFile(object):\n" \
-        "    def __init__(self, level):\n" \
-        "        self.buffer = ''\n" \
-        "        self.level = level\n" \
-        "    def write(self, s):\n" \
-        "        s = self.buffer + s\n" \
-        "        lines = s.split(\"\\n\")\n" \
-        "        for line in lines[:-1]:\n" \
-        "            self.level(line)\n" \
-        "        self.buffer = lines[-1]\n" \
-        "    def flush(self):\n" \
-        "        return\n" \
-        "sys.stdout = LogFile(android.info)\n" \
-        "sys.stderr = LogFile(android.error)\n" \
-        "print 'Android Logging bootstrap active.'");
-    if (ret != 0) {
-        LOG_E("Exception during logging bootstrap.");
-    } else {
-        LOG_D("Python runtime started.");
+    *cached = 0;
+    if (string_cache_size <= 0 || length > MAX_CACHED_STRING_LENGTH) {
+        return python_to_java_string(env, value);
     }
-#endif
 
-    LOG_I("Import rubicon...");
-    PyObject *rubicon;
+    if (string_cache == NULL) {
+        string_cache = PyDict_New();
+        if (string_cache == NULL) {
+            return NULL;
+        }
+    }
+    address = PyDict_GetItem(string_cache, value);
+    if (address) {
+        *cached = 1;
+        return (jstring) PyLong_AsVoidPtr(address);
+    }
 
-    rubicon = PyImport_ImportModule("rubicon.java");
-    if (rubicon == NULL) {
-        LOG_E("Couldn't import rubicon python module");
-        PyErr_Print();
-        PyErr_Clear();
-        java = NULL;
-        return -1;
+    local = python_to_java_string(env, value);
+    if (local == NULL || PyDict_Size(string_cache) >= string_cache_size) {
+        return local;
     }
-    LOG_D("Got rubicon python module");
 
-    method_handler = PyObject_GetAttrString(rubicon, "dispatch");
-    if (method_handler == NULL) {
-        LOG_E("Couldn't find method dipatch handler");
-        PyErr_Print();
+    interned = (*env)->CallObjectMethod(env, local, reflect.String__intern);
+    if (interned == NULL) {
+        (*env)->ExceptionClear(env);
+        return local;
+    }
+    global = (*env)->NewGlobalRef(env, interned);
+    (*env)->DeleteLocalRef(env, interned);
+    if (global == NULL) {
+        return local;
+    }
+
+    address = PyLong_FromVoidPtr(global);
+    if (address == NULL || PyDict_SetItem(string_cache, value, address) < 0) {
+        Py_XDECREF(address);
+        (*env)->DeleteGlobalRef(env, global);
         PyErr_Clear();
-        java = NULL;
-        return -2;
+        return local;
     }
-    LOG_D("Got method dispatch handler");
+    Py_DECREF(address);
+    (*env)->DeleteLocalRef(env, local);
 
-    Py_DECREF(rubicon);
+    *cached = 1;
+    return global;
+}
 
-    LOG_D("Python runtime started.");
+/**************************************************************************
+ * Handles for Python objects that are referenced by Java.
+ *
+ * Java refers to a Python object (e.g., the implementation behind a
+ * proxy) using a handle into this table. The low 32 bits of a handle are
+ * the index of its slot (plus one, so that 0 is never a valid handle);
+ * the high 32 bits are the generation of the slot when the handle was
+ * issued. The generation is incremented whenever a slot is freed, so a
+ * handle that outlives its object is detected, rather than resolving to
+ * whatever object reuses the slot.
+ *
+ * The table is a set of fixed-size segments that are allocated on demand
+ * and never freed, so a slot never moves. Slots are allocated and freed
+ * without locking: free slots are kept on a stack, whose head is tagged
+ * with a counter to avoid ABA problems.
+ *
+ * Each allocated slot owns a reference to its object. Resolving a handle
+ * returns a borrowed reference, so the GIL must be held for as long as
+ * the object is used.
+ *************************************************************************/
+#define HANDLE_SEGMENT_BITS 10
+#define HANDLE_SEGMENT_SIZE (1 << HANDLE_SEGMENT_BITS)
+#define HANDLE_SEGMENTS 4096
+
+typedef struct {
+    PyObject *volatile object;
+    volatile uint32_t generation;
+    // The index (plus one) of the next free slot, while this slot is free
+    volatile uint32_t next_free;
+} HandleSlot;
+
+static HandleSlot *volatile handle_segments[HANDLE_SEGMENTS];
+
+// The number of slots that have ever been allocated
+static volatile uint32_t handle_count = 0;
+
+// The top of the free slot stack: (tag << 32) | (index + 1)
+static volatile uint64_t handle_free_list = 0;
+
+static HandleSlot *handle_slot(uint32_t index) {
+    HandleSlot *segment = handle_segments[index >> HANDLE_SEGMENT_BITS];
+
+    if (segment == NULL) {
+        segment = calloc(HANDLE_SEGMENT_SIZE, sizeof(HandleSlot));
+        if (segment == NULL) {
+            return NULL;
+        }
+        if (!__sync_bool_compare_and_swap(&handle_segments[index >> HANDLE_SEGMENT_BITS], NULL, segment)) {
+            // Another thread allocated the segment first.
+            free(segment);
+            segment = handle_segments[index >> HANDLE_SEGMENT_BITS];
+        }
+    }
+    return &segment[index & (HANDLE_SEGMENT_SIZE - 1)];
+}
+
+static void push_free_handle(HandleSlot *slot, uint32_t index) {
+    uint64_t head;
+
+    do {
+        head = handle_free_list;
+        slot->next_free = (uint32_t) head;
+    } while (!__sync_bool_compare_and_swap(&handle_free_list, head, (((head >> 32) + 1) << 32) | (index + 1)));
+}
+
+/*
+ * Allocate a handle for a Python object; the table takes a new reference
+ * to the object. Returns 0 (with a Python exception set) on failure.
+ */
+static jlong new_handle(PyObject *object) {
+    HandleSlot *slot;
+    uint32_t index;
+    uint64_t head;
+
+    for (;;) {
+        head = handle_free_list;
+        if ((uint32_t) head == 0) {
+            index = __sync_fetch_and_add(&handle_count, 1);
+            if (index >= (uint32_t) HANDLE_SEGMENTS * HANDLE_SEGMENT_SIZE) {
+                __sync_fetch_and_sub(&handle_count, 1);
+                PyErr_SetString(PyExc_RuntimeError, "Too many Python objects referenced by Java");
+                return 0;
+            }
+            slot = handle_slot(index);
+            if (slot == NULL) {
+                // The index is lost; the segment will be retried by the
+                // next allocation that falls in it.
+                PyErr_NoMemory();
+                return 0;
+            }
+            break;
+        }
+        index = (uint32_t) head - 1;
+        slot = handle_slot(index);
+        if (__sync_bool_compare_and_swap(&handle_free_list, head, (((head >> 32) + 1) << 32) | slot->next_free)) {
+            break;
+        }
+    }
+
+    Py_INCREF(object);
+    slot->object = object;
+    __sync_synchronize();
+    return ((jlong) slot->generation << 32) | (index + 1);
+}
+
+/*
+ * Find the slot for a handle; returns NULL if the handle has never been
+ * issued.
+ */
+static HandleSlot *find_handle(jlong handle, uint32_t *index) {
+    uint32_t low = (uint32_t) handle;
+
+    if (low == 0 || low > handle_count) {
+        return NULL;
+    }
+    *index = low - 1;
+    if (handle_segments[*index >> HANDLE_SEGMENT_BITS] == NULL) {
+        return NULL;
+    }
+    return handle_slot(*index);
+}
+
+/*
+ * Resolve a handle into the Python object it refers to. Returns a
+ * borrowed reference, or NULL if the handle is invalid or stale.
+ */
+static PyObject *resolve_handle(jlong handle) {
+    uint32_t index;
+    HandleSlot *slot = find_handle(handle, &index);
+    PyObject *object;
+
+    if (slot == NULL) {
+        return NULL;
+    }
+    object = slot->object;
+    __sync_synchronize();
+    if (slot->generation != (uint32_t) ((uint64_t) handle >> 32)) {
+        return NULL;
+    }
+    return object;
+}
+
+/*
+ * Free a handle. Returns the reference to the object that was owned by
+ * the table (which the caller must release), or NULL if the handle was
+ * invalid or stale.
+ */
+static PyObject *release_handle(jlong handle) {
+    uint32_t index;
+    uint32_t generation = (uint32_t) ((uint64_t) handle >> 32);
+    HandleSlot *slot = find_handle(handle, &index);
+    PyObject *object;
+
+    if (slot == NULL) {
+        return NULL;
+    }
+    // Only one release of a handle can advance the generation.
+    object = slot->object;
+    if (!__sync_bool_compare_and_swap(&slot->generation, generation, generation + 1)) {
+        return NULL;
+    }
+    slot->object = NULL;
+    push_free_handle(slot, index);
+    return object;
+}
+
+/*
+ * Invalidate every handle, without releasing the objects they refer to.
+ * This is only used when the Python runtime is stopped, and all the
+ * objects are about to be discarded anyway.
+ */
+static void clear_handles(void) {
+    uint32_t index;
+    uint32_t count = handle_count;
+
+    for (index = 0; index < count; index++) {
+        if (handle_segments[index >> HANDLE_SEGMENT_BITS]) {
+            HandleSlot *slot = handle_slot(index);
+            if (slot->object) {
+                slot->generation++;
+                slot->object = NULL;
+                push_free_handle(slot, index);
+            }
+        }
+    }
+}
+
+/**************************************************************************
+ * Cache of callback signatures.
+ *
+ * The first time a Java interface method is invoked on a Python object,
+ * the types involved in the call are determined using reflection, and
+ * the Python dispatch slot for the method is retrieved; both are stored
+ * against the method ID. The cache is protected by the GIL.
+ *************************************************************************/
+typedef struct {
+    // The method ID of the interface method
+    jmethodID method;
+    // The Python dispatch slot for the method
+    PyObject *slot;
+    // The JNI type code of the return type ('L' for all object types)
+    char return_type;
+    // If the return type is a box class (e.g., java.lang.Long), the JNI
+    // type code of the primitive it boxes; 0 otherwise
+    char return_box;
+    // The number of arguments, and the JNI type code of each argument
+    jsize argc;
+    char *arg_types;
+} CallbackSignature;
+
+static CallbackSignature **callback_signatures = NULL;
+static size_t callback_signatures_size = 0;
+static size_t callback_signatures_count = 0;
+
+/*
+ * Determine the JNI type code for a Java class. All object types
+ * (including arrays) are reported as 'L'.
+ */
+static char type_code(JNIEnv *env, jclass cls) {
+    PrimitiveType *primitive;
+
+    if ((*env)->IsSameObject(env, cls, reflect.Void__TYPE)) {
+        return 'V';
+    }
+    for (primitive = primitive_types; primitive->type; primitive++) {
+        if ((*env)->IsSameObject(env, cls, primitive->primitive)) {
+            return primitive->type;
+        }
+    }
+    return 'L';
+}
+
+/*
+ * Determine the JNI type code of the primitive boxed by a Java class,
+ * or 0 if the class isn't a box class.
+ */
+static char box_type_code(JNIEnv *env, jclass cls) {
+    PrimitiveType *primitive;
+
+    for (primitive = primitive_types; primitive->type; primitive++) {
+        if ((*env)->IsSameObject(env, cls, primitive->box)) {
+            return primitive->type;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Retrieve the Python dispatch slot for an interface method.
+ * Returns a new reference, or NULL on error.
+ */
+static PyObject *callback_dispatch_slot(JNIEnv *env, jobject method) {
+    jstring name = (*env)->CallObjectMethod(env, method, reflect.Method__getName);
+    jstring signature = (*env)->CallStaticObjectMethod(env, reflect.Python, reflect.Python__getSignature, method);
+    PyObject *pname = java_string_to_python(env, name);
+    PyObject *psignature = java_string_to_python(env, signature);
+    PyObject *slot = NULL;
+
+    (*env)->DeleteLocalRef(env, name);
+    (*env)->DeleteLocalRef(env, signature);
+
+    if (pname && psignature) {
+        slot = PyObject_CallFunctionObjArgs(slot_handler, pname, psignature, NULL);
+    }
+    Py_XDECREF(pname);
+    Py_XDECREF(psignature);
+    return slot;
+}
+
+static size_t callback_signature_slot(CallbackSignature **table, size_t size, jmethodID method) {
+    size_t slot = ((size_t) method >> 3) & (size - 1);
+    while (table[slot] && table[slot]->method != method) {
+        slot = (slot + 1) & (size - 1);
+    }
+    return slot;
+}
+
+static CallbackSignature *callback_signature(JNIEnv *env, jobject method) {
+    jmethodID method_id = (*env)->FromReflectedMethod(env, method);
+    CallbackSignature *signature;
+    size_t slot;
+
+    if (callback_signatures) {
+        signature = callback_signatures[callback_signature_slot(callback_signatures, callback_signatures_size, method_id)];
+        if (signature) {
+            return signature;
+        }
+    }
+
+    // Grow the table so that it is never more than half full.
+    if (2 * (callback_signatures_count + 1) > callback_signatures_size) {
+        size_t size = callback_signatures_size ? 2 * callback_signatures_size : 64;
+        CallbackSignature **table = calloc(size, sizeof(CallbackSignature *));
+        size_t i;
+
+        if (table == NULL) {
+            PyErr_NoMemory();
+            return NULL;
+        }
+        for (i = 0; i < callback_signatures_size; i++) {
+            if (callback_signatures[i]) {
+                table[callback_signature_slot(table, size, callback_signatures[i]->method)] = callback_signatures[i];
+            }
+        }
+        free(callback_signatures);
+        callback_signatures = table;
+        callback_signatures_size = size;
+    }
+
+    PyObject *dispatch_slot = callback_dispatch_slot(env, method);
+    if (dispatch_slot == NULL) {
+        return NULL;
+    }
+
+    jobjectArray params = (*env)->CallObjectMethod(env, method, reflect.Method__getParameterTypes);
+    jsize argc = (*env)->GetArrayLength(env, params);
+    jsize i;
+
+    signature = malloc(sizeof(CallbackSignature) + argc);
+    if (signature == NULL) {
+        Py_DECREF(dispatch_slot);
+        (*env)->DeleteLocalRef(env, params);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    signature->method = method_id;
+    signature->slot = dispatch_slot;
+    signature->argc = argc;
+    signature->arg_types = (char *)(signature + 1);
+
+    for (i = 0; i < argc; i++) {
+        jclass param = (*env)->GetObjectArrayElement(env, params, i);
+        signature->arg_types[i] = type_code(env, param);
+        (*env)->DeleteLocalRef(env, param);
+    }
+    (*env)->DeleteLocalRef(env, params);
+
+    jclass return_type = (*env)->CallObjectMethod(env, method, reflect.Method__getReturnType);
+    signature->return_type = type_code(env, return_type);
+    signature->return_box = box_type_code(env, return_type);
+    (*env)->DeleteLocalRef(env, return_type);
+
+    slot = callback_signature_slot(callback_signatures, callback_signatures_size, method_id);
+    callback_signatures[slot] = signature;
+    callback_signatures_count++;
+    return signature;
+}
+
+/*
+ * Discard all cached callback signatures. Dispatch slots are only valid
+ * for the lifetime of the Python runtime that assigned them.
+ */
+static void clear_callback_signatures(void) {
+    size_t i;
+
+    for (i = 0; i < callback_signatures_size; i++) {
+        if (callback_signatures[i]) {
+            Py_DECREF(callback_signatures[i]->slot);
+            free(callback_signatures[i]);
+        }
+    }
+    free(callback_signatures);
+    callback_signatures = NULL;
+    callback_signatures_size = 0;
+    callback_signatures_count = 0;
+}
+
+/**************************************************************************
+ * Convert a Java object passed as a callback argument into a Python object.
+ *
+ * If the declared type of the argument is a primitive, the boxed value is
+ * unwrapped directly into the equivalent Python value. Any other object
+ * is passed to Python as the integer value of its JNI reference, to be
+ * wrapped by the dispatch mechanism.
+ *
+ * Returns a new Python reference, or NULL if an error occurred.
+ *************************************************************************/
+static PyObject *unbox_java_object(JNIEnv *env, jobject value, char type) {
+    PrimitiveType *primitive;
+    PyObject *result;
+    Py_UNICODE c;
+
+    if (type == 'L') {
+        return PyInt_FromLong((unsigned long) value);
+    }
+    if (value == NULL) {
+        Py_RETURN_NONE;
+    }
+
+    primitive = primitive_type(type);
+    switch (type) {
+        case 'Z':
+            result = PyBool_FromLong((*env)->CallBooleanMethod(env, value, primitive->value));
+            break;
+        case 'B':
+            result = PyInt_FromLong((*env)->CallByteMethod(env, value, primitive->value));
+            break;
+        case 'C':
+            c = (*env)->CallCharMethod(env, value, primitive->value);
+            result = PyUnicode_FromUnicode(&c, 1);
+            break;
+        case 'S':
+            result = PyInt_FromLong((*env)->CallShortMethod(env, value, primitive->value));
+            break;
+        case 'I':
+            result = PyInt_FromLong((*env)->CallIntMethod(env, value, primitive->value));
+            break;
+        case 'J':
+            result = PyLong_FromLongLong((*env)->CallLongMethod(env, value, primitive->value));
+            break;
+        case 'F':
+            result = PyFloat_FromDouble((*env)->CallFloatMethod(env, value, primitive->value));
+            break;
+        case 'D':
+            result = PyFloat_FromDouble((*env)->CallDoubleMethod(env, value, primitive->value));
+            break;
+        default:
+            PyErr_Format(PyExc_ValueError, "Unknown JNI type code '%c'", type);
+            return NULL;
+    }
+    // The boxed value isn't needed any more.
+    (*env)->DeleteLocalRef(env, value);
+    return result;
+}
+
+/**************************************************************************
+ * Convert a Python object into a Java object, so that it can be returned
+ * from a Java method whose return type has the given JNI type code.
+ *
+ * Primitive return types are boxed; strings are converted into Java
+ * strings; and JavaInstance/JavaProxy objects are unwrapped to the Java
+ * object they represent.
+ *
+ * Returns a new local reference, or NULL. If the conversion failed, a
+ * Python exception will be set.
+ *************************************************************************/
+static jobject box_python_object(JNIEnv *env, PyObject *value, char type) {
+    PrimitiveType *primitive;
+    jvalue jval;
+
+    if (type == 'V' || value == Py_None) {
+        return NULL;
+    }
+
+    if (type == 'L') {
+        // The declared type is an object; pick the best representation
+        // for the Python type.
+        if (PyUnicode_Check(value) || PyString_Check(value)) {
+            return python_to_java_string(env, value);
+        } else if (PyBool_Check(value)) {
+            type = 'Z';
+        } else if (PyInt_Check(value)) {
+            long lval = PyInt_AS_LONG(value);
+            type = (lval == (jint) lval) ? 'I' : 'J';
+        } else if (PyLong_Check(value)) {
+            type = 'J';
+        } else if (PyFloat_Check(value)) {
+            type = 'D';
+        } else {
+            PyObject *jni = PyObject_GetAttrString(value, "_jni");
+            PyObject *address;
+            void *ref;
+
+            if (jni == NULL) {
+                PyErr_Clear();
+                PyErr_Format(PyExc_TypeError, "Can't convert %s object to a Java object", Py_TYPE(value)->tp_name);
+                return NULL;
+            }
+            address = PyObject_GetAttrString(jni, "value");
+            Py_DECREF(jni);
+            if (address == NULL) {
+                return NULL;
+            }
+            ref = (address == Py_None) ? NULL : PyLong_AsVoidPtr(address);
+            Py_DECREF(address);
+            if (ref == NULL) {
+                return NULL;
+            }
+            return (*env)->NewLocalRef(env, (jobject) ref);
+        }
+    }
+
+    switch (type) {
+        case 'Z':
+            jval.z = PyObject_IsTrue(value) ? JNI_TRUE : JNI_FALSE;
+            break;
+        case 'B':
+            jval.b = (jbyte) PyInt_AsLong(value);
+            break;
+        case 'C':
+            if (PyUnicode_Check(value) && PyUnicode_GET_SIZE(value) == 1) {
+                jval.c = (jchar) PyUnicode_AS_UNICODE(value)[0];
+            } else {
+                jval.c = (jchar) PyInt_AsLong(value);
+            }
+            break;
+        case 'S':
+            jval.s = (jshort) PyInt_AsLong(value);
+            break;
+        case 'I':
+            jval.i = (jint) PyInt_AsLong(value);
+            break;
+        case 'J':
+            jval.j = (jlong) PyLong_AsLongLong(value);
+            break;
+        case 'F':
+            jval.f = (jfloat) PyFloat_AsDouble(value);
+            break;
+        case 'D':
+            jval.d = (jdouble) PyFloat_AsDouble(value);
+            break;
+        default:
+            PyErr_Format(PyExc_ValueError, "Unknown JNI type code '%c'", type);
+            return NULL;
+    }
+    if (PyErr_Occurred()) {
+        return NULL;
+    }
+
+    primitive = primitive_type(type);
+    return (*env)->CallStaticObjectMethodA(env, primitive->box, primitive->valueOf, &jval);
+}
+
+/*
+ * Convert the value returned by a Python implementation of a Java
+ * interface method into the object returned by the invocation handler.
+ *
+ * If the method is declared as returning a box class, the value is
+ * boxed as that class (e.g., a Long, rather than the Integer that a
+ * small int would otherwise become). A primitive return value can't be
+ * None, as there would be nothing for the proxy to unbox.
+ *
+ * Returns a new local reference, or NULL. If the conversion failed, a
+ * Python exception will be set.
+ */
+static jobject box_callback_result(JNIEnv *env, PyObject *value, CallbackSignature *signature) {
+    if (signature->return_type == 'V') {
+        return NULL;
+    } else if (value == Py_None) {
+        if (signature->return_type != 'L') {
+            PyErr_Format(PyExc_TypeError, "Interface method must return a '%c' value, not None", signature->return_type);
+        }
+        return NULL;
+    } else if (signature->return_box) {
+        return box_python_object(env, value, signature->return_box);
+    }
+    return box_python_object(env, value, signature->return_type);
+}
+
+/*
+ * Rethrow the current Python exception in Java as a RuntimeException
+ * whose message is "ExcType: value". The Python traceback is printed,
+ * and the Python exception is cleared.
+ */
+static void throw_python_exception(JNIEnv *env) {
+    PyObject *type, *value, *traceback;
+    PyObject *name = NULL;
+    PyObject *description = NULL;
+    PyObject *message = NULL;
+
+    PyErr_Fetch(&type, &value, &traceback);
+    PyErr_NormalizeException(&type, &value, &traceback);
+    if (type) {
+        name = PyObject_GetAttrString(type, "__name__");
+    }
+    if (value) {
+        description = PyObject_Str(value);
+    }
+    if (name && PyString_Check(name) && description && PyString_Check(description)) {
+        message = PyString_FromFormat("%s: %s", PyString_AS_STRING(name), PyString_AS_STRING(description));
+    }
+    Py_XDECREF(name);
+    Py_XDECREF(description);
+    PyErr_Clear();
+
+    PyErr_Restore(type, value, traceback);
+    PyErr_Print();
+    PyErr_Clear();
+
+    (*env)->ThrowNew(env, reflect.RuntimeException, message ? PyString_AS_STRING(message) : "Python exception");
+    Py_XDECREF(message);
+}
+
+/**************************************************************************
+ **************************************************************************
+ * Native fast path for Python to Java calls
+ *
+ * The _rubicon module exposes Method and Field objects that perform
+ * argument conversion, the JNI call, and conversion of the result
+ * entirely in C, and ArrayView and DirectBuffer objects that expose the
+ * content of Java primitive arrays and direct ByteBuffers using the
+ * buffer protocol. The ctypes bindings in rubicon.java.jni are used as a
+ * fallback when this module isn't available.
+ **************************************************************************
+ *************************************************************************/
+
+// The Python function used to select a polymorph when a method is
+// invoked with a combination of argument types that hasn't been seen before.
+static PyObject *select_polymorph_hook = NULL;
+
+// The Python function used to wrap Java objects returned by a call.
+static PyObject *wrap_object_hook = NULL;
+
+// The maximum number of argument type combinations that will be
+// remembered for each method.
+#define MAX_RESOLUTIONS 8
+
+// The number of arguments that can be marshalled without allocating.
+#define STATIC_ARGS 16
+
+/*
+ * Determine the JNI type code for a single type signature. Objects are
+ * reported as 'L', and arrays as '['; except for one dimensional arrays of
+ * primitives, which are reported using the lower case code of the element
+ * type (e.g., 'i' for int[]).
+ */
+static char jni_type_code(const char *signature) {
+    if (signature[0] == '[' && signature[1] && strchr("ZBCSIJFD", signature[1])) {
+        return signature[1] - 'A' + 'a';
+    }
+    return signature[0];
+}
+
+/*
+ * Determine the number of arguments, and the JNI type code of each
+ * argument, described by a parameter signature. If codes is NULL, only
+ * the argument count is returned. Returns -1 if the signature is malformed.
+ */
+static Py_ssize_t parse_params_signature(const char *signature, char *codes) {
+    Py_ssize_t argc = 0;
+    const char *c = signature;
+
+    while (*c) {
+        char code = jni_type_code(c);
+        if (*c == '[') {
+            while (*c == '[') {
+                c++;
+            }
+        }
+        if (*c == 'L') {
+            c = strchr(c, ';');
+            if (c == NULL) {
+                return -1;
+            }
+        } else if (*c == 0 || strchr("ZBCSIJFD", *c) == NULL) {
+            return -1;
+        }
+        c++;
+        if (codes) {
+            codes[argc] = code;
+        }
+        argc++;
+    }
+    return argc;
+}
+
+/*
+ * Retrieve the JNI reference wrapped by a JavaInstance or JavaProxy.
+ * Returns 0 on success; -1 (with a Python exception set) on failure.
+ */
+static int python_to_jobject(PyObject *value, jobject *ref) {
+    PyObject *jni;
+    PyObject *address;
+
+    jni = PyObject_GetAttrString(value, "_jni");
+    if (jni == NULL) {
+        PyErr_Clear();
+        PyErr_Format(PyExc_ValueError, "Unknown argument type %s", Py_TYPE(value)->tp_name);
+        return -1;
+    }
+    address = PyObject_GetAttrString(jni, "value");
+    Py_DECREF(jni);
+    if (address == NULL) {
+        return -1;
+    }
+    if (address == Py_None) {
+        *ref = NULL;
+    } else {
+        *ref = (jobject) PyLong_AsVoidPtr(address);
+    }
+    Py_DECREF(address);
+    return PyErr_Occurred() ? -1 : 0;
+}
+
+/*
+ * The layout of the elements of each type of primitive array, described
+ * using the buffer protocol's struct-module format codes.
+ */
+typedef struct {
+    char type;
+    Py_ssize_t itemsize;
+    char *format;
+} ArrayFormat;
+
+static ArrayFormat array_formats[] = {
+    {'Z', sizeof(jboolean), "?"},
+    {'B', sizeof(jbyte), "b"},
+    {'C', sizeof(jchar), "H"},
+    {'S', sizeof(jshort), "h"},
+    {'I', sizeof(jint), "i"},
+    {'J', sizeof(jlong), "q"},
+    {'F', sizeof(jfloat), "f"},
+    {'D', sizeof(jdouble), "d"},
+    {0, 0, NULL}
+};
+
+static ArrayFormat *array_format(char type) {
+    ArrayFormat *format;
+    for (format = array_formats; format->type; format++) {
+        if (format->type == type) {
+            return format;
+        }
+    }
+    return NULL;
+}
+
+static void *get_array_elements(JNIEnv *env, jarray array, char type, jboolean *is_copy) {
+    switch (type) {
+        case 'Z': return (*env)->GetBooleanArrayElements(env, array, is_copy);
+        case 'B': return (*env)->GetByteArrayElements(env, array, is_copy);
+        case 'C': return (*env)->GetCharArrayElements(env, array, is_copy);
+        case 'S': return (*env)->GetShortArrayElements(env, array, is_copy);
+        case 'I': return (*env)->GetIntArrayElements(env, array, is_copy);
+        case 'J': return (*env)->GetLongArrayElements(env, array, is_copy);
+        case 'F': return (*env)->GetFloatArrayElements(env, array, is_copy);
+        case 'D': return (*env)->GetDoubleArrayElements(env, array, is_copy);
+    }
+    return NULL;
+}
+
+static void release_array_elements(JNIEnv *env, jarray array, char type, void *elements, jint mode) {
+    switch (type) {
+        case 'Z': (*env)->ReleaseBooleanArrayElements(env, array, elements, mode); break;
+        case 'B': (*env)->ReleaseByteArrayElements(env, array, elements, mode); break;
+        case 'C': (*env)->ReleaseCharArrayElements(env, array, elements, mode); break;
+        case 'S': (*env)->ReleaseShortArrayElements(env, array, elements, mode); break;
+        case 'I': (*env)->ReleaseIntArrayElements(env, array, elements, mode); break;
+        case 'J': (*env)->ReleaseLongArrayElements(env, array, elements, mode); break;
+        case 'F': (*env)->ReleaseFloatArrayElements(env, array, elements, mode); break;
+        case 'D': (*env)->ReleaseDoubleArrayElements(env, array, elements, mode); break;
+    }
+}
+
+/*
+ * Create a new Java primitive array, populated with the content of a
+ * Python object that supports the buffer protocol. The content is copied
+ * directly from the buffer into the Java array.
+ *
+ * Returns a local reference to the array, or NULL (with a Python
+ * exception set) on failure.
+ */
+static jarray python_buffer_to_java_array(JNIEnv *env, PyObject *data, char type) {
+    ArrayFormat *format = array_format(type);
+    Py_buffer view;
+    const void *buf;
+    Py_ssize_t len;
+    jsize count;
+    jarray array = NULL;
+    int new_buffer = 0;
+
+    if (format == NULL) {
+        PyErr_Format(PyExc_ValueError, "Unknown primitive array type '%c'", type);
+        return NULL;
+    }
+
+    if (PyObject_CheckBuffer(data)) {
+        if (PyObject_GetBuffer(data, &view, PyBUF_CONTIG_RO) < 0) {
+            return NULL;
+        }
+        new_buffer = 1;
+        buf = view.buf;
+        len = view.len;
+    } else if (PyObject_AsReadBuffer(data, &buf, &len) < 0) {
+        return NULL;
+    }
+
+    if (len % format->itemsize) {
+        PyErr_Format(PyExc_ValueError,
+            "Buffer size (%zd bytes) is not a multiple of the element size of '%c' arrays", len, type);
+        goto done;
+    }
+    count = (jsize) (len / format->itemsize);
+
+    switch (type) {
+        case 'Z': array = (*env)->NewBooleanArray(env, count); break;
+        case 'B': array = (*env)->NewByteArray(env, count); break;
+        case 'C': array = (*env)->NewCharArray(env, count); break;
+        case 'S': array = (*env)->NewShortArray(env, count); break;
+        case 'I': array = (*env)->NewIntArray(env, count); break;
+        case 'J': array = (*env)->NewLongArray(env, count); break;
+        case 'F': array = (*env)->NewFloatArray(env, count); break;
+        case 'D': array = (*env)->NewDoubleArray(env, count); break;
+    }
+    if (array == NULL) {
+        (*env)->ExceptionClear(env);
+        PyErr_NoMemory();
+        goto done;
+    }
+
+    switch (type) {
+        case 'Z': (*env)->SetBooleanArrayRegion(env, array, 0, count, buf); break;
+        case 'B': (*env)->SetByteArrayRegion(env, array, 0, count, buf); break;
+        case 'C': (*env)->SetCharArrayRegion(env, array, 0, count, buf); break;
+        case 'S': (*env)->SetShortArrayRegion(env, array, 0, count, buf); break;
+        case 'I': (*env)->SetIntArrayRegion(env, array, 0, count, buf); break;
+        case 'J': (*env)->SetLongArrayRegion(env, array, 0, count, buf); break;
+        case 'F': (*env)->SetFloatArrayRegion(env, array, 0, count, buf); break;
+        case 'D': (*env)->SetDoubleArrayRegion(env, array, 0, count, buf); break;
+    }
+
+done:
+    if (new_buffer) {
+        PyBuffer_Release(&view);
+    }
+    return array;
+}
+
+/*
+ * Convert a Python value into a jvalue, using the JNI type code of the
+ * parameter. Any Java object created as part of the conversion (strings,
+ * arrays, and proxies for Python objects) is a local reference; the
+ * conversion should be performed inside a local frame.
+ *
+ * Returns 0 on success; -1 (with a Python exception set) on failure.
+ */
+static int python_to_jvalue(JNIEnv *env, PyObject *arg, char code, jvalue *out) {
+    PyObject *value = arg;
+    int ret = 0;
+
+    if (code >= 'a' && code <= 'z') {
+        // A primitive array can be provided as a Java array, or as any
+        // Python object that supports the buffer protocol.
+        if (arg == Py_None) {
+            out->l = NULL;
+        } else if (!PyUnicode_Check(arg) && !PyString_Check(arg)
+                && (PyObject_CheckBuffer(arg) || PyObject_CheckReadBuffer(arg))) {
+            out->l = python_buffer_to_java_array(env, arg, code - 'a' + 'A');
+            return out->l ? 0 : -1;
+        } else {
+            return python_to_jobject(arg, &out->l);
+        }
+        return 0;
+    } else if (code == 'L' || code == '[') {
+        if (arg == Py_None) {
+            out->l = NULL;
+        } else if (PyUnicode_Check(arg) || PyString_Check(arg)) {
+            int cached;
+            out->l = python_to_java_string_cached(env, arg, &cached);
+            if (out->l == NULL) {
+                return -1;
+            }
+        } else {
+            return python_to_jobject(arg, &out->l);
+        }
+        return 0;
+    }
+
+    // ctypes primitives (jint, jdouble, ...) are unwrapped to their value.
+    if (!PyNumber_Check(arg) && !PyUnicode_Check(arg) && !PyString_Check(arg)) {
+        value = PyObject_GetAttrString(arg, "value");
+        if (value == NULL) {
+            PyErr_Clear();
+            PyErr_Format(PyExc_ValueError, "Unknown argument type %s", Py_TYPE(arg)->tp_name);
+            return -1;
+        }
+    } else {
+        Py_INCREF(value);
+    }
+
+    switch (code) {
+        case 'Z':
+            out->z = PyObject_IsTrue(value) ? JNI_TRUE : JNI_FALSE;
+            break;
+        case 'B':
+            out->b = (jbyte) PyInt_AsLong(value);
+            break;
+        case 'C':
+            if (PyUnicode_Check(value) && PyUnicode_GET_SIZE(value) == 1) {
+                out->c = (jchar) PyUnicode_AS_UNICODE(value)[0];
+            } else {
+                out->c = (jchar) PyInt_AsLong(value);
+            }
+            break;
+        case 'S':
+            out->s = (jshort) PyInt_AsLong(value);
+            break;
+        case 'I':
+            out->i = (jint) PyInt_AsLong(value);
+            break;
+        case 'J':
+            out->j = (jlong) PyLong_AsLongLong(value);
+            break;
+        case 'F':
+            out->f = (jfloat) PyFloat_AsDouble(value);
+            break;
+        case 'D':
+            out->d = (jdouble) PyFloat_AsDouble(value);
+            break;
+        default:
+            PyErr_Format(PyExc_ValueError, "Unknown JNI type code '%c'", code);
+            ret = -1;
+    }
+    Py_DECREF(value);
+    if (PyErr_Occurred()) {
+        ret = -1;
+    }
+    return ret;
+}
+
+/*
+ * If a Java exception is pending, clear it and raise it as a Python
+ * RuntimeError. Returns -1 if an exception was raised; 0 otherwise.
+ */
+static int check_java_exception(JNIEnv *env) {
+    jthrowable exc;
+    jclass exc_class;
+    jmethodID toString;
+    jstring description;
+    PyObject *message;
+
+    if (!(*env)->ExceptionCheck(env)) {
+        return 0;
+    }
+    exc = (*env)->ExceptionOccurred(env);
+    (*env)->ExceptionClear(env);
+
+    exc_class = (*env)->GetObjectClass(env, exc);
+    toString = (*env)->GetMethodID(env, exc_class, "toString", "()Ljava/lang/String;");
+    description = (*env)->CallObjectMethod(env, exc, toString);
+    if ((*env)->ExceptionCheck(env)) {
+        (*env)->ExceptionClear(env);
+        description = NULL;
+    }
+    message = java_string_to_python(env, description);
+    if (message) {
+        PyErr_SetObject(PyExc_RuntimeError, message);
+        Py_DECREF(message);
+    }
+
+    if (description) {
+        (*env)->DeleteLocalRef(env, description);
+    }
+    (*env)->DeleteLocalRef(env, exc_class);
+    (*env)->DeleteLocalRef(env, exc);
+    return -1;
+}
+
+/*
+ * Convert a value returned by a JNI call into a Python object.
+ * Local references to returned objects are consumed.
+ */
+static PyObject *jvalue_to_python(JNIEnv *env, jvalue *value, char code, int is_string, PyObject *signature) {
+    PyObject *result;
+    Py_UNICODE c;
+
+    switch (code) {
+        case 'V':
+            Py_RETURN_NONE;
+        case 'Z':
+            return PyBool_FromLong(value->z);
+        case 'B':
+            return PyInt_FromLong(value->b);
+        case 'C':
+            c = value->c;
+            return PyUnicode_FromUnicode(&c, 1);
+        case 'S':
+            return PyInt_FromLong(value->s);
+        case 'I':
+            return PyInt_FromLong(value->i);
+        case 'J':
+            if (value->j == (long) value->j) {
+                return PyInt_FromLong((long) value->j);
+            }
+            return PyLong_FromLongLong(value->j);
+        case 'F':
+            return PyFloat_FromDouble(value->f);
+        case 'D':
+            return PyFloat_FromDouble(value->d);
+    }
+
+    if (value->l == NULL) {
+        Py_RETURN_NONE;
+    }
+    if (is_string) {
+        result = java_string_to_python(env, value->l);
+        (*env)->DeleteLocalRef(env, value->l);
+        return result;
+    }
+    result = PyObject_CallFunction(wrap_object_hook, "NO", PyLong_FromVoidPtr(value->l), signature);
+    if (result == NULL) {
+        (*env)->DeleteLocalRef(env, value->l);
+    }
+    return result;
+}
+
+/**************************************************************************
+ * Method objects
+ *************************************************************************/
+
+typedef struct {
+    // The JNI method ID of the polymorph
+    jmethodID method;
+    // The JNI type code of the return value
+    char return_type;
+    // True if the return type is java.lang.String
+    int is_string;
+    // The full return signature
+    PyObject *return_signature;
+    // The number of arguments, and the JNI type code of each argument
+    Py_ssize_t argc;
+    char *arg_types;
+    // The number of local references an invocation can create; if
+    // non-zero, the invocation is performed inside a local frame.
+    jint frame_capacity;
+} Polymorph;
+
+typedef struct {
+    // The Python types of the arguments, and the polymorph they resolved to
+    Py_ssize_t argc;
+    PyTypeObject **types;
+    Py_ssize_t polymorph;
+} Resolution;
+
+typedef struct {
+    PyObject_HEAD
+    PyObject *descriptor;
+    PyObject *name;
+    jclass cls;
+    int is_static;
+    // If true, the GIL is released while the method runs
+    int blocking;
+
+    // A dictionary of params signature: index into polymorph_list
+    PyObject *polymorphs;
+    Polymorph *polymorph_list;
+    Py_ssize_t n_polymorphs;
+
+    Resolution resolutions[MAX_RESOLUTIONS];
+    int n_resolutions;
+    int next_resolution;
+} MethodObject;
+
+static void clear_resolution(Resolution *resolution) {
+    Py_ssize_t i;
+    for (i = 0; i < resolution->argc; i++) {
+        Py_XDECREF(resolution->types[i]);
+    }
+    free(resolution->types);
+    resolution->types = NULL;
+    resolution->argc = 0;
+}
+
+static void Method_dealloc(MethodObject *self) {
+    Py_ssize_t i;
+
+    for (i = 0; i < self->n_resolutions; i++) {
+        clear_resolution(&self->resolutions[i]);
+    }
+    for (i = 0; i < self->n_polymorphs; i++) {
+        Py_XDECREF(self->polymorph_list[i].return_signature);
+        free(self->polymorph_list[i].arg_types);
+    }
+    free(self->polymorph_list);
+    Py_XDECREF(self->polymorphs);
+    Py_XDECREF(self->descriptor);
+    Py_XDECREF(self->name);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static int Method_init(MethodObject *self, PyObject *args, PyObject *kwargs) {
+    PyObject *cls;
+    int is_static;
+
+    if (!PyArg_ParseTuple(args, "OOOi", &self->descriptor, &self->name, &cls, &is_static)) {
+        return -1;
+    }
+    Py_INCREF(self->descriptor);
+    Py_INCREF(self->name);
+    self->cls = (jclass) PyLong_AsVoidPtr(cls);
+    if (PyErr_Occurred()) {
+        return -1;
+    }
+    self->is_static = is_static;
+    self->blocking = 1;
+    self->polymorphs = PyDict_New();
+    if (self->polymorphs == NULL) {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Retrieve a UTF-8 encoded version of a str or unicode object.
+ * Returns a new reference, or NULL on error.
+ */
+static PyObject *utf8_string(PyObject *value) {
+    if (PyUnicode_Check(value)) {
+        return PyUnicode_AsUTF8String(value);
+    }
+    if (PyString_Check(value)) {
+        Py_INCREF(value);
+        return value;
+    }
+    PyErr_Format(PyExc_TypeError, "Expected a string, not %s", Py_TYPE(value)->tp_name);
+    return NULL;
+}
+
+static PyObject *Method_add(MethodObject *self, PyObject *args) {
+    PyObject *params_signature;
+    PyObject *return_signature;
+    PyObject *method;
+    PyObject *index;
+    PyObject *params = NULL;
+    PyObject *ret = NULL;
+    Polymorph *polymorph;
+    Polymorph *polymorph_list;
+    Py_ssize_t i;
+
+    if (!PyArg_ParseTuple(args, "OOO", &params_signature, &return_signature, &method)) {
+        return NULL;
+    }
+    if (PyDict_GetItem(self->polymorphs, params_signature)) {
+        Py_RETURN_NONE;
+    }
+    params = utf8_string(params_signature);
+    ret = utf8_string(return_signature);
+    if (params == NULL || ret == NULL) {
+        goto error;
+    }
+
+    polymorph_list = realloc(self->polymorph_list, (self->n_polymorphs + 1) * sizeof(Polymorph));
+    if (polymorph_list == NULL) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    self->polymorph_list = polymorph_list;
+    polymorph = &self->polymorph_list[self->n_polymorphs];
+
+    polymorph->argc = parse_params_signature(PyString_AS_STRING(params), NULL);
+    if (polymorph->argc < 0) {
+        PyErr_Format(PyExc_ValueError, "Invalid parameter signature '%s'", PyString_AS_STRING(params));
+        goto error;
+    }
+    polymorph->arg_types = malloc(polymorph->argc + 1);
+    if (polymorph->arg_types == NULL) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    parse_params_signature(PyString_AS_STRING(params), polymorph->arg_types);
+
+    // Strings and arrays passed as arguments, and objects returned by the
+    // method, are local references.
+    polymorph->frame_capacity = 0;
+    for (i = 0; i < polymorph->argc; i++) {
+        if (!primitive_type(polymorph->arg_types[i])) {
+            polymorph->frame_capacity++;
+        }
+    }
+
+    polymorph->method = (jmethodID) PyLong_AsVoidPtr(method);
+    polymorph->return_type = jni_type_code(PyString_AS_STRING(ret));
+    polymorph->is_string = (strcmp(PyString_AS_STRING(ret), "Ljava/lang/String;") == 0);
+    if (polymorph->return_type == 'L' || polymorph->return_type == '['
+            || (polymorph->return_type >= 'a' && polymorph->return_type <= 'z')) {
+        polymorph->frame_capacity++;
+    }
+    polymorph->return_signature = PyUnicode_FromString(PyString_AS_STRING(ret));
+    if (polymorph->return_signature == NULL) {
+        free(polymorph->arg_types);
+        goto error;
+    }
+
+    index = PyInt_FromSsize_t(self->n_polymorphs);
+    if (index == NULL || PyDict_SetItem(self->polymorphs, params_signature, index) < 0) {
+        Py_XDECREF(index);
+        Py_DECREF(polymorph->return_signature);
+        free(polymorph->arg_types);
+        goto error;
+    }
+    Py_DECREF(index);
+    self->n_polymorphs++;
+
+    Py_DECREF(params);
+    Py_DECREF(ret);
+    Py_RETURN_NONE;
+
+error:
+    Py_XDECREF(params);
+    Py_XDECREF(ret);
+    return NULL;
+}
+
+/*
+ * Determine if the outcome of resolution is fully determined by the type
+ * of an argument. This is true for Python scalars and strings, ctypes
+ * scalars, and Java objects (whose class determines what they can be
+ * assigned to);
+ * it isn't true for buffers and Java arrays, which are resolved using
+ * the type of their content.
+ */
+static int is_stable_type(PyTypeObject *type) {
+    if (type == &PyBool_Type || type == &PyInt_Type || type == &PyLong_Type
+            || type == &PyFloat_Type || type == &PyUnicode_Type || type == &PyString_Type) {
+        return 1;
+    }
+    return PyObject_HasAttrString((PyObject *) type, "_descriptor")
+        || PyObject_HasAttrString((PyObject *) type, "_type_");
+}
+
+/*
+ * Find the polymorph that will be used for a list of arguments.
+ *
+ * For most arguments, the result of resolution depends only on the types
+ * of the arguments, so the outcome of each resolution is remembered,
+ * keyed by those types.
+ */
+static Polymorph *Method_resolve(MethodObject *self, PyObject *args, Py_ssize_t offset) {
+    Py_ssize_t argc = PyTuple_GET_SIZE(args) - offset;
+    Py_ssize_t i;
+    int r;
+    PyObject *resolver_args;
+    PyObject *resolved;
+    PyObject *index;
+    Resolution *resolution;
+
+    for (r = 0; r < self->n_resolutions; r++) {
+        resolution = &self->resolutions[r];
+        if (resolution->argc != argc) {
+            continue;
+        }
+        for (i = 0; i < argc; i++) {
+            if (resolution->types[i] != Py_TYPE(PyTuple_GET_ITEM(args, offset + i))) {
+                break;
+            }
+        }
+        if (i == argc) {
+            return &self->polymorph_list[resolution->polymorph];
+        }
+    }
+
+    // No previous resolution; ask Python to select a polymorph.
+    resolver_args = PyTuple_GetSlice(args, offset, offset + argc);
+    if (resolver_args == NULL) {
+        return NULL;
+    }
+    resolved = PyObject_CallFunction(select_polymorph_hook, "OO", self->polymorphs, resolver_args);
+    Py_DECREF(resolver_args);
+    if (resolved == NULL) {
+        if (PyErr_ExceptionMatches(PyExc_KeyError)) {
+            PyObject *type, *value, *traceback;
+            PyObject *options;
+
+            PyErr_Fetch(&type, &value, &traceback);
+            PyErr_NormalizeException(&type, &value, &traceback);
+            options = PyDict_Keys(self->polymorphs);
+            if (options) {
+                PyObject *message = PyString_FromFormat(
+                    "Can't find Java %smethod '%%s.%%s' matching argument signature '%%s'. Options are: %%s",
+                    self->is_static ? "static " : "instance ");
+                PyObject *format_args = Py_BuildValue("(OOOO)", self->descriptor, self->name, value ? value : Py_None, options);
+                if (message && format_args) {
+                    PyObject *formatted = PyString_Format(message, format_args);
+                    if (formatted) {
+                        PyErr_SetObject(PyExc_ValueError, formatted);
+                        Py_DECREF(formatted);
+                    }
+                }
+                Py_XDECREF(message);
+                Py_XDECREF(format_args);
+                Py_DECREF(options);
+            }
+            Py_XDECREF(type);
+            Py_XDECREF(value);
+            Py_XDECREF(traceback);
+        }
+        return NULL;
+    }
+    index = PySequence_GetItem(resolved, 2);
+    Py_DECREF(resolved);
+    if (index == NULL) {
+        return NULL;
+    }
+    i = PyInt_AsSsize_t(index);
+    Py_DECREF(index);
+    if (i < 0 || i >= self->n_polymorphs) {
+        if (!PyErr_Occurred()) {
+            PyErr_SetString(PyExc_RuntimeError, "Polymorph selection returned an invalid index");
+        }
+        return NULL;
+    }
+
+    for (r = 0; r < argc; r++) {
+        if (!is_stable_type(Py_TYPE(PyTuple_GET_ITEM(args, offset + r)))) {
+            return &self->polymorph_list[i];
+        }
+    }
+
+    // Remember the resolution, replacing the oldest entry if the table is full.
+    if (self->n_resolutions < MAX_RESOLUTIONS) {
+        resolution = &self->resolutions[self->n_resolutions++];
+    } else {
+        resolution = &self->resolutions[self->next_resolution];
+        self->next_resolution = (self->next_resolution + 1) % MAX_RESOLUTIONS;
+        clear_resolution(resolution);
+    }
+    resolution->types = malloc((argc ? argc : 1) * sizeof(PyTypeObject *));
+    if (resolution->types) {
+        resolution->argc = argc;
+        resolution->polymorph = i;
+        for (r = 0; r < argc; r++) {
+            resolution->types[r] = Py_TYPE(PyTuple_GET_ITEM(args, offset + r));
+            Py_INCREF(resolution->types[r]);
+        }
+    } else {
+        resolution->argc = -1;
+    }
+
+    return &self->polymorph_list[i];
+}
+
+static void invoke_polymorph(JNIEnv *env, MethodObject *self, Polymorph *polymorph, jobject instance, jvalue *jargs, jvalue *result) {
+    jmethodID method = polymorph->method;
+    // Methods that have been declared non-blocking run with the GIL held.
+    PyThreadState *thread_state = self->blocking ? PyEval_SaveThread() : NULL;
+
+    if (self->is_static) {
+        jclass cls = self->cls;
+        switch (polymorph->return_type) {
+            case 'V': (*env)->CallStaticVoidMethodA(env, cls, method, jargs); break;
+            case 'Z': result->z = (*env)->CallStaticBooleanMethodA(env, cls, method, jargs); break;
+            case 'B': result->b = (*env)->CallStaticByteMethodA(env, cls, method, jargs); break;
+            case 'C': result->c = (*env)->CallStaticCharMethodA(env, cls, method, jargs); break;
+            case 'S': result->s = (*env)->CallStaticShortMethodA(env, cls, method, jargs); break;
+            case 'I': result->i = (*env)->CallStaticIntMethodA(env, cls, method, jargs); break;
+            case 'J': result->j = (*env)->CallStaticLongMethodA(env, cls, method, jargs); break;
+            case 'F': result->f = (*env)->CallStaticFloatMethodA(env, cls, method, jargs); break;
+            case 'D': result->d = (*env)->CallStaticDoubleMethodA(env, cls, method, jargs); break;
+            default: result->l = (*env)->CallStaticObjectMethodA(env, cls, method, jargs); break;
+        }
+    } else {
+        switch (polymorph->return_type) {
+            case 'V': (*env)->CallVoidMethodA(env, instance, method, jargs); break;
+            case 'Z': result->z = (*env)->CallBooleanMethodA(env, instance, method, jargs); break;
+            case 'B': result->b = (*env)->CallByteMethodA(env, instance, method, jargs); break;
+            case 'C': result->c = (*env)->CallCharMethodA(env, instance, method, jargs); break;
+            case 'S': result->s = (*env)->CallShortMethodA(env, instance, method, jargs); break;
+            case 'I': result->i = (*env)->CallIntMethodA(env, instance, method, jargs); break;
+            case 'J': result->j = (*env)->CallLongMethodA(env, instance, method, jargs); break;
+            case 'F': result->f = (*env)->CallFloatMethodA(env, instance, method, jargs); break;
+            case 'D': result->d = (*env)->CallDoubleMethodA(env, instance, method, jargs); break;
+            default: result->l = (*env)->CallObjectMethodA(env, instance, method, jargs); break;
+        }
+    }
+
+    if (thread_state) {
+        PyEval_RestoreThread(thread_state);
+    }
+}
+
+static PyObject *Method_call(MethodObject *self, PyObject *args, PyObject *kwargs) {
+    JNIEnv *env = java_env();
+    Py_ssize_t offset = self->is_static ? 0 : 1;
+    jobject instance = NULL;
+    Polymorph *polymorph;
+    jvalue static_jargs[STATIC_ARGS];
+    jvalue *jargs = static_jargs;
+    jvalue result;
+    Py_ssize_t i;
+    PyObject *value = NULL;
+
+    if (kwargs && PyDict_Size(kwargs)) {
+        PyErr_SetString(PyExc_TypeError, "Java methods can't be invoked with keyword arguments");
+        return NULL;
+    }
+    if (PyTuple_GET_SIZE(args) < offset) {
+        PyErr_SetString(PyExc_TypeError, "Java instance methods must be invoked with an instance");
+        return NULL;
+    }
+    if (!self->is_static && python_to_jobject(PyTuple_GET_ITEM(args, 0), &instance) < 0) {
+        return NULL;
+    }
+
+    polymorph = Method_resolve(self, args, offset);
+    if (polymorph == NULL) {
+        return NULL;
+    }
+
+    if (polymorph->argc > STATIC_ARGS) {
+        jargs = malloc(polymorph->argc * sizeof(jvalue));
+        if (jargs == NULL) {
+            return PyErr_NoMemory();
+        }
+    }
+
+    // Any local reference created by the invocation (converted arguments,
+    // the returned object, and anything created while wrapping it) is
+    // released when the frame is popped. Objects that escape to Python
+    // are promoted to global references when they are wrapped.
+    if (polymorph->frame_capacity && (*env)->PushLocalFrame(env, polymorph->frame_capacity) < 0) {
+        (*env)->ExceptionClear(env);
+        PyErr_NoMemory();
+        goto cleanup;
+    }
+
+    for (i = 0; i < polymorph->argc; i++) {
+        if (python_to_jvalue(env, PyTuple_GET_ITEM(args, offset + i), polymorph->arg_types[i], &jargs[i]) < 0) {
+            goto pop_frame;
+        }
+    }
+
+    invoke_polymorph(env, self, polymorph, instance, jargs, &result);
+
+    if (check_java_exception(env) == 0) {
+        value = jvalue_to_python(env, &result, polymorph->return_type, polymorph->is_string, polymorph->return_signature);
+    }
+
+pop_frame:
+    if (polymorph->frame_capacity) {
+        (*env)->PopLocalFrame(env, NULL);
+    }
+cleanup:
+    if (jargs != static_jargs) {
+        free(jargs);
+    }
+    return value;
+}
+
+static PyObject *Method_set_blocking(MethodObject *self, PyObject *args) {
+    int blocking;
+
+    if (!PyArg_ParseTuple(args, "i", &blocking)) {
+        return NULL;
+    }
+    self->blocking = blocking;
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef Method_methods[] = {
+    {"add", (PyCFunction) Method_add, METH_VARARGS, "Register a polymorph: add(params_signature, return_signature, method_id)."},
+    {"set_blocking", (PyCFunction) Method_set_blocking, METH_VARARGS, "Set whether the GIL is released while the method runs: set_blocking(blocking)."},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyTypeObject MethodType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "_rubicon.Method",                          /* tp_name */
+    sizeof(MethodObject),                       /* tp_basicsize */
+    0,                                          /* tp_itemsize */
+    (destructor) Method_dealloc,                /* tp_dealloc */
+    0,                                          /* tp_print */
+    0,                                          /* tp_getattr */
+    0,                                          /* tp_setattr */
+    0,                                          /* tp_compare */
+    0,                                          /* tp_repr */
+    0,                                          /* tp_as_number */
+    0,                                          /* tp_as_sequence */
+    0,                                          /* tp_as_mapping */
+    0,                                          /* tp_hash */
+    (ternaryfunc) Method_call,                  /* tp_call */
+    0,                                          /* tp_str */
+    0,                                          /* tp_getattro */
+    0,                                          /* tp_setattro */
+    0,                                          /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                         /* tp_flags */
+    "A callable wrapper around a (possibly polymorphic) Java method.\n\n"
+    "Method(descriptor, name, class_ref, static)",  /* tp_doc */
+    0,                                          /* tp_traverse */
+    0,                                          /* tp_clear */
+    0,                                          /* tp_richcompare */
+    0,                                          /* tp_weaklistoffset */
+    0,                                          /* tp_iter */
+    0,                                          /* tp_iternext */
+    Method_methods,                             /* tp_methods */
+    0,                                          /* tp_members */
+    0,                                          /* tp_getset */
+    0,                                          /* tp_base */
+    0,                                          /* tp_dict */
+    0,                                          /* tp_descr_get */
+    0,                                          /* tp_descr_set */
+    0,                                          /* tp_dictoffset */
+    (initproc) Method_init,                     /* tp_init */
+    0,                                          /* tp_alloc */
+    PyType_GenericNew,                          /* tp_new */
+};
+
+/**************************************************************************
+ * Field objects
+ *************************************************************************/
+
+typedef struct {
+    PyObject_HEAD
+    jclass cls;
+    jfieldID field;
+    int is_static;
+    // The JNI type code of the field
+    char type;
+    // True if the field is a java.lang.String
+    int is_string;
+    // The full type signature of the field
+    PyObject *signature;
+} FieldObject;
+
+static void Field_dealloc(FieldObject *self) {
+    Py_XDECREF(self->signature);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static int Field_init(FieldObject *self, PyObject *args, PyObject *kwargs) {
+    PyObject *cls;
+    PyObject *field;
+    const char *signature;
+    int is_static;
+
+    if (!PyArg_ParseTuple(args, "OOsi", &cls, &field, &signature, &is_static)) {
+        return -1;
+    }
+    self->cls = (jclass) PyLong_AsVoidPtr(cls);
+    self->field = (jfieldID) PyLong_AsVoidPtr(field);
+    if (PyErr_Occurred()) {
+        return -1;
+    }
+    self->is_static = is_static;
+    self->type = jni_type_code(signature);
+    self->is_string = (strcmp(signature, "Ljava/lang/String;") == 0);
+    self->signature = PyUnicode_FromString(signature);
+    return self->signature ? 0 : -1;
+}
+
+static PyObject *Field_get(FieldObject *self, PyObject *args) {
+    JNIEnv *env = java_env();
+    PyObject *py_instance = NULL;
+    jobject instance = NULL;
+    jvalue value;
+
+    if (!PyArg_ParseTuple(args, self->is_static ? ":get" : "O:get", &py_instance)) {
+        return NULL;
+    }
+    if (py_instance && python_to_jobject(py_instance, &instance) < 0) {
+        return NULL;
+    }
+
+    if (self->is_static) {
+        switch (self->type) {
+            case 'Z': value.z = (*env)->GetStaticBooleanField(env, self->cls, self->field); break;
+            case 'B': value.b = (*env)->GetStaticByteField(env, self->cls, self->field); break;
+            case 'C': value.c = (*env)->GetStaticCharField(env, self->cls, self->field); break;
+            case 'S': value.s = (*env)->GetStaticShortField(env, self->cls, self->field); break;
+            case 'I': value.i = (*env)->GetStaticIntField(env, self->cls, self->field); break;
+            case 'J': value.j = (*env)->GetStaticLongField(env, self->cls, self->field); break;
+            case 'F': value.f = (*env)->GetStaticFloatField(env, self->cls, self->field); break;
+            case 'D': value.d = (*env)->GetStaticDoubleField(env, self->cls, self->field); break;
+            default: value.l = (*env)->GetStaticObjectField(env, self->cls, self->field); break;
+        }
+    } else {
+        switch (self->type) {
+            case 'Z': value.z = (*env)->GetBooleanField(env, instance, self->field); break;
+            case 'B': value.b = (*env)->GetByteField(env, instance, self->field); break;
+            case 'C': value.c = (*env)->GetCharField(env, instance, self->field); break;
+            case 'S': value.s = (*env)->GetShortField(env, instance, self->field); break;
+            case 'I': value.i = (*env)->GetIntField(env, instance, self->field); break;
+            case 'J': value.j = (*env)->GetLongField(env, instance, self->field); break;
+            case 'F': value.f = (*env)->GetFloatField(env, instance, self->field); break;
+            case 'D': value.d = (*env)->GetDoubleField(env, instance, self->field); break;
+            default: value.l = (*env)->GetObjectField(env, instance, self->field); break;
+        }
+    }
+    if (check_java_exception(env) < 0) {
+        return NULL;
+    }
+    return jvalue_to_python(env, &value, self->type, self->is_string, self->signature);
+}
+
+static PyObject *Field_set(FieldObject *self, PyObject *args) {
+    JNIEnv *env = java_env();
+    PyObject *py_instance = NULL;
+    PyObject *py_value;
+    jobject instance = NULL;
+    int frame = !primitive_type(self->type);
+    jvalue value;
+
+    if (self->is_static) {
+        if (!PyArg_ParseTuple(args, "O:set", &py_value)) {
+            return NULL;
+        }
+    } else {
+        if (!PyArg_ParseTuple(args, "OO:set", &py_instance, &py_value)) {
+            return NULL;
+        }
+        if (python_to_jobject(py_instance, &instance) < 0) {
+            return NULL;
+        }
+    }
+
+    // Converting an object can create a local reference.
+    if (frame && (*env)->PushLocalFrame(env, 1) < 0) {
+        (*env)->ExceptionClear(env);
+        return PyErr_NoMemory();
+    }
+    if (python_to_jvalue(env, py_value, self->type, &value) < 0) {
+        if (frame) {
+            (*env)->PopLocalFrame(env, NULL);
+        }
+        return NULL;
+    }
+
+    if (self->is_static) {
+        switch (self->type) {
+            case 'Z': (*env)->SetStaticBooleanField(env, self->cls, self->field, value.z); break;
+            case 'B': (*env)->SetStaticByteField(env, self->cls, self->field, value.b); break;
+            case 'C': (*env)->SetStaticCharField(env, self->cls, self->field, value.c); break;
+            case 'S': (*env)->SetStaticShortField(env, self->cls, self->field, value.s); break;
+            case 'I': (*env)->SetStaticIntField(env, self->cls, self->field, value.i); break;
+            case 'J': (*env)->SetStaticLongField(env, self->cls, self->field, value.j); break;
+            case 'F': (*env)->SetStaticFloatField(env, self->cls, self->field, value.f); break;
+            case 'D': (*env)->SetStaticDoubleField(env, self->cls, self->field, value.d); break;
+            default: (*env)->SetStaticObjectField(env, self->cls, self->field, value.l); break;
+        }
+    } else {
+        switch (self->type) {
+            case 'Z': (*env)->SetBooleanField(env, instance, self->field, value.z); break;
+            case 'B': (*env)->SetByteField(env, instance, self->field, value.b); break;
+            case 'C': (*env)->SetCharField(env, instance, self->field, value.c); break;
+            case 'S': (*env)->SetShortField(env, instance, self->field, value.s); break;
+            case 'I': (*env)->SetIntField(env, instance, self->field, value.i); break;
+            case 'J': (*env)->SetLongField(env, instance, self->field, value.j); break;
+            case 'F': (*env)->SetFloatField(env, instance, self->field, value.f); break;
+            case 'D': (*env)->SetDoubleField(env, instance, self->field, value.d); break;
+            default: (*env)->SetObjectField(env, instance, self->field, value.l); break;
+        }
+    }
+    if (frame) {
+        (*env)->PopLocalFrame(env, NULL);
+    }
+    if (check_java_exception(env) < 0) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef Field_methods[] = {
+    {"get", (PyCFunction) Field_get, METH_VARARGS, "Retrieve the value of the field: get([instance])."},
+    {"set", (PyCFunction) Field_set, METH_VARARGS, "Set the value of the field: set([instance,] value)."},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyTypeObject FieldType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "_rubicon.Field",                           /* tp_name */
+    sizeof(FieldObject),                        /* tp_basicsize */
+    0,                                          /* tp_itemsize */
+    (destructor) Field_dealloc,                 /* tp_dealloc */
+    0,                                          /* tp_print */
+    0,                                          /* tp_getattr */
+    0,                                          /* tp_setattr */
+    0,                                          /* tp_compare */
+    0,                                          /* tp_repr */
+    0,                                          /* tp_as_number */
+    0,                                          /* tp_as_sequence */
+    0,                                          /* tp_as_mapping */
+    0,                                          /* tp_hash */
+    0,                                          /* tp_call */
+    0,                                          /* tp_str */
+    0,                                          /* tp_getattro */
+    0,                                          /* tp_setattro */
+    0,                                          /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,                         /* tp_flags */
+    "An accessor for a Java field.\n\n"
+    "Field(class_ref, field_id, signature, static)",  /* tp_doc */
+    0,                                          /* tp_traverse */
+    0,                                          /* tp_clear */
+    0,                                          /* tp_richcompare */
+    0,                                          /* tp_weaklistoffset */
+    0,                                          /* tp_iter */
+    0,                                          /* tp_iternext */
+    Field_methods,                              /* tp_methods */
+    0,                                          /* tp_members */
+    0,                                          /* tp_getset */
+    0,                                          /* tp_base */
+    0,                                          /* tp_dict */
+    0,                                          /* tp_descr_get */
+    0,                                          /* tp_descr_set */
+    0,                                          /* tp_dictoffset */
+    (initproc) Field_init,                      /* tp_init */
+    0,                                          /* tp_alloc */
+    PyType_GenericNew,                          /* tp_new */
+};
+
+/**************************************************************************
+ * Array views
+ *************************************************************************/
+
+typedef struct {
+    PyObject_HEAD
+    // A global reference to the array being viewed
+    jarray array;
+    ArrayFormat *format;
+    Py_ssize_t length;
+    // The pinned (or copied) content of the array; NULL once released
+    void *elements;
+    jboolean is_copy;
+    int readonly;
+    // The number of buffers currently exported
+    Py_ssize_t exports;
+    // Storage for the shape and strides of exported buffers
+    Py_ssize_t shape;
+    Py_ssize_t stride;
+} ArrayViewObject;
+
+/*
+ * Release the elements of the array back to Java. If commit is true,
+ * and the view isn't read only, any changes are copied back into the array.
+ */
+static void ArrayView_release_elements(ArrayViewObject *self, int commit) {
+    JNIEnv *env;
+    jint mode = (commit && !self->readonly) ? 0 : JNI_ABORT;
+
+    if (self->elements == NULL) {
+        return;
+    }
+    env = java_env();
+    release_array_elements(env, self->array, self->format->type, self->elements, mode);
+    self->elements = NULL;
+}
+
+static void ArrayView_dealloc(ArrayViewObject *self) {
+    ArrayView_release_elements(self, 1);
+    if (self->array) {
+        JNIEnv *env = java_env();
+        (*env)->DeleteGlobalRef(env, self->array);
+    }
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static int ArrayView_init(ArrayViewObject *self, PyObject *args, PyObject *kwargs) {
+    static char *kwlist[] = {"array", "type", "readonly", NULL};
+    JNIEnv *env = java_env();
+    PyObject *address;
+    char type;
+    int readonly = 0;
+    jarray array;
+
+    if (self->array) {
+        PyErr_SetString(PyExc_RuntimeError, "Array view has already been initialized");
+        return -1;
+    }
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Oc|i", kwlist, &address, &type, &readonly)) {
+        return -1;
+    }
+    self->format = array_format(type);
+    if (self->format == NULL) {
+        PyErr_Format(PyExc_ValueError, "Unknown primitive array type '%c'", type);
+        return -1;
+    }
+    array = (jarray) PyLong_AsVoidPtr(address);
+    if (array == NULL) {
+        if (!PyErr_Occurred()) {
+            PyErr_SetString(PyExc_ValueError, "Can't view a null array");
+        }
+        return -1;
+    }
+
+    self->array = (*env)->NewGlobalRef(env, array);
+    self->length = (*env)->GetArrayLength(env, self->array);
+    self->readonly = readonly;
+    self->shape = self->length;
+    self->stride = self->format->itemsize;
+
+    // The elements can't be pinned with GetPrimitiveArrayCritical: the
+    // view is held across arbitrary Python code, which may make JNI calls
+    // or block on the GIL.
+    self->elements = get_array_elements(env, self->array, type, &self->is_copy);
+    if (self->elements == NULL) {
+        (*env)->ExceptionClear(env);
+        PyErr_NoMemory();
+        return -1;
+    }
+    return 0;
+}
+
+static int ArrayView_check(ArrayViewObject *self) {
+    if (self->elements == NULL) {
+        PyErr_SetString(PyExc_ValueError, "Operation on a released array view");
+        return -1;
+    }
+    return 0;
+}
+
+static PyObject *ArrayView_release(ArrayViewObject *self, PyObject *args, PyObject *kwargs) {
+    static char *kwlist[] = {"commit", NULL};
+    int commit = 1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|i:release", kwlist, &commit)) {
+        return NULL;
+    }
+    if (self->exports) {
+        PyErr_SetString(PyExc_BufferError, "Can't release an array view while its buffer is in use");
+        return NULL;
+    }
+    ArrayView_release_elements(self, commit);
+    Py_RETURN_NONE;
+}
+
+static PyObject *ArrayView_commit(ArrayViewObject *self) {
+    JNIEnv *env = java_env();
+
+    if (ArrayView_check(self) < 0) {
+        return NULL;
+    }
+    // A view of the array itself (rather than a copy) doesn't need to be committed.
+    if (self->is_copy && !self->readonly) {
+        release_array_elements(env, self->array, self->format->type, self->elements, JNI_COMMIT);
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *ArrayView_enter(ArrayViewObject *self) {
+    if (ArrayView_check(self) < 0) {
+        return NULL;
+    }
+    Py_INCREF(self);
+    return (PyObject *) self;
+}
+
+static PyObject *ArrayView_exit(ArrayViewObject *self, PyObject *args) {
+    PyObject *exc_type = Py_None;
+    PyObject *exc_value = Py_None;
+    PyObject *traceback = Py_None;
+
+    if (!PyArg_UnpackTuple(args, "__exit__", 0, 3, &exc_type, &exc_value, &traceback)) {
+        return NULL;
+    }
+    if (self->exports) {
+        PyErr_SetString(PyExc_BufferError, "Can't release an array view while its buffer is in use");
+        return NULL;
+    }
+    // Changes are discarded if the block raised an exception.
+    ArrayView_release_elements(self, exc_type == Py_None);
+    Py_RETURN_FALSE;
+}
+
+static Py_ssize_t ArrayView_length(ArrayViewObject *self) {
+    return self->length;
+}
+
+static PyObject *ArrayView_get_is_copy(ArrayViewObject *self, void *closure) {
+    return PyBool_FromLong(self->is_copy);
+}
+
+static PyObject *ArrayView_get_readonly(ArrayViewObject *self, void *closure) {
+    return PyBool_FromLong(self->readonly);
+}
+
+static PyObject *ArrayView_get_released(ArrayViewObject *self, void *closure) {
+    return PyBool_FromLong(self->elements == NULL);
+}
+
+// The old-style buffer interface; used by Python 2 APIs such as
+// buffer(), array.array.fromstring() and numpy.frombuffer().
+static Py_ssize_t ArrayView_getreadbuffer(ArrayViewObject *self, Py_ssize_t segment, void **ptr) {
+    if (segment != 0) {
+        PyErr_SetString(PyExc_SystemError, "Accessing non-existent array view segment");
+        return -1;
+    }
+    if (ArrayView_check(self) < 0) {
+        return -1;
+    }
+    *ptr = self->elements;
+    return self->length * self->format->itemsize;
+}
+
+static Py_ssize_t ArrayView_getwritebuffer(ArrayViewObject *self, Py_ssize_t segment, void **ptr) {
+    if (self->readonly) {
+        PyErr_SetString(PyExc_TypeError, "Array view is read only");
+        return -1;
+    }
+    return ArrayView_getreadbuffer(self, segment, ptr);
+}
+
+static Py_ssize_t ArrayView_getsegcount(ArrayViewObject *self, Py_ssize_t *lenp) {
+    if (lenp) {
+        *lenp = self->elements ? self->length * self->format->itemsize : 0;
+    }
+    return 1;
+}
+
+static Py_ssize_t ArrayView_getcharbuffer(ArrayViewObject *self, Py_ssize_t segment, char **ptr) {
+    return ArrayView_getreadbuffer(self, segment, (void **) ptr);
+}
+
+// The new-style buffer interface; used by memoryview.
+static int ArrayView_getbuffer(ArrayViewObject *self, Py_buffer *view, int flags) {
+    if (ArrayView_check(self) < 0) {
+        return -1;
+    }
+    if ((flags & PyBUF_WRITABLE) && self->readonly) {
+        PyErr_SetString(PyExc_BufferError, "Array view is read only");
+        return -1;
+    }
+
+    view->obj = (PyObject *) self;
+    Py_INCREF(self);
+    view->buf = self->elements;
+    view->len = self->length * self->format->itemsize;
+    view->readonly = self->readonly;
+    view->itemsize = self->format->itemsize;
+    view->format = (flags & PyBUF_FORMAT) ? self->format->format : NULL;
+    view->ndim = 1;
+    view->shape = (flags & PyBUF_ND) ? &self->shape : NULL;
+    view->strides = ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) ? &self->stride : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+
+    self->exports++;
+    return 0;
+}
+
+static void ArrayView_releasebuffer(ArrayViewObject *self, Py_buffer *view) {
+    self->exports--;
+}
+
+static PyBufferProcs ArrayView_as_buffer = {
+    (readbufferproc) ArrayView_getreadbuffer,
+    (writebufferproc) ArrayView_getwritebuffer,
+    (segcountproc) ArrayView_getsegcount,
+    (charbufferproc) ArrayView_getcharbuffer,
+    (getbufferproc) ArrayView_getbuffer,
+    (releasebufferproc) ArrayView_releasebuffer,
+};
+
+static PySequenceMethods ArrayView_as_sequence = {
+    (lenfunc) ArrayView_length,                 /* sq_length */
+};
+
+static PyMethodDef ArrayView_methods[] = {
+    {"release", (PyCFunction) ArrayView_release, METH_VARARGS | METH_KEYWORDS,
+        "Release the array elements back to Java: release(commit=True)."},
+    {"commit", (PyCFunction) ArrayView_commit, METH_NOARGS,
+        "Copy any changes back into the Java array, without releasing the view."},
+    {"__enter__", (PyCFunction) ArrayView_enter, METH_NOARGS, NULL},
+    {"__exit__", (PyCFunction) ArrayView_exit, METH_VARARGS, NULL},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyGetSetDef ArrayView_getset[] = {
+    {"is_copy", (getter) ArrayView_get_is_copy, NULL, "True if the view is a copy of the Java array.", NULL},
+    {"readonly", (getter) ArrayView_get_readonly, NULL, "True if changes to the view are discarded.", NULL},
+    {"released", (getter) ArrayView_get_released, NULL, "True if the view has been released.", NULL},
+    {NULL, NULL, NULL, NULL, NULL}
+};
+
+static PyTypeObject ArrayViewType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "_rubicon.ArrayView",                       /* tp_name */
+    sizeof(ArrayViewObject),                    /* tp_basicsize */
+    0,                                          /* tp_itemsize */
+    (destructor) ArrayView_dealloc,             /* tp_dealloc */
+    0,                                          /* tp_print */
+    0,                                          /* tp_getattr */
+    0,                                          /* tp_setattr */
+    0,                                          /* tp_compare */
+    0,                                          /* tp_repr */
+    0,                                          /* tp_as_number */
+    &ArrayView_as_sequence,                     /* tp_as_sequence */
+    0,                                          /* tp_as_mapping */
+    0,                                          /* tp_hash */
+    0,                                          /* tp_call */
+    0,                                          /* tp_str */
+    0,                                          /* tp_getattro */
+    0,                                          /* tp_setattro */
+    &ArrayView_as_buffer,                       /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER, /* tp_flags */
+    "A buffer protocol view of the elements of a Java primitive array.\n\n"
+    "ArrayView(array_ref, type, readonly=False)\n\n"
+    "The elements are pinned (or copied) when the view is created, and\n"
+    "released when the view is released, exits a with block, or is\n"
+    "deleted.",                                 /* tp_doc */
+    0,                                          /* tp_traverse */
+    0,                                          /* tp_clear */
+    0,                                          /* tp_richcompare */
+    0,                                          /* tp_weaklistoffset */
+    0,                                          /* tp_iter */
+    0,                                          /* tp_iternext */
+    ArrayView_methods,                          /* tp_methods */
+    0,                                          /* tp_members */
+    ArrayView_getset,                           /* tp_getset */
+    0,                                          /* tp_base */
+    0,                                          /* tp_dict */
+    0,                                          /* tp_descr_get */
+    0,                                          /* tp_descr_set */
+    0,                                          /* tp_dictoffset */
+    (initproc) ArrayView_init,                  /* tp_init */
+    0,                                          /* tp_alloc */
+    PyType_GenericNew,                          /* tp_new */
+};
+
+/**************************************************************************
+ * Direct byte buffers
+ *************************************************************************/
+
+typedef struct {
+    PyObject_HEAD
+    // A global reference to the java.nio.ByteBuffer; this keeps the
+    // memory of the buffer alive for as long as the view exists.
+    jobject buffer;
+    void *address;
+    Py_ssize_t capacity;
+    int readonly;
+    // Storage for the shape of exported buffers
+    Py_ssize_t shape;
+} DirectBufferObject;
+
+static void DirectBuffer_dealloc(DirectBufferObject *self) {
+    if (self->buffer) {
+        JNIEnv *env = java_env();
+        (*env)->DeleteGlobalRef(env, self->buffer);
+    }
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static int DirectBuffer_init(DirectBufferObject *self, PyObject *args, PyObject *kwargs) {
+    static char *kwlist[] = {"buffer", "readonly", NULL};
+    JNIEnv *env = java_env();
+    PyObject *address;
+    int readonly = 0;
+    jobject buffer;
+
+    if (self->buffer) {
+        PyErr_SetString(PyExc_RuntimeError, "Direct buffer has already been initialized");
+        return -1;
+    }
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|i", kwlist, &address, &readonly)) {
+        return -1;
+    }
+    buffer = (jobject) PyLong_AsVoidPtr(address);
+    if (buffer == NULL) {
+        if (!PyErr_Occurred()) {
+            PyErr_SetString(PyExc_ValueError, "Can't view a null buffer");
+        }
+        return -1;
+    }
+
+    self->address = (*env)->GetDirectBufferAddress(env, buffer);
+    self->capacity = (Py_ssize_t) (*env)->GetDirectBufferCapacity(env, buffer);
+    if (self->address == NULL || self->capacity < 0) {
+        PyErr_SetString(PyExc_ValueError, "Object is not a direct java.nio.Buffer");
+        return -1;
+    }
+    self->buffer = (*env)->NewGlobalRef(env, buffer);
+    self->readonly = readonly;
+    self->shape = self->capacity;
+    return 0;
+}
+
+static Py_ssize_t DirectBuffer_length(DirectBufferObject *self) {
+    return self->capacity;
+}
+
+static PyObject *DirectBuffer_get_readonly(DirectBufferObject *self, void *closure) {
+    return PyBool_FromLong(self->readonly);
+}
+
+static Py_ssize_t DirectBuffer_getreadbuffer(DirectBufferObject *self, Py_ssize_t segment, void **ptr) {
+    if (segment != 0) {
+        PyErr_SetString(PyExc_SystemError, "Accessing non-existent direct buffer segment");
+        return -1;
+    }
+    *ptr = self->address;
+    return self->capacity;
+}
+
+static Py_ssize_t DirectBuffer_getwritebuffer(DirectBufferObject *self, Py_ssize_t segment, void **ptr) {
+    if (self->readonly) {
+        PyErr_SetString(PyExc_TypeError, "Direct buffer is read only");
+        return -1;
+    }
+    return DirectBuffer_getreadbuffer(self, segment, ptr);
+}
+
+static Py_ssize_t DirectBuffer_getsegcount(DirectBufferObject *self, Py_ssize_t *lenp) {
+    if (lenp) {
+        *lenp = self->capacity;
+    }
+    return 1;
+}
+
+static Py_ssize_t DirectBuffer_getcharbuffer(DirectBufferObject *self, Py_ssize_t segment, char **ptr) {
+    return DirectBuffer_getreadbuffer(self, segment, (void **) ptr);
+}
+
+static int DirectBuffer_getbuffer(DirectBufferObject *self, Py_buffer *view, int flags) {
+    if ((flags & PyBUF_WRITABLE) && self->readonly) {
+        PyErr_SetString(PyExc_BufferError, "Direct buffer is read only");
+        return -1;
+    }
+    if (PyBuffer_FillInfo(view, (PyObject *) self, self->address, self->capacity, self->readonly, flags) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static PyBufferProcs DirectBuffer_as_buffer = {
+    (readbufferproc) DirectBuffer_getreadbuffer,
+    (writebufferproc) DirectBuffer_getwritebuffer,
+    (segcountproc) DirectBuffer_getsegcount,
+    (charbufferproc) DirectBuffer_getcharbuffer,
+    (getbufferproc) DirectBuffer_getbuffer,
+    NULL,
+};
+
+static PySequenceMethods DirectBuffer_as_sequence = {
+    (lenfunc) DirectBuffer_length,              /* sq_length */
+};
+
+static PyGetSetDef DirectBuffer_getset[] = {
+    {"readonly", (getter) DirectBuffer_get_readonly, NULL, "True if the buffer can't be modified.", NULL},
+    {NULL, NULL, NULL, NULL, NULL}
+};
+
+static PyTypeObject DirectBufferType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "_rubicon.DirectBuffer",                    /* tp_name */
+    sizeof(DirectBufferObject),                 /* tp_basicsize */
+    0,                                          /* tp_itemsize */
+    (destructor) DirectBuffer_dealloc,          /* tp_dealloc */
+    0,                                          /* tp_print */
+    0,                                          /* tp_getattr */
+    0,                                          /* tp_setattr */
+    0,                                          /* tp_compare */
+    0,                                          /* tp_repr */
+    0,                                          /* tp_as_number */
+    &DirectBuffer_as_sequence,                  /* tp_as_sequence */
+    0,                                          /* tp_as_mapping */
+    0,                                          /* tp_hash */
+    0,                                          /* tp_call */
+    0,                                          /* tp_str */
+    0,                                          /* tp_getattro */
+    0,                                          /* tp_setattro */
+    &DirectBuffer_as_buffer,                    /* tp_as_buffer */
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER, /* tp_flags */
+    "A buffer protocol view of the memory of a direct java.nio.ByteBuffer.\n\n"
+    "DirectBuffer(buffer_ref, readonly=False)\n\n"
+    "The view holds a global reference to the ByteBuffer, so the memory\n"
+    "remains valid for as long as the view exists.",  /* tp_doc */
+    0,                                          /* tp_traverse */
+    0,                                          /* tp_clear */
+    0,                                          /* tp_richcompare */
+    0,                                          /* tp_weaklistoffset */
+    0,                                          /* tp_iter */
+    0,                                          /* tp_iternext */
+    0,                                          /* tp_methods */
+    0,                                          /* tp_members */
+    DirectBuffer_getset,                        /* tp_getset */
+    0,                                          /* tp_base */
+    0,                                          /* tp_dict */
+    0,                                          /* tp_descr_get */
+    0,                                          /* tp_descr_set */
+    0,                                          /* tp_dictoffset */
+    (initproc) DirectBuffer_init,               /* tp_init */
+    0,                                          /* tp_alloc */
+    PyType_GenericNew,                          /* tp_new */
+};
+
+/*
+ * Ask Java to keep a Python object alive for as long as a Java object is
+ * reachable. The Python object is given a handle, which the tracker
+ * releases (by Python.release()) once the Java object has been collected.
+ *
+ * Returns 0 on success; -1 (with a Python exception set) on failure.
+ */
+static int track_python_object(JNIEnv *env, jobject obj, PyObject *owner) {
+    jlong handle = new_handle(owner);
+
+    if (handle == 0) {
+        return -1;
+    }
+    (*env)->CallStaticVoidMethod(env, reflect.Python, reflect.Python__track, obj, handle);
+    if (check_java_exception(env) < 0) {
+        Py_XDECREF(release_handle(handle));
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Expose the memory of a Python buffer to Java as a direct ByteBuffer.
+ *
+ * The Python object (or, for objects supporting the new buffer protocol,
+ * a memoryview holding the exported buffer) is kept alive until the
+ * ByteBuffer is collected by Java.
+ */
+static PyObject *rubicon_new_direct_buffer(PyObject *self, PyObject *args) {
+    JNIEnv *env = java_env();
+    PyObject *data;
+    PyObject *owner;
+    void *address;
+    Py_ssize_t len;
+    int readonly = 0;
+    jobject buffer;
+    jobject readonly_buffer;
+
+    if (!PyArg_ParseTuple(args, "O", &data)) {
+        return NULL;
+    }
+
+    if (PyObject_CheckBuffer(data)) {
+        Py_buffer *view;
+
+        owner = PyMemoryView_FromObject(data);
+        if (owner == NULL) {
+            return NULL;
+        }
+        view = PyMemoryView_GET_BUFFER(owner);
+        if (!PyBuffer_IsContiguous(view, 'A')) {
+            PyErr_SetString(PyExc_ValueError, "Only contiguous buffers can be shared with Java");
+            Py_DECREF(owner);
+            return NULL;
+        }
+        address = view->buf;
+        len = view->len;
+        readonly = view->readonly;
+    } else {
+        if (PyObject_AsWriteBuffer(data, &address, &len) < 0) {
+            PyErr_Clear();
+            if (PyObject_AsReadBuffer(data, (const void **) &address, &len) < 0) {
+                return NULL;
+            }
+            readonly = 1;
+        }
+        owner = data;
+        Py_INCREF(owner);
+    }
+
+    buffer = (*env)->NewDirectByteBuffer(env, address, len);
+    if (buffer == NULL) {
+        (*env)->ExceptionClear(env);
+        PyErr_SetString(PyExc_RuntimeError, "Unable to create direct ByteBuffer");
+        Py_DECREF(owner);
+        return NULL;
+    }
+    if (readonly) {
+        readonly_buffer = (*env)->CallObjectMethod(env, buffer, reflect.ByteBuffer__asReadOnlyBuffer);
+        (*env)->DeleteLocalRef(env, buffer);
+        buffer = readonly_buffer;
+        if (check_java_exception(env) < 0) {
+            Py_DECREF(owner);
+            return NULL;
+        }
+    }
+
+    if (track_python_object(env, buffer, owner) < 0) {
+        (*env)->DeleteLocalRef(env, buffer);
+        Py_DECREF(owner);
+        return NULL;
+    }
+    Py_DECREF(owner);
+
+    return PyLong_FromVoidPtr(buffer);
+}
+
+/**************************************************************************
+ * The _rubicon module
+ *************************************************************************/
+
+static PyObject *rubicon_initialize(PyObject *self, PyObject *args) {
+    PyObject *select_polymorph;
+    PyObject *wrap_object;
+
+    if (!PyArg_ParseTuple(args, "OO", &select_polymorph, &wrap_object)) {
+        return NULL;
+    }
+    Py_INCREF(select_polymorph);
+    Py_XSETREF(select_polymorph_hook, select_polymorph);
+    Py_INCREF(wrap_object);
+    Py_XSETREF(wrap_object_hook, wrap_object);
+    Py_RETURN_NONE;
+}
+
+static PyObject *rubicon_new_array(PyObject *self, PyObject *args) {
+    JNIEnv *env = java_env();
+    char type;
+    PyObject *data;
+    jarray array;
+
+    if (!PyArg_ParseTuple(args, "cO", &type, &data)) {
+        return NULL;
+    }
+    array = python_buffer_to_java_array(env, data, type);
+    if (array == NULL) {
+        return NULL;
+    }
+    return PyLong_FromVoidPtr(array);
+}
+
+/*
+ * Copy the content of a Java primitive array into a writable Python
+ * buffer. The array is pinned with GetPrimitiveArrayCritical only for the
+ * duration of the copy; no Python code runs (and no other JNI calls are
+ * made) while it is pinned.
+ */
+static PyObject *rubicon_copy_array(PyObject *self, PyObject *args) {
+    JNIEnv *env = java_env();
+    PyObject *address;
+    PyObject *data;
+    char type;
+    ArrayFormat *format;
+    Py_buffer view;
+    int new_buffer = 0;
+    void *buf;
+    Py_ssize_t len;
+    jarray array;
+    jsize length;
+    void *elements;
+    PyObject *result = NULL;
+
+    if (!PyArg_ParseTuple(args, "OcO", &address, &type, &data)) {
+        return NULL;
+    }
+    format = array_format(type);
+    if (format == NULL) {
+        PyErr_Format(PyExc_ValueError, "Unknown primitive array type '%c'", type);
+        return NULL;
+    }
+    array = (jarray) PyLong_AsVoidPtr(address);
+    if (array == NULL) {
+        if (!PyErr_Occurred()) {
+            PyErr_SetString(PyExc_ValueError, "Can't copy a null array");
+        }
+        return NULL;
+    }
+    if (PyObject_CheckBuffer(data)) {
+        if (PyObject_GetBuffer(data, &view, PyBUF_CONTIG) < 0) {
+            return NULL;
+        }
+        new_buffer = 1;
+        buf = view.buf;
+        len = view.len;
+    } else if (PyObject_AsWriteBuffer(data, &buf, &len) < 0) {
+        return NULL;
+    }
+
+    length = (*env)->GetArrayLength(env, array);
+    if (len != (Py_ssize_t) length * format->itemsize) {
+        PyErr_Format(PyExc_ValueError,
+            "Buffer size (%zd bytes) doesn't match the size of the array (%zd bytes)",
+            len, (Py_ssize_t) length * format->itemsize);
+        goto done;
+    }
+
+    elements = (*env)->GetPrimitiveArrayCritical(env, array, NULL);
+    if (elements == NULL) {
+        (*env)->ExceptionClear(env);
+        PyErr_NoMemory();
+        goto done;
+    }
+    memcpy(buf, elements, len);
+    (*env)->ReleasePrimitiveArrayCritical(env, array, elements, JNI_ABORT);
+
+    Py_INCREF(Py_None);
+    result = Py_None;
+
+done:
+    if (new_buffer) {
+        PyBuffer_Release(&view);
+    }
+    return result;
+}
+
+static PyObject *rubicon_string_value(PyObject *self, PyObject *args) {
+    JNIEnv *env = java_env();
+    PyObject *address;
+    jstring str = NULL;
+
+    if (!PyArg_ParseTuple(args, "O", &address)) {
+        return NULL;
+    }
+    if (address != Py_None) {
+        str = (jstring) PyLong_AsVoidPtr(address);
+        if (PyErr_Occurred()) {
+            return NULL;
+        }
+    }
+    return java_string_to_python(env, str);
+}
+
+static PyObject *rubicon_java_string(PyObject *self, PyObject *args) {
+    JNIEnv *env = java_env();
+    PyObject *value;
+    jstring str;
+    int cached;
+
+    if (!PyArg_ParseTuple(args, "O", &value)) {
+        return NULL;
+    }
+    if (!PyUnicode_Check(value) && !PyString_Check(value)) {
+        PyErr_Format(PyExc_TypeError, "Expected a string, not %s", Py_TYPE(value)->tp_name);
+        return NULL;
+    }
+    str = python_to_java_string_cached(env, value, &cached);
+    if (str == NULL) {
+        return NULL;
+    }
+    return PyLong_FromVoidPtr(str);
+}
+
+static PyObject *rubicon_set_string_cache_size(PyObject *self, PyObject *args) {
+    Py_ssize_t size;
+
+    if (!PyArg_ParseTuple(args, "n", &size)) {
+        return NULL;
+    }
+    if (size < string_cache_size) {
+        clear_string_cache(java_env());
+    }
+    string_cache_size = size;
+    Py_RETURN_NONE;
+}
+
+static PyObject *rubicon_new_handle(PyObject *self, PyObject *args) {
+    PyObject *object;
+    jlong handle;
+
+    if (!PyArg_ParseTuple(args, "O", &object)) {
+        return NULL;
+    }
+    handle = new_handle(object);
+    if (handle == 0) {
+        return NULL;
+    }
+    return PyLong_FromLongLong(handle);
+}
+
+static PyObject *rubicon_resolve_handle(PyObject *self, PyObject *args) {
+    PY_LONG_LONG handle;
+    PyObject *object;
+
+    if (!PyArg_ParseTuple(args, "L", &handle)) {
+        return NULL;
+    }
+    object = resolve_handle(handle);
+    if (object == NULL) {
+        PyErr_Format(PyExc_KeyError, "Unknown Python instance handle %lld", (long long) handle);
+        return NULL;
+    }
+    Py_INCREF(object);
+    return object;
+}
+
+static PyObject *rubicon_release_handle(PyObject *self, PyObject *args) {
+    PY_LONG_LONG handle;
+    PyObject *object;
+
+    if (!PyArg_ParseTuple(args, "L", &handle)) {
+        return NULL;
+    }
+    object = release_handle(handle);
+    if (object == NULL) {
+        PyErr_Format(PyExc_KeyError, "Unknown Python instance handle %lld", (long long) handle);
+        return NULL;
+    }
+    Py_DECREF(object);
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef RubiconMethods[] = {
+    {"new_array", rubicon_new_array, METH_VARARGS, "Create a Java primitive array from the content of a buffer: new_array(type, data). Returns a local reference."},
+    {"new_direct_buffer", rubicon_new_direct_buffer, METH_VARARGS, "Expose the memory of a Python buffer to Java: new_direct_buffer(data). Returns a local reference to a direct ByteBuffer."},
+    {"copy_array", rubicon_copy_array, METH_VARARGS, "Copy the content of a Java primitive array into a writable buffer of the same size: copy_array(array_ref, type, buffer)."},
+    {"string_value", rubicon_string_value, METH_VARARGS, "Convert a Java string into a Python unicode object: string_value(string_ref)."},
+    {"java_string", rubicon_java_string, METH_VARARGS, "Create a Java string from a Python string: java_string(value). The returned reference may be a cached global reference, and must not be deleted."},
+    {"set_string_cache_size", rubicon_set_string_cache_size, METH_VARARGS, "Set the maximum number of strings in the string cache; 0 disables the cache: set_string_cache_size(size)."},
+    {"new_handle", rubicon_new_handle, METH_VARARGS, "Allocate a handle by which Java can refer to a Python object: new_handle(object). The object is kept alive until the handle is released."},
+    {"resolve_handle", rubicon_resolve_handle, METH_VARARGS, "Find the Python object for a handle: resolve_handle(handle). Raises KeyError if the handle is stale."},
+    {"release_handle", rubicon_release_handle, METH_VARARGS, "Release a handle, and the reference it holds: release_handle(handle)."},
+    {"initialize", rubicon_initialize, METH_VARARGS, "Register the Python hooks used by the fast path: initialize(select_polymorph, wrap_object)."},
+    {NULL, NULL, 0, NULL}
+};
+
+PyMODINIT_FUNC init_rubicon(void) {
+    PyObject *module;
+
+    if (PyType_Ready(&MethodType) < 0 || PyType_Ready(&FieldType) < 0 || PyType_Ready(&ArrayViewType) < 0
+            || PyType_Ready(&DirectBufferType) < 0) {
+        return;
+    }
+
+    module = Py_InitModule("_rubicon", RubiconMethods);
+    if (module == NULL) {
+        return;
+    }
+
+    Py_INCREF(&MethodType);
+    PyModule_AddObject(module, "Method", (PyObject *) &MethodType);
+    Py_INCREF(&FieldType);
+    PyModule_AddObject(module, "Field", (PyObject *) &FieldType);
+    Py_INCREF(&ArrayViewType);
+    PyModule_AddObject(module, "ArrayView", (PyObject *) &ArrayViewType);
+    Py_INCREF(&DirectBufferType);
+    PyModule_AddObject(module, "DirectBuffer", (PyObject *) &DirectBufferType);
+}
+
+/*
+ * Release everything that was acquired from the Python runtime, and
+ * finalize it. The GIL must be held by the calling thread.
+ */
+static void finalize_python(JNIEnv *env) {
+    Py_CLEAR(method_handler);
+    Py_CLEAR(batch_handler);
+    Py_CLEAR(slot_handler);
+    clear_callback_signatures();
+    clear_handles();
+    clear_string_cache(env);
+    Py_CLEAR(string_cache);
+    Py_Finalize();
+}
+
+/**************************************************************************
+ * Method to start the Python runtime.
+ *************************************************************************/
+JNIEXPORT jint JNICALL Java_org_pybee_rubicon_Python_start(JNIEnv *env, jobject thisObj, jstring pythonHome, jstring pythonPath, jstring rubiconLib) {
+    int ret = 0;
+    char pythonPathVar[512];
+    char rubiconLibVar[256];
+
+    LOG_I("Start Python runtime...");
+
+    // The runtime (and its GIL) is shared by the whole process; CPython 2.7
+    // sub-interpreters share the same GIL, so a second runtime couldn't run
+    // Python code in parallel with the first.
+    if (main_thread_state) {
+        LOG_E("Python runtime is already running");
+        return -3;
+    }
+
+    // Special environment to prefer .pyo, and don't write bytecode if .py are found
+    // because the process will not have write attribute on the device.
+    putenv("PYTHONOPTIMIZE=2");
+    putenv("PYTHONDONTWRITEBYTECODE=1");
+    putenv("PYTHONNOUSERSITE=1");
+    putenv("TARGET_ANDROID=1");
+
+    if (pythonHome) {
+        LOG_D("PYTHONHOME=%s", (*env)->GetStringUTFChars(env, pythonHome, NULL));
+        Py_SetPythonHome((char *)(*env)->GetStringUTFChars(env, pythonHome, NULL));
+    } else {
+        LOG_D("Using default PYTHONHOME");
+    }
+
+    if (pythonPath) {
+        sprintf(pythonPathVar, "PYTHONPATH=%s", (*env)->GetStringUTFChars(env, pythonPath, NULL));
+        LOG_D("%s", pythonPathVar);
+        putenv(pythonPathVar);
+    } else {
+        LOG_D("Using default PYTHONPATH");
+    }
+
+#ifdef ANDROID
+    // If we're on android, we need to specify the location of the Rubicon
+    // shared library as part of the environment.
+    if (rubiconLib) {
+        sprintf(rubiconLibVar, "RUBICON_LIBRARY=%s", (*env)->GetStringUTFChars(env, rubiconLib, NULL));
+        LOG_D("%s", rubiconLibVar);
+        putenv(rubiconLibVar);
+    } else {
+        LOG_D("Not setting RUBICON_LIBRARY");
+    }
+#endif
+
+    // putenv("PYTHONVERBOSE=1");
+
+    LOG_I("Initializing Python runtime...");
+    Py_Initialize();
+    // PySys_SetArgv(argc, argv);
+
+    // If other modules are using threads, we need to initialize them before.
+    PyEval_InitThreads();
+
+    // Initialize the native fast path module
+    LOG_I("Initializing Rubicon fast path module...");
+    init_rubicon();
+
+#ifdef ANDROID
+    // Initialize and bootstrap the Android logging module
+    LOG_I("Initializing Android logging module...");
+    initandroid();
+
+    LOG_D("Bootstrap Android logging...");
+    ret = PyRun_SimpleString(
+        "import sys\n" \
+        "import android\n" \
+        "class LogFile(object):\n" \
+        "    def __init__(self, level):\n" \
+        "        self.buffer = ''\n" \
+        "        self.level = level\n" \
+        "    def write(self, s):\n" \
+        "        s = self.buffer + s\n" \
+        "        lines = s.split(\"\\n\")\n" \
+        "        for line in lines[:-1]:\n" \
+        "            self.level(line)\n" \
+        "        self.buffer = lines[-1]\n" \
+        "    def flush(self):\n" \
+        "        return\n" \
+        "sys.stdout = LogFile(android.info)\n" \
+        "sys.stderr = LogFile(android.error)\n" \
+        "print 'Android Logging bootstrap active.'");
+    if (ret != 0) {
+        LOG_E("Exception during logging bootstrap.");
+    } else {
+        LOG_D("Python runtime started.");
+    }
+#endif
+
+    LOG_I("Import rubicon...");
+    PyObject *rubicon;
+
+    rubicon = PyImport_ImportModule("rubicon.java");
+    if (rubicon == NULL) {
+        LOG_E("Couldn't import rubicon python module");
+        PyErr_Print();
+        PyErr_Clear();
+        ret = -1;
+        goto failed;
+    }
+    LOG_D("Got rubicon python module");
+
+    method_handler = PyObject_GetAttrString(rubicon, "dispatch");
+    if (method_handler == NULL) {
+        LOG_E("Couldn't find method dipatch handler");
+        PyErr_Print();
+        PyErr_Clear();
+        Py_DECREF(rubicon);
+        ret = -2;
+        goto failed;
+    }
+    LOG_D("Got method dispatch handler");
+
+    batch_handler = PyObject_GetAttrString(rubicon, "dispatch_batch");
+    if (batch_handler == NULL) {
+        LOG_E("Couldn't find batch dispatch handler");
+        PyErr_Print();
+        PyErr_Clear();
+        Py_DECREF(rubicon);
+        ret = -2;
+        goto failed;
+    }
+    LOG_D("Got batch dispatch handler");
+
+    slot_handler = PyObject_GetAttrString(rubicon, "callback_slot");
+    if (slot_handler == NULL) {
+        LOG_E("Couldn't find method dispatch slot handler");
+        PyErr_Print();
+        PyErr_Clear();
+        Py_DECREF(rubicon);
+        ret = -2;
+        goto failed;
+    }
+    LOG_D("Got method dispatch slot handler");
+
+    Py_DECREF(rubicon);
+
+    // Release the GIL, so that other Java threads can call into Python.
+    main_thread_state = PyEval_SaveThread();
+
+    LOG_D("Python runtime started.");
+    return ret;
+
+failed:
+    // A runtime that failed to start is finalized, rather than being left
+    // half-started holding the GIL; start() can then be tried again, and
+    // stop() doesn't need to be called.
+    finalize_python(env);
+    LOG_E("Python runtime failed to start.");
     return ret;
 }
 
@@ -930,11 +4333,17 @@ JNIEXPORT jint JNICALL Java_org_pybee_rubicon_Python_run(JNIEnv *env, jobject th
         ret = 1;
         LOG_E("Unable to open %s", appNameStr);
     } else {
+        PyGILState_STATE gstate;
+        gstate = PyGILState_Ensure();
+
         ret = PyRun_SimpleFileEx(fd, appNameStr, 1);
         if (ret != 0) {
             LOG_E("Application quit abnormally!");
         }
+
+        PyGILState_Release(gstate);
     }
+    (*env)->ReleaseStringUTFChars(env, appName, appNameStr);
 
     return ret;
 }
@@ -943,17 +4352,80 @@ JNIEXPORT jint JNICALL Java_org_pybee_rubicon_Python_run(JNIEnv *env, jobject th
  * Method to stop the Python runtime.
  *************************************************************************/
 JNIEXPORT void JNICALL Java_org_pybee_rubicon_Python_stop(JNIEnv *env, jobject thisObj) {
-    if (java) {
+    if (main_thread_state) {
+        // Stop the callback dispatcher; Py_Finalize() waits for its
+        // thread to finish.
+        (*env)->CallStaticVoidMethod(env, reflect.PythonInstance, reflect.PythonInstance__stopDispatcher);
+
         LOG_D("Finalizing Python runtime...");
-        Py_Finalize();
-        java = NULL;
-        Py_XDECREF(method_handler);
+        PyEval_RestoreThread(main_thread_state);
+        main_thread_state = NULL;
+
+        finalize_python(env);
         LOG_I("Python runtime stopped.");
     } else {
         LOG_E("Python runtime doesn't appear to be running");
     }
 }
 
+/**************************************************************************
+ * Release the handle of a Python object that was being kept alive on
+ * behalf of a Java object that has now been collected.
+ *************************************************************************/
+JNIEXPORT void JNICALL Java_org_pybee_rubicon_Python_release(JNIEnv *env, jclass cls, jlong handle) {
+    PyGILState_STATE gstate;
+    PyObject *object;
+
+    // If the Python runtime has been stopped, there's nothing to release.
+    if (main_thread_state == NULL) {
+        return;
+    }
+
+    object = release_handle(handle);
+    if (object == NULL) {
+        LOG_E("Released unknown Python instance handle %lld", (long long) handle);
+        return;
+    }
+
+    gstate = PyGILState_Ensure();
+    Py_DECREF(object);
+    PyGILState_Release(gstate);
+}
+
+
+/**************************************************************************
+ * Convert the arguments of a callback into a Python tuple.
+ *
+ * The local references to object arguments are passed to Python as
+ * integers, so they must remain valid until the callback has returned.
+ *
+ * Returns a new Python reference.
+ *************************************************************************/
+static PyObject *callback_arguments(JNIEnv *env, CallbackSignature *signature, jobjectArray jargs) {
+    jsize argc = jargs ? (*env)->GetArrayLength(env, jargs) : 0;
+    PyObject *args = PyTuple_New(argc);
+    jsize i;
+
+    LOG_D("There are %d arguments", argc);
+    for (i = 0; i != argc; ++i) {
+        jobject jarg = (*env)->GetObjectArrayElement(env, jargs, i);
+        PyObject *arg;
+        if (i < signature->argc) {
+            arg = unbox_java_object(env, jarg, signature->arg_types[i]);
+        } else {
+            arg = PyInt_FromLong((unsigned long) jarg);
+        }
+        if (arg == NULL) {
+            LOG_E("Unable to convert callback argument %d", i);
+            PyErr_Print();
+            PyErr_Clear();
+            Py_INCREF(Py_None);
+            arg = Py_None;
+        }
+        PyTuple_SET_ITEM(args, i, arg);
+    }
+    return args;
+}
 
 /**************************************************************************
  * Implementation of the InvocationHandler used by all Python objects.
@@ -961,66 +4433,151 @@ JNIEXPORT void JNICALL Java_org_pybee_rubicon_Python_stop(JNIEnv *env, jobject t
  * This method converts the Python method invocation into a call on the
  * method dispatch method that has been registered as part of the runtime.
  *************************************************************************/
-JNIEXPORT jobject JNICALL Java_org_pybee_rubicon_PythonInstance_invoke(JNIEnv *env, jobject thisObj, jobject proxy, jobject method, jobjectArray jargs) {
+JNIEXPORT jobject JNICALL Java_org_pybee_rubicon_PythonInstance_invokePython(JNIEnv *env, jobject thisObj, jobject proxy, jobject method, jobjectArray jargs) {
     LOG_D("Invocation");
 
-    jclass PythonInstance = (*env)->FindClass(env, "org/pybee/rubicon/PythonInstance");
-    LOG_D("PythonInstance: %ld", (long)PythonInstance);
-    jfieldID PythonInstance__id = (*env)->GetFieldID(env, PythonInstance, "instance", "J");
-    LOG_D("id: %ld", (long)PythonInstance__id);
+    jlong instance = (*env)->GetLongField(env, thisObj, reflect.PythonInstance__instance);
+    LOG_D("instance: %lld", (long long) instance);
 
-    long instance = (*env)->GetLongField(env, thisObj, PythonInstance__id);
-    LOG_D("instance: %ld", instance);
-
-    jclass Method = (*env)->FindClass(env, "java/lang/reflect/Method");
-    jmethodID method__getName = (*env)->GetMethodID(env, Method, "getName", "()Ljava/lang/String;");
-
-    jobject method_name = (*env)->CallObjectMethod(env, method, method__getName);
-
-    LOG_D("Native invocation %ld :: %s", instance, (*env)->GetStringUTFChars(env, method_name, NULL));
+    // Every local reference created during the callback (the arguments,
+    // and any created by Java calls made by the Python implementation)
+    // is released when the frame is popped; only the result escapes.
+    if ((*env)->PushLocalFrame(env, (jargs ? (*env)->GetArrayLength(env, jargs) : 0) + 4) < 0) {
+        LOG_E("Unable to allocate local references for callback");
+        return NULL;
+    }
 
     PyGILState_STATE gstate;
     gstate = PyGILState_Ensure();
 
-    PyObject *result;
-    PyObject *pargs = PyTuple_New(3);
-    PyObject *pinstance = PyInt_FromLong(instance);
-    PyObject *pmethod_name = PyUnicode_FromFormat("%s", (*env)->GetStringUTFChars(env, method_name, NULL));
-    PyObject *args;
+    // The method is identified to Python by its dispatch slot, which is
+    // looked up by method ID; no strings are created for the call.
+    CallbackSignature *signature = callback_signature(env, method);
+    if (signature == NULL) {
+        LOG_E("Unable to determine callback signature");
+        throw_python_exception(env);
+        PyGILState_Release(gstate);
+        return (*env)->PopLocalFrame(env, NULL);
+    }
 
-    if (jargs) {
-        jsize argc = (*env)->GetArrayLength(env, jargs);
-        LOG_D("There are %d arguments", argc);
+    LOG_D("Native invocation %lld :: slot %ld", (long long) instance, PyInt_AsLong(signature->slot));
 
-        args = PyTuple_New(argc);
-        size_t i;
-        for (i = 0; i != argc; ++i) {
-            PyTuple_SET_ITEM(args, i, PyInt_FromLong((unsigned long)(*env)->GetObjectArrayElement(env, jargs, i)));
-        }
-    } else {
-        LOG_D("There are no arguments");
-        args = PyTuple_New(0);
+    // The target is resolved from its handle without a Python lookup;
+    // a stale handle (e.g., for an object that has been released) is
+    // detected by its generation.
+    PyObject *pinstance = resolve_handle(instance);
+    if (pinstance == NULL) {
+        LOG_E("Unknown Python instance handle %lld", (long long) instance);
+        PyGILState_Release(gstate);
+        return (*env)->PopLocalFrame(env, NULL);
     }
+    Py_INCREF(pinstance);
+
+    jobject jresult = NULL;
+    PyObject *result;
+    PyObject *pargs = PyTuple_New(3);
+    PyObject *args = callback_arguments(env, signature, jargs);
     LOG_D("Made arguments tuple");
 
     PyTuple_SET_ITEM(pargs, 0, pinstance);
-    PyTuple_SET_ITEM(pargs, 1, pmethod_name);
+    Py_INCREF(signature->slot);
+    PyTuple_SET_ITEM(pargs, 1, signature->slot);
     PyTuple_SET_ITEM(pargs, 2, args);
 
     result = PyObject_CallObject(method_handler, pargs);
 
     Py_DECREF(pargs);
 
+    // An exception raised by the implementation, or a result that can't
+    // be returned, is rethrown in Java once the frame is popped.
     if (result == NULL) {
         LOG_E("Error invoking callback");
-        PyErr_Print();
-        PyErr_Clear();
+        throw_python_exception(env);
     } else {
         LOG_D("Callback invoked");
+        jresult = box_callback_result(env, result, signature);
+        if (jresult == NULL && PyErr_Occurred()) {
+            LOG_E("Unable to convert callback return value");
+            throw_python_exception(env);
+        }
         Py_DECREF(result);
     }
     LOG_D("Native invocation done.");
 
     PyGILState_Release(gstate);
-    return NULL;
+    return (*env)->PopLocalFrame(env, jresult);
+}
+
+/**************************************************************************
+ * Deliver a batch of invocations of a void method to a Python object.
+ *
+ * The GIL is acquired once for the whole batch, and the batch dispatch
+ * handler is invoked with a list containing the arguments tuple of each
+ * invocation.
+ *************************************************************************/
+JNIEXPORT void JNICALL Java_org_pybee_rubicon_PythonInstance_invokePythonBatch(JNIEnv *env, jobject thisObj, jobject proxy, jobject method, jobjectArray jbatch) {
+    jlong instance = (*env)->GetLongField(env, thisObj, reflect.PythonInstance__instance);
+    jsize count = (*env)->GetArrayLength(env, jbatch);
+    jsize argc = 0;
+    jsize i;
+
+    LOG_D("Batch of %d invocations on %lld", count, (long long) instance);
+
+    // The arguments of every invocation must stay valid until the batch
+    // has been delivered.
+    if (count > 0) {
+        jobjectArray jargs = (*env)->GetObjectArrayElement(env, jbatch, 0);
+        argc = (*env)->GetArrayLength(env, jargs);
+        (*env)->DeleteLocalRef(env, jargs);
+    }
+    if ((*env)->PushLocalFrame(env, count * (argc + 1) + 4) < 0) {
+        LOG_E("Unable to allocate local references for callback batch");
+        return;
+    }
+
+    PyGILState_STATE gstate;
+    gstate = PyGILState_Ensure();
+
+    CallbackSignature *signature = callback_signature(env, method);
+    if (signature == NULL) {
+        LOG_E("Unable to determine callback signature");
+        throw_python_exception(env);
+        PyGILState_Release(gstate);
+        (*env)->PopLocalFrame(env, NULL);
+        return;
+    }
+
+    // The proxy is kept alive while invocations are buffered (and is an
+    // argument of this call), so the handle is only stale if it was
+    // never valid.
+    PyObject *pinstance = resolve_handle(instance);
+    if (pinstance == NULL) {
+        LOG_E("Unknown Python instance handle %lld", (long long) instance);
+        PyGILState_Release(gstate);
+        (*env)->PopLocalFrame(env, NULL);
+        return;
+    }
+    Py_INCREF(pinstance);
+
+    PyObject *batch = PyList_New(count);
+    for (i = 0; i != count; ++i) {
+        jobjectArray jargs = (*env)->GetObjectArrayElement(env, jbatch, i);
+        PyList_SET_ITEM(batch, i, callback_arguments(env, signature, jargs));
+    }
+
+    PyObject *result = PyObject_CallFunctionObjArgs(batch_handler, pinstance, signature->slot, batch, NULL);
+    Py_DECREF(pinstance);
+    Py_DECREF(batch);
+
+    // As for a single invocation, an exception raised by the
+    // implementation is rethrown in Java once the frame is popped.
+    if (result == NULL) {
+        LOG_E("Error invoking callback batch");
+        throw_python_exception(env);
+    } else {
+        Py_DECREF(result);
+    }
+
+    PyGILState_Release(gstate);
+    (*env)->PopLocalFrame(env, NULL);
 }
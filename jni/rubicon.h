@@ -29,12 +29,28 @@ JNIEXPORT jint JNICALL Java_org_pybee_rubicon_Python_run
 JNIEXPORT void JNICALL Java_org_pybee_rubicon_Python_stop
   (JNIEnv *, jobject);
 
+/*
+ * Class:     org_pybee_Python
+ * Method:    release
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_org_pybee_rubicon_Python_release
+  (JNIEnv *, jclass, jlong);
+
 /*
  * Class:     org_pybee_PythonInstance
- * Method:    invoke
+ * Method:    invokePython
  * Signature: (Ljava/lang/Object;Ljava/lang/reflect/Method;[Ljava/lang/Object;)Ljava/lang/Object;
  */
-JNIEXPORT jobject JNICALL Java_org_pybee_rubicon_PythonInstance_invoke
+JNIEXPORT jobject JNICALL Java_org_pybee_rubicon_PythonInstance_invokePython
+  (JNIEnv *, jobject, jobject, jobject, jobjectArray);
+
+/*
+ * Class:     org_pybee_PythonInstance
+ * Method:    invokePythonBatch
+ * Signature: (Ljava/lang/Object;Ljava/lang/reflect/Method;[[Ljava/lang/Object;)V
+ */
+JNIEXPORT void JNICALL Java_org_pybee_rubicon_PythonInstance_invokePythonBatch
   (JNIEnv *, jobject, jobject, jobject, jobjectArray);
 
 #ifdef __cplusplus
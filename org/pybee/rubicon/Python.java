@@ -1,33 +1,208 @@
 package org.pybee.rubicon;
 
+import java.io.File;
+import java.net.URI;
+import java.net.URL;
+
+import java.lang.ref.PhantomReference;
+import java.lang.ref.ReferenceQueue;
 import java.lang.reflect.Proxy;
 
+import java.lang.reflect.Constructor;
 import java.lang.reflect.Field;
 import java.lang.reflect.Method;
 import java.lang.reflect.Modifier;
 
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.Collections;
+import java.util.List;
 import java.util.Map;
 import java.util.HashMap;
 import java.util.HashSet;
 import java.util.Set;
+import java.util.concurrent.ConcurrentHashMap;
+import java.util.concurrent.ConcurrentMap;
 
 
 public class Python {
     /**
-     * A 2 level map of Class: Method name: Method for instance methods
+     * The public methods of a class, indexed by name.
+     *
+     * An index is built once, and never modified after it has been
+     * published, so it can be read by any number of threads without
+     * locking. The arrays it contains are shared; they must not be
+     * modified by callers.
+     */
+    private static class MethodIndex {
+        final Map<String, Method[]> instanceMethods = new HashMap<String, Method[]>();
+        final Map<String, String[]> instanceSignatures = new HashMap<String, String[]>();
+        final Map<String, Method[]> staticMethods = new HashMap<String, Method[]>();
+        final Map<String, String[]> staticSignatures = new HashMap<String, String[]>();
+
+        MethodIndex(Class cls) {
+            Map<String, List<Method>> instanceNameMap = new HashMap<String, List<Method>>();
+            Map<String, List<Method>> staticNameMap = new HashMap<String, List<Method>>();
+
+            for (Method method: cls.getMethods()) {
+                int modifiers = method.getModifiers();
+                if (Modifier.isPublic(modifiers)) {
+                    Map<String, List<Method>> nameMap = Modifier.isStatic(modifiers) ? staticNameMap : instanceNameMap;
+                    List<Method> alternatives = nameMap.get(method.getName());
+                    if (alternatives == null) {
+                        alternatives = new ArrayList<Method>();
+                        nameMap.put(method.getName(), alternatives);
+                    }
+                    alternatives.add(method);
+                }
+            }
+
+            index(instanceNameMap, instanceMethods, instanceSignatures);
+            index(staticNameMap, staticMethods, staticSignatures);
+        }
+
+        private static void index(Map<String, List<Method>> nameMap, Map<String, Method[]> methods, Map<String, String[]> signatures) {
+            for (Map.Entry<String, List<Method>> entry: nameMap.entrySet()) {
+                List<Method> candidates = withoutBridges(entry.getValue());
+                Method[] alternatives = candidates.toArray(new Method[candidates.size()]);
+                String[] alternativeSignatures = new String[alternatives.length];
+                for (int i = 0; i < alternatives.length; i++) {
+                    alternativeSignatures[i] = signature(alternatives[i].getParameterTypes(), alternatives[i].getReturnType());
+                }
+                methods.put(entry.getKey(), alternatives);
+                signatures.put(entry.getKey(), alternativeSignatures);
+            }
+        }
+
+        /**
+         * Remove the bridge methods that the compiler generated for methods
+         * with a covariant return type; they have the same parameters as
+         * the real method, so a call could resolve to either. A bridge that
+         * is the only public method with its parameters (e.g., a public
+         * method inherited from a package private class) is kept.
+         */
+        private static List<Method> withoutBridges(List<Method> alternatives) {
+            List<Method> result = new ArrayList<Method>(alternatives.size());
+            for (Method method: alternatives) {
+                if (method.isBridge() && hasNonBridge(alternatives, method.getParameterTypes())) {
+                    continue;
+                }
+                result.add(method);
+            }
+            return result;
+        }
+
+        private static boolean hasNonBridge(List<Method> alternatives, Class[] parameterTypes) {
+            for (Method method: alternatives) {
+                if (!method.isBridge() && Arrays.equals(method.getParameterTypes(), parameterTypes)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+    }
+
+    /**
+     * A store for the method index of each class that has been
+     * interrogated. Lookups don't lock; if two threads build the index
+     * for a class at the same time, both use whichever index is
+     * published first.
+     */
+    private interface MethodIndexCache {
+        MethodIndex get(Class cls);
+    }
+
+    /**
+     * Stores each index with its class, using a ClassValue. The index
+     * holds the methods of its class (and so, the class itself), but that
+     * doesn't prevent the class from being unloaded.
+     */
+    private static class ClassValueCache implements MethodIndexCache {
+        private final ClassValue<MethodIndex> indexes = new ClassValue<MethodIndex>() {
+            @Override
+            protected MethodIndex computeValue(Class<?> cls) {
+                return new MethodIndex(cls);
+            }
+        };
+
+        public MethodIndex get(Class cls) {
+            return indexes.get(cls);
+        }
+    }
+
+    /**
+     * Stores the indexes in a map, for platforms that don't provide
+     * ClassValue (e.g., Android before API level 34). Classes that have
+     * been interrogated can't be unloaded.
+     */
+    private static class ConcurrentMapCache implements MethodIndexCache {
+        private final ConcurrentMap<Class, MethodIndex> indexes = new ConcurrentHashMap<Class, MethodIndex>();
+
+        public MethodIndex get(Class cls) {
+            MethodIndex index = indexes.get(cls);
+            if (index == null) {
+                index = new MethodIndex(cls);
+                MethodIndex existing = indexes.putIfAbsent(cls, index);
+                if (existing != null) {
+                    index = existing;
+                }
+            }
+            return index;
+        }
+    }
+
+    /**
+     * The method index for each class that has been interrogated.
+     */
+    private static MethodIndexCache _methodIndex;
+
+    private static final Method[] NO_METHODS = new Method[0];
+    private static final String[] NO_SIGNATURES = new String[0];
+
+    /**
+     * A phantom reference to a Java object that is keeping a Python object alive.
+     */
+    private static class TrackedReference extends PhantomReference<Object> {
+        final long handle;
+
+        TrackedReference(Object obj, long handle, ReferenceQueue<Object> queue) {
+            super(obj, queue);
+            this.handle = handle;
+        }
+    }
+
+    /**
+     * The references that are currently being tracked. The references must
+     * be strongly held until they have been enqueued.
      */
-    private static Map<Class, Map<String, Set<Method>>> _instanceMethods;
+    private static Set<TrackedReference> _tracked;
 
     /**
-     * A 2 level map of Class: Method name: Method for static methods
+     * The queue to which tracked references are delivered once the Java
+     * object has been collected.
      */
-    private static Map<Class, Map<String, Set<Method>>> _staticMethods;
+    private static ReferenceQueue<Object> _collected;
+
+    /**
+     * The thread that releases Python objects once their Java objects
+     * have been collected. Started on first use.
+     */
+    private static Thread _reaper;
 
     static {
         System.loadLibrary("rubicon");
 
-        _instanceMethods = new HashMap<Class, Map<String, Set<Method>>>();
-        _staticMethods = new HashMap<Class, Map<String, Set<Method>>>();
+        MethodIndexCache methodIndex;
+        try {
+            Class.forName("java.lang.ClassValue");
+            methodIndex = new ClassValueCache();
+        } catch (ClassNotFoundException e) {
+            methodIndex = new ConcurrentMapCache();
+        }
+        _methodIndex = methodIndex;
+
+        _tracked = Collections.synchronizedSet(new HashSet<TrackedReference>());
+        _collected = new ReferenceQueue<Object>();
     }
 
     /**
@@ -40,7 +215,10 @@ public class Python {
      *                   Python integration library. If null, it is assumed that
      *                   the system LD_LIBRARY_PATH (or equivalent) will contain
      *                   the Rubicon library
-     * @return The proxy object.
+     * @return 0 on success; non-zero on failure. Only one Python runtime
+     *         can run in a process; starting a second one fails. If the
+     *         runtime fails to start, it is finalized; stop() doesn't need
+     *         to be called.
      */
     public static native int start(String pythonHome, String pythonPath, String rubiconLib);
 
@@ -57,92 +235,385 @@ public class Python {
      */
     public static native void stop();
 
+    /**
+     * Keep a Python object alive for as long as a Java object is reachable.
+     *
+     * Once the Java object has been collected, the Python object is
+     * released on a background thread.
+     *
+     * @param obj The Java object whose lifetime should be tracked
+     * @param handle The handle of the Python object to release when obj is collected.
+     */
+    public static void track(Object obj, long handle) {
+        synchronized (Python.class) {
+            if (_reaper == null) {
+                _reaper = new Thread("Rubicon reaper") {
+                    public void run() {
+                        while (true) {
+                            try {
+                                TrackedReference ref = (TrackedReference) _collected.remove();
+                                _tracked.remove(ref);
+                                release(ref.handle);
+                            } catch (InterruptedException e) {
+                                return;
+                            }
+                        }
+                    }
+                };
+                _reaper.setDaemon(true);
+                _reaper.start();
+            }
+        }
+        _tracked.add(new TrackedReference(obj, handle, _collected));
+    }
+
+    /**
+     * Release a Python object that was being tracked.
+     *
+     * @param handle The handle of the Python object to release.
+     */
+    public static native void release(long handle);
+
     /**
      * Create a proxy implementation that directs towards a Python instance.
      *
+     * The proxy owns a reference to the Python instance, which is released
+     * once the proxy has been collected. The caller must have acquired that
+     * reference on behalf of the proxy.
+     *
      * @param cls The interface/class that is to be proxied
-     * @param instance The unique Python ID of the instance to be proxied.
+     * @param instance The handle of the Python instance to be proxied.
      * @return The proxy object.
      */
     public static Object proxy(Class cls, long instance) {
+        return proxy(cls, instance, false);
+    }
+
+    /**
+     * Create a proxy implementation that directs towards a Python instance.
+     *
+     * @param cls The interface/class that is to be proxied
+     * @param instance The handle of the Python instance to be proxied.
+     * @param async If true, methods that don't need to return a value to
+     *              the caller are invoked on the callback dispatcher thread.
+     * @return The proxy object.
+     */
+    public static Object proxy(Class cls, long instance, boolean async) {
+        return proxy(cls, instance, async, 0, 0);
+    }
+
+    /**
+     * Create a proxy implementation that directs towards a Python instance.
+     *
+     * @param cls The interface/class that is to be proxied
+     * @param instance The handle of the Python instance to be proxied.
+     * @param async If true, methods that don't need to return a value to
+     *              the caller are invoked on the callback dispatcher thread.
+     * @param batchSize If non-zero, invocations of void methods are
+     *                  delivered to Python in batches of up to this size.
+     * @param batchLatency The maximum time (in nanoseconds) an invocation
+     *                     can be buffered before it is delivered.
+     * @return The proxy object.
+     */
+    public static Object proxy(Class cls, long instance, boolean async, int batchSize, long batchLatency) {
         Object pinstance = Proxy.newProxyInstance(cls.getClassLoader(),
                                new Class<?>[] {cls},
-                               new PythonInstance(instance));
+                               new PythonInstance(instance, async, batchSize, batchLatency));
+        track(pinstance, instance);
         return pinstance;
     }
 
     /**
-     * Retrieve the list of methods on a class with a specific name.
+     * Describe the public API of a class.
      *
-     * This is used to implement on-demand polymorphism checks.
+     * This allows everything the Python side needs to know about a class
+     * to be retrieved with a single call. The description is a series of
+     * lines, each describing one feature of the class:
      *
-     * @param cls The class to be interrogated
-     * @param name The name of the method to retrieve
-     * @param isStatic If True, return only static methods; otherwise, return
-     *        instance methods.
-     * @return The array of Method instances matching the provided name.
+     *   A descriptor          A type that can be used to represent an
+     *                         instance of the class (the class itself, its
+     *                         interfaces, then its superclasses)
+     *   C signature           A public constructor
+     *   M name signature      A public instance method
+     *   S name signature      A public static method
+     *   F name descriptor     A public instance field
+     *   G name descriptor     A public static field
+     *
+     * Descriptors and signatures are in JNI format.
+     *
+     * @param cls The class to be described
+     * @return The description of the class.
      */
-    public static Method [] getMethods(Class cls, String name, boolean isStatic)
+    public static String describe(Class cls)
     {
-        Map<String, Set<Method>> methodMap;
+        StringBuilder description = new StringBuilder();
 
-        if (isStatic)
+        description.append("A ").append(descriptor(cls)).append('\n');
+        for (Class iface: cls.getInterfaces())
         {
-            methodMap = _staticMethods.get(cls);
+            description.append("A ").append(descriptor(iface)).append('\n');
         }
-        else
+        for (Class superclass = cls.getSuperclass(); superclass != null; superclass = superclass.getSuperclass())
         {
-            methodMap = _instanceMethods.get(cls);
+            description.append("A ").append(descriptor(superclass)).append('\n');
         }
 
-        if (methodMap == null) {
-            Map<String, Set<Method>> instanceNameMap = new HashMap<String, Set<Method>>();
-            Map<String, Set<Method>> staticNameMap = new HashMap<String, Set<Method>>();
+        for (Constructor constructor: cls.getConstructors())
+        {
+            description.append("C ").append(signature(constructor.getParameterTypes(), Void.TYPE)).append('\n');
+        }
+
+        MethodIndex index = methodIndex(cls);
+        describeMethods(description, "M ", index.instanceSignatures);
+        describeMethods(description, "S ", index.staticSignatures);
 
-            for (Method method: cls.getMethods())
+        Set<String> fieldNames = new HashSet<String>();
+        for (Field field: cls.getFields())
+        {
+            // If a field is hidden by a subclass, only describe the field
+            // that getField() would resolve.
+            if (fieldNames.add(field.getName()))
             {
-                int modifiers = method.getModifiers();
-                if (Modifier.isPublic(modifiers))
+                try
                 {
-                    if (Modifier.isStatic(modifiers))
-                    {
-                        Set<Method> alternatives = staticNameMap.get(method.getName());
-                        if (alternatives == null)
-                        {
-                            alternatives = new HashSet<Method>();
-                            staticNameMap.put(method.getName(), alternatives);
-                        }
+                    field = cls.getField(field.getName());
+                }
+                catch (NoSuchFieldException e)
+                {
+                    continue;
+                }
+                description.append(Modifier.isStatic(field.getModifiers()) ? "G " : "F ")
+                    .append(field.getName())
+                    .append(' ')
+                    .append(descriptor(field.getType()))
+                    .append('\n');
+            }
+        }
 
-                        alternatives.add(method);
-                    }
-                    else
-                    {
-                        Set<Method> alternatives = instanceNameMap.get(method.getName());
-                        if (alternatives == null)
-                        {
-                            alternatives = new HashSet<Method>();
-                            instanceNameMap.put(method.getName(), alternatives);
-                        }
+        return description.toString();
+    }
 
-                        alternatives.add(method);
-                    }
-                }
+    /**
+     * Append a line to a class description for each method signature.
+     *
+     * @param description The description being constructed
+     * @param prefix The prefix identifying the kind of method
+     * @param signatures The map of method name: signatures to describe
+     */
+    private static void describeMethods(StringBuilder description, String prefix, Map<String, String[]> signatures)
+    {
+        for (Map.Entry<String, String[]> entry: signatures.entrySet())
+        {
+            for (String signature: entry.getValue())
+            {
+                description.append(prefix)
+                    .append(entry.getKey())
+                    .append(' ')
+                    .append(signature)
+                    .append('\n');
             }
+        }
+    }
 
-            _instanceMethods.put(cls, instanceNameMap);
-            _staticMethods.put(cls, staticNameMap);
+    /**
+     * Determine an identifier for the version of a class.
+     *
+     * The identifier changes whenever the file that the class was loaded
+     * from (a class file or a jar) changes. This is used to validate
+     * class descriptions that have been cached between runs.
+     *
+     * @param cls The class to be identified
+     * @return An identifier for the current version of the class, or
+     *         UNCACHEABLE if the version of the class can't be identified
+     *         in a way that is stable between runs.
+     */
+    public static String version(Class cls)
+    {
+        String version = System.getProperty("java.vm.name") + " " + System.getProperty("java.version");
+        ClassLoader loader = cls.getClassLoader();
+        if (loader == null)
+        {
+            // A system class; it can only change if the VM changes.
+            return version;
+        }
 
-            if (isStatic)
+        File file = null;
+        URL resource = loader.getResource(cls.getName().replace('.', '/') + ".class");
+        if (resource != null)
+        {
+            try
             {
-                methodMap = staticNameMap;
+                if ("file".equals(resource.getProtocol()))
+                {
+                    file = new File(resource.toURI());
+                }
+                else if ("jar".equals(resource.getProtocol()))
+                {
+                    String path = resource.getPath();
+                    file = new File(new URI(path.substring(0, path.indexOf("!/"))));
+                }
+                else if ("jrt".equals(resource.getProtocol()))
+                {
+                    // Part of the runtime image; it can only change if the
+                    // VM changes.
+                    return version;
+                }
             }
-            else
+            catch (Exception e)
             {
-                methodMap = instanceNameMap;
+                file = null;
             }
         }
 
-        return methodMap.get(name).toArray(new Method[0]);
+        if (file != null && file.exists())
+        {
+            version = file.getPath() + " " + file.length() + " " + file.lastModified();
+        }
+        else if (describesItself(loader))
+        {
+            // The best we can do is identify the class loader. On Android,
+            // this includes the path of the APK.
+            version = version + " " + loader.getClass().getName() + " " + loader;
+        }
+        else
+        {
+            // The default description of a loader includes its identity
+            // hash code, which is different in every run.
+            return UNCACHEABLE;
+        }
+        return version.replace('\t', ' ').replace('\n', ' ');
+    }
+
+    /**
+     * The version of a class that can't be identified between runs.
+     */
+    public static final String UNCACHEABLE = "uncacheable";
+
+    /**
+     * Determine whether a class loader provides its own description, rather
+     * than the default description of an object.
+     */
+    private static boolean describesItself(ClassLoader loader)
+    {
+        try
+        {
+            return loader.getClass().getMethod("toString").getDeclaringClass() != Object.class;
+        }
+        catch (Exception e)
+        {
+            return false;
+        }
+    }
+
+    /**
+     * Determine the JNI type descriptor for a class.
+     *
+     * @param cls The class to be described
+     * @return The JNI descriptor for the class (e.g., "I", "[I", or
+     *         "Ljava/lang/String;").
+     */
+    private static String descriptor(Class cls)
+    {
+        if (cls.isPrimitive())
+        {
+            if (cls == Boolean.TYPE) return "Z";
+            if (cls == Byte.TYPE) return "B";
+            if (cls == Character.TYPE) return "C";
+            if (cls == Short.TYPE) return "S";
+            if (cls == Integer.TYPE) return "I";
+            if (cls == Long.TYPE) return "J";
+            if (cls == Float.TYPE) return "F";
+            if (cls == Double.TYPE) return "D";
+            return "V";
+        }
+        else if (cls.isArray())
+        {
+            return cls.getName().replace('.', '/');
+        }
+        return "L" + cls.getName().replace('.', '/') + ";";
+    }
+
+    /**
+     * Determine the JNI method signature for a list of parameters and a
+     * return type.
+     *
+     * @param params The types of the parameters
+     * @param returnType The return type
+     * @return The JNI signature (e.g., "(ILjava/lang/String;)V").
+     */
+    private static String signature(Class [] params, Class returnType)
+    {
+        StringBuilder signature = new StringBuilder("(");
+        for (Class param: params)
+        {
+            signature.append(descriptor(param));
+        }
+        return signature.append(')').append(descriptor(returnType)).toString();
+    }
+
+    /**
+     * Retrieve the list of methods on a class with a specific name.
+     *
+     * This is used to implement on-demand polymorphism checks.
+     *
+     * @param cls The class to be interrogated
+     * @param name The name of the method to retrieve
+     * @param isStatic If True, return only static methods; otherwise, return
+     *        instance methods.
+     * @return The array of Method instances matching the provided name;
+     *         an empty array if no method with the provided name exists.
+     *         The array is shared, and must not be modified.
+     */
+    public static Method [] getMethods(Class cls, String name, boolean isStatic)
+    {
+        MethodIndex index = methodIndex(cls);
+        Method [] methods = (isStatic ? index.staticMethods : index.instanceMethods).get(name);
+        return methods != null ? methods : NO_METHODS;
+    }
+
+    /**
+     * Retrieve the JNI signatures of the methods on a class with a specific name.
+     *
+     * The signatures are in the same order as the methods returned by
+     * getMethods().
+     *
+     * @param cls The class to be interrogated
+     * @param name The name of the methods to retrieve
+     * @param isStatic If True, return only static methods; otherwise, return
+     *        instance methods.
+     * @return The array of JNI signatures for the methods matching the
+     *         provided name. The array is shared, and must not be modified.
+     */
+    public static String [] getSignatures(Class cls, String name, boolean isStatic)
+    {
+        MethodIndex index = methodIndex(cls);
+        String [] signatures = (isStatic ? index.staticSignatures : index.instanceSignatures).get(name);
+        return signatures != null ? signatures : NO_SIGNATURES;
+    }
+
+    /**
+     * Determine the JNI signature of a method.
+     *
+     * This is used to identify interface methods that are invoked on
+     * Python objects.
+     *
+     * @param method The method to be described
+     * @return The JNI signature of the method (e.g., "(ILjava/lang/String;)V").
+     */
+    public static String getSignature(Method method)
+    {
+        return signature(method.getParameterTypes(), method.getReturnType());
+    }
+
+    /**
+     * Retrieve the method index for a class, building it if required.
+     *
+     * @param cls The class to be interrogated
+     * @return The method index for the class.
+     */
+    private static MethodIndex methodIndex(Class cls)
+    {
+        return _methodIndex.get(cls);
     }
 
     /**
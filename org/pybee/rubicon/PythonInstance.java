@@ -3,20 +3,271 @@ package org.pybee.rubicon;
 import java.lang.reflect.InvocationHandler;
 import java.lang.reflect.Method;
 
+import java.util.ArrayList;
+import java.util.List;
+import java.util.concurrent.CancellationException;
+import java.util.concurrent.CompletableFuture;
+import java.util.concurrent.ConcurrentHashMap;
+import java.util.concurrent.ConcurrentLinkedQueue;
+import java.util.concurrent.ConcurrentMap;
+import java.util.concurrent.Executors;
+import java.util.concurrent.ScheduledExecutorService;
+import java.util.concurrent.ThreadFactory;
+import java.util.concurrent.TimeUnit;
+import java.util.concurrent.locks.LockSupport;
+
 
 public class PythonInstance implements InvocationHandler {
     /**
-     * The Python instance ID.
+     * The handle of the Python instance.
      */
     public long instance;
 
+    /**
+     * If true, invocations are queued, and run on the callback dispatcher
+     * thread, rather than on the thread that invoked the method.
+     */
+    public boolean async;
+
+    /**
+     * The maximum number of invocations of a void method that are buffered
+     * before they are delivered to Python as a batch; 0 if invocations
+     * aren't batched.
+     */
+    public int batchSize;
+
+    /**
+     * The maximum time (in nanoseconds) that an invocation can be buffered
+     * before its batch is delivered.
+     */
+    public long batchLatency;
+
+    /**
+     * The buffered invocations of each void method, if invocations are batched.
+     */
+    private ConcurrentMap<Method, Batch> _batches;
+
+    /**
+     * An invocation that is waiting to be run by the callback dispatcher.
+     */
+    private static class Invocation {
+        final PythonInstance handler;
+        final Object proxy;
+        final Method method;
+        final Object[] args;
+        final Object[][] batch;
+        final CompletableFuture<Object> future;
+
+        Invocation(PythonInstance handler, Object proxy, Method method, Object[] args, CompletableFuture<Object> future) {
+            this.handler = handler;
+            this.proxy = proxy;
+            this.method = method;
+            this.args = args;
+            this.batch = null;
+            this.future = future;
+        }
+
+        Invocation(PythonInstance handler, Object proxy, Method method, Object[][] batch) {
+            this.handler = handler;
+            this.proxy = proxy;
+            this.method = method;
+            this.args = null;
+            this.batch = batch;
+            this.future = null;
+        }
+
+        void run() {
+            try {
+                if (batch != null) {
+                    handler.invokePythonBatch(proxy, method, batch);
+                } else {
+                    Object result = handler.invokePython(proxy, method, args);
+                    if (future != null) {
+                        future.complete(result);
+                    }
+                }
+            } catch (Throwable t) {
+                if (future != null) {
+                    future.completeExceptionally(t);
+                } else {
+                    reportFailure(t);
+                }
+            }
+        }
+
+        void cancel() {
+            if (future != null) {
+                future.completeExceptionally(new CancellationException("Python runtime stopped"));
+            }
+        }
+    }
+
+    /**
+     * The buffered invocations of a void method.
+     */
+    private static class Batch {
+        final PythonInstance handler;
+        final Method method;
+        private final Object flushLock = new Object();
+        private List<Object[]> pending = new ArrayList<Object[]>();
+        // The proxy the pending invocations were made on. It is kept alive
+        // until they are delivered, so that the Python object isn't
+        // released while calls to it are buffered.
+        private Object proxy;
+        private boolean scheduled;
+
+        Batch(PythonInstance handler, Method method) {
+            this.handler = handler;
+            this.method = method;
+        }
+
+        /**
+         * Buffer an invocation. The batch is delivered immediately if it is
+         * full; otherwise, delivery is scheduled for when the latency bound
+         * expires.
+         */
+        void add(Object proxy, Object[] args) {
+            boolean full;
+            boolean schedule = false;
+            synchronized (this) {
+                this.proxy = proxy;
+                pending.add(args != null ? args : NO_ARGS);
+                full = pending.size() >= handler.batchSize;
+                if (!full && !scheduled) {
+                    scheduled = true;
+                    schedule = true;
+                }
+            }
+            if (full) {
+                flush();
+            } else if (schedule) {
+                flusher().schedule(new Runnable() {
+                    public void run() {
+                        // There's no caller to rethrow a failure to.
+                        try {
+                            flush();
+                        } catch (Throwable t) {
+                            reportFailure(t);
+                        }
+                    }
+                }, handler.batchLatency, TimeUnit.NANOSECONDS);
+            }
+        }
+
+        /**
+         * Deliver the buffered invocations. Batches are delivered one at a
+         * time, in order. Unless the handler is asynchronous, the batch is
+         * delivered on the calling thread, and any exception raised by the
+         * Python method is thrown to the caller.
+         */
+        void flush() {
+            synchronized (flushLock) {
+                List<Object[]> batch;
+                Object target;
+                synchronized (this) {
+                    batch = pending;
+                    target = proxy;
+                    pending = new ArrayList<Object[]>();
+                    proxy = null;
+                    scheduled = false;
+                }
+                if (!batch.isEmpty()) {
+                    Object[][] invocations = batch.toArray(new Object[batch.size()][]);
+                    if (handler.async) {
+                        enqueue(new Invocation(handler, target, method, invocations));
+                    } else {
+                        handler.invokePythonBatch(target, method, invocations);
+                    }
+                }
+            }
+        }
+    }
+
+    private static final Object[] NO_ARGS = new Object[0];
+
+    /**
+     * The thread that delivers batches once their latency bound expires.
+     * Started on first use.
+     */
+    private static ScheduledExecutorService _flusher;
+
+    private static synchronized ScheduledExecutorService flusher() {
+        if (_flusher == null) {
+            _flusher = Executors.newSingleThreadScheduledExecutor(new ThreadFactory() {
+                public Thread newThread(Runnable runnable) {
+                    Thread thread = new Thread(runnable, "Rubicon batch flusher");
+                    thread.setDaemon(true);
+                    return thread;
+                }
+            });
+        }
+        return _flusher;
+    }
+
+    /**
+     * The invocations waiting for the callback dispatcher. Any number of
+     * threads can add invocations without locking; only the dispatcher
+     * removes them.
+     */
+    private static final ConcurrentLinkedQueue<Invocation> _pending = new ConcurrentLinkedQueue<Invocation>();
+
+    /**
+     * The handler for exceptions raised by invocations that have no caller
+     * to receive them (e.g., queued invocations of void methods). If null,
+     * the stack trace is printed.
+     */
+    private static volatile Thread.UncaughtExceptionHandler _failureHandler;
+
+    /**
+     * The thread running the callback dispatcher, if it has been started.
+     */
+    private static volatile Thread _dispatcher;
+
+    /**
+     * Set to request that the callback dispatcher stops.
+     */
+    private static volatile boolean _stopping;
+
     /**
      * A representation of a Python object on the Java side.
      *
-     * @param inst The Python instance ID of the object.
+     * @param inst The handle of the Python object.
      */
     public PythonInstance(long inst) {
+        this(inst, false);
+    }
+
+    /**
+     * A representation of a Python object on the Java side.
+     *
+     * @param inst The handle of the Python object.
+     * @param async If true, invocations that don't need to return a value
+     *              to the caller are run on the callback dispatcher thread.
+     */
+    public PythonInstance(long inst, boolean async) {
+        this(inst, async, 0, 0);
+    }
+
+    /**
+     * A representation of a Python object on the Java side.
+     *
+     * @param inst The handle of the Python object.
+     * @param async If true, invocations that don't need to return a value
+     *              to the caller are run on the callback dispatcher thread.
+     * @param batchSize If non-zero, invocations of void methods are
+     *                  buffered, and delivered to Python in batches of up
+     *                  to this size.
+     * @param batchLatency The maximum time (in nanoseconds) an invocation
+     *                     can be buffered before it is delivered.
+     */
+    public PythonInstance(long inst, boolean async, int batchSize, long batchLatency) {
         instance = inst;
+        this.async = async;
+        this.batchSize = batchSize;
+        this.batchLatency = batchLatency;
+        if (batchSize > 0) {
+            _batches = new ConcurrentHashMap<Method, Batch>();
+        }
     }
 
     /**
@@ -25,10 +276,155 @@ public class PythonInstance implements InvocationHandler {
      * When used as a proxy, this enables Python C API calls to be used to
      * satisfy a
      *
+     * If the instance is batched, invocations of void methods are buffered,
+     * and delivered together. If the instance is asynchronous, void methods
+     * (or batches) are queued, and return immediately. Methods that return
+     * a CompletableFuture (or a Future or CompletionStage) are also queued;
+     * they return a future that is completed with the value returned by
+     * the Python method. All other methods are invoked synchronously.
+     *
+     * @param inst The Java proxy of the Python object.
+     * @param method The Java method to invoke.
+     * @param args The array of arguments to be passed to the method.
+     * @return The return value from the Python method.
+     */
+    public Object invoke(Object proxy, Method method, Object[] args) throws Throwable {
+        if (_batches != null && method.getReturnType() == Void.TYPE && method.getDeclaringClass() != Object.class) {
+            Batch batch = _batches.get(method);
+            if (batch == null) {
+                batch = new Batch(this, method);
+                Batch existing = _batches.putIfAbsent(method, batch);
+                if (existing != null) {
+                    batch = existing;
+                }
+            }
+            batch.add(proxy, args);
+            return null;
+        }
+        if (async) {
+            Class<?> returnType = method.getReturnType();
+            if (returnType == Void.TYPE) {
+                enqueue(new Invocation(this, proxy, method, args, null));
+                return null;
+            } else if (returnType != Object.class && returnType.isAssignableFrom(CompletableFuture.class)) {
+                CompletableFuture<Object> future = new CompletableFuture<Object>();
+                enqueue(new Invocation(this, proxy, method, args, future));
+                return future;
+            }
+        }
+        return invokePython(proxy, method, args);
+    }
+
+    /**
+     * Invoke a method on the Python object, on the current thread.
+     *
      * @param inst The Java proxy of the Python object.
      * @param method The Java method to invoke.
      * @param args The array of arguments to be passed to the method.
      * @return The return value from the Python method.
      */
-    public native Object invoke(Object proxy, Method method, Object[] args) throws Throwable;
+    native Object invokePython(Object proxy, Method method, Object[] args) throws Throwable;
+
+    /**
+     * Deliver a batch of invocations of a void method to the Python object,
+     * on the current thread.
+     *
+     * @param proxy The Java proxy of the Python object. It is passed so that
+     *              it stays reachable until the batch has been delivered.
+     * @param method The Java method that was invoked.
+     * @param batch The arguments of each invocation, in order.
+     * @throws RuntimeException If the Python method raised an exception.
+     */
+    native void invokePythonBatch(Object proxy, Method method, Object[][] batch);
+
+    /**
+     * Deliver any buffered invocations to the Python object.
+     *
+     * @throws RuntimeException If the Python method raised an exception
+     *         while a batch was delivered on the calling thread.
+     */
+    public void flush() {
+        if (_batches != null) {
+            for (Batch batch: _batches.values()) {
+                batch.flush();
+            }
+        }
+    }
+
+    /**
+     * Set the handler for exceptions raised by invocations that have no
+     * caller to receive them.
+     *
+     * @param handler The handler, or null to print the stack trace.
+     */
+    public static void setFailureHandler(Thread.UncaughtExceptionHandler handler) {
+        _failureHandler = handler;
+    }
+
+    /**
+     * Report an exception raised by an invocation that has no caller to
+     * receive it.
+     */
+    static void reportFailure(Throwable t) {
+        Thread.UncaughtExceptionHandler handler = _failureHandler;
+        if (handler != null) {
+            handler.uncaughtException(Thread.currentThread(), t);
+        } else {
+            t.printStackTrace();
+        }
+    }
+
+    private static void enqueue(Invocation invocation) {
+        _pending.offer(invocation);
+        Thread dispatcher = _dispatcher;
+        if (dispatcher != null) {
+            LockSupport.unpark(dispatcher);
+        }
+    }
+
+    /**
+     * Prepare to start the callback dispatcher.
+     *
+     * This must be called before the dispatcher thread is started, so that
+     * a dispatcher can be run again after a previous one was stopped.
+     */
+    public static void resetDispatcher() {
+        _stopping = false;
+    }
+
+    /**
+     * Run queued invocations until stopDispatcher() is called.
+     *
+     * This is invoked by a thread owned by Python. Invocations are run in
+     * the order they were queued.
+     */
+    public static void dispatchCallbacks() {
+        _dispatcher = Thread.currentThread();
+        while (!_stopping) {
+            Invocation invocation = _pending.poll();
+            if (invocation != null) {
+                invocation.run();
+            } else {
+                LockSupport.park(PythonInstance.class);
+            }
+        }
+        _dispatcher = null;
+
+        Invocation invocation;
+        while ((invocation = _pending.poll()) != null) {
+            invocation.cancel();
+        }
+    }
+
+    /**
+     * Ask the callback dispatcher to stop. Invocations that haven't been
+     * run are discarded.
+     */
+    public static void stopDispatcher() {
+        _stopping = true;
+        Thread dispatcher = _dispatcher;
+        if (dispatcher != null) {
+            LockSupport.unpark(dispatcher);
+        }
+    }
 }
@@ -1,8 +1,10 @@
 package org.pybee.rubicon.test;
 
 import java.lang.Math;
+import java.nio.ByteBuffer;
 
 import org.pybee.rubicon.Python;
+import org.pybee.rubicon.PythonInstance;
 
 
 public class Example extends BaseExample {
@@ -26,6 +28,8 @@ public class Example extends BaseExample {
     /* Public member fields and method */
     public int int_field;
     private ICallback callback;
+    private ICalculator calculator;
+    private IAsyncCallback asyncCallback;
     public Thing theThing;
 
     /* Polymorphic constructors */
@@ -117,6 +121,62 @@ public class Example extends BaseExample {
         return in + in + in;
     }
 
+    public static void spin(int millis) {
+        long end = System.nanoTime() + millis * 1000000L;
+        while (System.nanoTime() < end) {
+        }
+    }
+
+    /* Array argument/return value handling */
+    public int sum(int[] values) {
+        int total = 0;
+        for (int value: values) {
+            total += value;
+        }
+        return total;
+    }
+
+    public double[] scaled(double[] values, double factor) {
+        double[] result = new double[values.length];
+        for (int i = 0; i < values.length; i++) {
+            result[i] = values[i] * factor;
+        }
+        return result;
+    }
+
+    public static void increment(int[] values) {
+        for (int i = 0; i < values.length; i++) {
+            values[i] += 1;
+        }
+    }
+
+    /* Direct buffer handling */
+    public static ByteBuffer allocate_buffer(int size) {
+        ByteBuffer buffer = ByteBuffer.allocateDirect(size);
+        for (int i = 0; i < size; i++) {
+            buffer.put(i, (byte) i);
+        }
+        return buffer;
+    }
+
+    public static int sum_buffer(ByteBuffer buffer) {
+        int total = 0;
+        for (int i = 0; i < buffer.capacity(); i++) {
+            total += buffer.get(i);
+        }
+        return total;
+    }
+
+    public static void fill_buffer(ByteBuffer buffer, int value) {
+        for (int i = 0; i < buffer.capacity(); i++) {
+            buffer.put(i, (byte) value);
+        }
+    }
+
+    public static void collect() {
+        System.gc();
+    }
+
     /* Interface visiblity */
     protected void invisible_method(int value) {}
     protected static void static_invisible_method(int value) {}
@@ -136,6 +196,86 @@ public class Example extends BaseExample {
         callback.peek(this, value);
     }
 
+    /* Callbacks with return values */
+    public void set_calculator(ICalculator calc) {
+        calculator = calc;
+    }
+
+    public int test_add(int a, int b) {
+        return calculator.add(a, b);
+    }
+
+    public double test_scale(double value, float factor) {
+        return calculator.scale(value, factor);
+    }
+
+    public boolean test_is_even(long value) {
+        return calculator.is_even(value);
+    }
+
+    public String test_describe(String label, int count) {
+        return calculator.describe(label, count);
+    }
+
+    public Thing test_choose(Thing first, Thing second) {
+        return calculator.choose(first, second);
+    }
+
+    public Long test_length(String value) {
+        return calculator.length(value);
+    }
+
+    /* Asynchronous callbacks */
+    public void set_async_callback(IAsyncCallback cb) {
+        asyncCallback = cb;
+    }
+
+    public void test_record(int value) {
+        asyncCallback.record(value);
+    }
+
+    public int test_square(int value) throws Exception {
+        return asyncCallback.square(value).get();
+    }
+
+    public void test_record_many(int count) {
+        for (int i = 0; i < count; i++) {
+            asyncCallback.record(i);
+        }
+    }
+
+    public static void reset_failure_handler() {
+        PythonInstance.setFailureHandler(null);
+    }
+
+    /* Native methods implemented in Python */
+    public static native int native_add(int a, int b);
+
+    public native String native_describe(String label, char separator);
+
+    public static native String native_flag(boolean flag);
+
+    public int test_native_add(int a, int b) {
+        return native_add(a, b);
+    }
+
+    public String test_native_describe(String label, char separator) {
+        return native_describe(label, separator);
+    }
+
+    public String test_native_flag(boolean flag) {
+        return native_flag(flag);
+    }
+
+    /* Exceptions */
+    public static int fail_static(String message) {
+        throw new IllegalStateException(message);
+    }
+
+    public int fail(String message) {
+        throw new IllegalStateException(message);
+    }
+
     /* General utility - converting objects to string */
     public String toString() {
         return "This is a Java Example object";
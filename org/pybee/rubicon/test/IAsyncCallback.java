@@ -0,0 +1,10 @@
+package org.pybee.rubicon.test;
+
+import java.util.concurrent.Future;
+
+
+public interface IAsyncCallback {
+    public void record(int value);
+
+    public Future<Integer> square(int value);
+}
@@ -0,0 +1,16 @@
+package org.pybee.rubicon.test;
+
+
+public interface ICalculator {
+    public int add(int a, int b);
+
+    public double scale(double value, float factor);
+
+    public boolean is_even(long value);
+
+    public String describe(String label, int count);
+
+    public Thing choose(Thing first, Thing second);
+
+    public Long length(String value);
+}
@@ -2,55 +2,325 @@ from __future__ import print_function, absolute_import, division, unicode_litera
 
 __version__ = '0.1.0'
 
-import itertools
-
+import array
+import functools
+import os
+import sys
+import threading
+import uuid
+import weakref
+from types import FunctionType
+
+from . import classfile
 from .jni import *
+from .metadata import MetadataCache
 from .types import *
 
+# The native fast path for method invocation and field access. This module
+# is built into the Rubicon native library; if it isn't available (e.g.,
+# when running against an older library), the ctypes bindings are used.
+try:
+    import _rubicon
+except ImportError:
+    _rubicon = None
+
 # A cache of known JavaClass instances. This is requried so that when
 # we do a return_cast() to a return type, we don't have to recreate
 # the class every time - we can re-use the existing class.
 _class_cache = {}
 
-# A cache of known JavaInterface proxies. This is used by the dispatch
-# mechanism to direct callbacks to the right place.
-_proxy_cache = {}
+# Per-thread state; this holds the buffer used to marshal arguments.
+_thread_state = threading.local()
+
+# The ctypes element type, JNI array type, and JNI functions for creating,
+# reading and writing each type of Java primitive array.
+_PRIMITIVE_ARRAYS = {
+    'Z': (jboolean, jbooleanArray, java.NewBooleanArray, java.GetBooleanArrayRegion, java.SetBooleanArrayRegion),
+    'B': (jbyte, jbyteArray, java.NewByteArray, java.GetByteArrayRegion, java.SetByteArrayRegion),
+    'C': (jchar, jcharArray, java.NewCharArray, java.GetCharArrayRegion, java.SetCharArrayRegion),
+    'S': (jshort, jshortArray, java.NewShortArray, java.GetShortArrayRegion, java.SetShortArrayRegion),
+    'I': (jint, jintArray, java.NewIntArray, java.GetIntArrayRegion, java.SetIntArrayRegion),
+    'J': (jlong, jlongArray, java.NewLongArray, java.GetLongArrayRegion, java.SetLongArrayRegion),
+    'F': (jfloat, jfloatArray, java.NewFloatArray, java.GetFloatArrayRegion, java.SetFloatArrayRegion),
+    'D': (jdouble, jdoubleArray, java.NewDoubleArray, java.GetDoubleArrayRegion, java.SetDoubleArrayRegion),
+}
+
+# The dispatch slot of each Java interface method that can be invoked on a
+# Python object, keyed by (method name, parameter signature); and the
+# (method name, argument signatures) of the method in each slot.
+_callback_slots = {}
+_callback_methods = []
+_callback_lock = threading.Lock()
+
+
+def callback_slot(name, signature):
+    """Determine the dispatch slot for a Java interface method.
+
+    Slots are small integers, allocated in the order that methods are first
+    seen. Methods are numbered when the JavaInterface declaring them is
+    created; the native side of the bridge looks up the slot for any other
+    method the first time it is invoked, and caches it against the method.
+
+    The signature can be a full JNI method signature, or just the signature
+    of the parameters.
+    """
+    if signature.startswith('('):
+        signature = signature[1:signature.index(')')]
+    key = (name, signature)
+    try:
+        return _callback_slots[key]
+    except KeyError:
+        with _callback_lock:
+            if key not in _callback_slots:
+                _callback_methods.append((name, _split_signature(signature)))
+                _callback_slots[key] = len(_callback_methods) - 1
+            return _callback_slots[key]
+
 
-def dispatch(instance, method, args):
+def _callback_handlers(java_class):
+    """Build the dispatch table for a Python implementation of an interface.
+
+    The table is a list, indexed by dispatch slot, of (function, argument
+    signatures). The function is the plain Python function implementing
+    the method on the class; it is None if the method isn't implemented by
+    a plain function, in which case normal attribute lookup is used.
+    """
+    handlers = []
+    for name, signature in _callback_methods:
+        function = None
+        for klass in java_class.__mro__:
+            if name in klass.__dict__:
+                if isinstance(klass.__dict__[name], FunctionType):
+                    function = klass.__dict__[name]
+                break
+        handlers.append((function, signature))
+    return handlers
+
+
+def dispatch(pyinstance, slot, args):
     """The mechanism by which Java can invoke methods in Python.
 
     This method should be invoked with an:
-     * an ID for a Python object
-     * a string representing a method name, and
+     * the Python object whose method is being invoked
+     * the dispatch slot of the method being invoked (see callback_slot()), and
      * a (void *) arrary of arguments. The arguments should be memory
        references to JNI objects.
 
-    The ID is used to look up the instance from the cache of proxy instances
-    that have been instantiated; Python method lookup is then used to invoke
-    the appropriate method, and provide the arguments (after casting to
-    valid Python objects).
+    The native side of the bridge resolves the object from the handle held
+    by its Java proxy. The slot is used to find the method in the dispatch
+    table of the object's class, and the method is invoked with the
+    provided arguments (after casting to valid Python objects).
+
+    The value returned by the Python method is returned; the native side
+    of the bridge converts it into the return type declared by the Java
+    interface method. Any exception raised by the Python method propagates
+    to the caller, and is rethrown in Java as a RuntimeException.
+    """
+    # print ("PYTHON SIDE DISPATCH", pyinstance, slot, args)
+    handlers = pyinstance._handlers
+    if slot < len(handlers):
+        function, signature = handlers[slot]
+    else:
+        # A slot allocated after the class was created.
+        function = None
+        signature = _callback_methods[slot][1]
+
+    if len(signature) != len(args):
+        raise RuntimeError("argc provided for dispatch doesn't match registered method.")
+    args = [dispatch_cast(jarg, jtype) for jarg, jtype in zip(args, signature)]
+    if function is None:
+        return getattr(pyinstance, _callback_methods[slot][0])(*args)
+    return function(pyinstance, *args)
+
+
+def dispatch_batch(pyinstance, slot, batch):
+    """The mechanism by which Java delivers a batch of invocations to Python.
+
+    This is invoked with a Python object, the dispatch slot of a void
+    method, and a list containing the arguments tuple of each buffered
+    invocation of that method (see batched()).
+
+    The method is invoked once, with a list containing a tuple of the
+    (cast) arguments of each invocation, in the order they were made. As
+    with dispatch(), any exception raised propagates to the caller, and
+    is rethrown in Java.
+    """
+    handlers = pyinstance._handlers
+    if slot < len(handlers):
+        function, signature = handlers[slot]
+    else:
+        function = None
+        signature = _callback_methods[slot][1]
+
+    batch = [
+        tuple(dispatch_cast(jarg, jtype) for jarg, jtype in zip(args, signature))
+        for args in batch
+    ]
+    if function is None:
+        getattr(pyinstance, _callback_methods[slot][0])(batch)
+    else:
+        function(pyinstance, batch)
+
+
+###########################################################################
+# Local reference management
+#
+# Every JNI call that returns an object creates a local reference. Local
+# references are only released when the native method that is running
+# returns (or when the thread detaches) - which, for a long running
+# Python script, may be never. Every bridged invocation is performed in
+# its own local frame; objects that escape to Python are promoted to
+# global references.
+###########################################################################
+
+class local_frame(object):
+    """A context manager that releases local references created inside it.
+
+    The bridge manages local references for method invocations and field
+    access; this is only needed when using the raw JNI functions in
+    rubicon.java.jni, e.g., for batched work in a loop::
+
+        with local_frame(64):
+            for i in range(java.GetArrayLength(items)):
+                item = java.GetObjectArrayElement(items, i)
+                ...
+
+    Any local reference created inside the block is invalid once the
+    block exits.
+    """
+    def __init__(self, capacity=16):
+        self.capacity = capacity
+
+    def __enter__(self):
+        if java.PushLocalFrame(self.capacity) < 0:
+            java.ExceptionClear()
+            raise MemoryError("Unable to allocate a local frame of %d references" % self.capacity)
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        java.PopLocalFrame(None)
+
+
+class GlobalRef(jobject):
+    """A JNI global reference that is deleted when it is garbage collected.
 
-    This method has no return value, so it can only be used to represent Java
-    interface methods with no return value.
+    Wrappers hold their reference in a GlobalRef, rather than deleting it
+    in their own __del__, so that they can be part of a reference cycle
+    without becoming uncollectable.
+    """
+    def __del__(self, _delete=java.DeleteGlobalRef):
+        if self.value:
+            _delete(self)
+
+
+class WeakGlobalRef(jobject):
+    """A JNI weak global reference that is deleted when it is garbage collected."""
+    def __del__(self, _delete=java.DeleteWeakGlobalRef):
+        if self.value:
+            _delete(self)
+
+
+def _new_global_ref(ref):
+    """Create a new global reference to a Java object."""
+    gref = java.NewGlobalRef(ref)
+    if gref.value is None:
+        raise RuntimeError("Unable to create global reference.")
+    return GlobalRef(gref.value)
+
+
+def _global_ref(ref):
+    """Promote a local reference to a global reference.
+
+    The local reference is deleted; the caller owns the global reference.
     """
     try:
-        # print ("PYTHON SIDE DISPATCH", instance, method, args)
-        pyinstance = _proxy_cache[instance]
-        signatures = pyinstance._methods.get(method)
-        if len(signatures) == 1:
-            signature = list(signatures)[0]
-            if len(signature) != len(args):
-                raise RuntimeError("argc provided for dispatch doesn't match registered method.")
-            try:
-                args = [dispatch_cast(jarg, jtype) for jarg, jtype in zip(args, signature)]
-                getattr(pyinstance, method)(*args)
-            except Exception:
-                import traceback
-                traceback.print_exc()
-        else:
-            raise RuntimeError("Can't handle multiple prototypes for same method name (yet!)")
-    except KeyError:
-        raise RuntimeError("Unknown Python instance %d", instance)
+        return _new_global_ref(ref)
+    finally:
+        java.DeleteLocalRef(ref)
+
+
+###########################################################################
+# Identity of Java objects
+#
+# Optionally, a Java object that crosses the bridge more than once is
+# represented by the same Python wrapper for as long as that wrapper is
+# alive, so Python identity matches Java identity.
+###########################################################################
+
+# Weak references to wrappers for Java objects, keyed by
+# System.identityHashCode(). Each entry is a list, as distinct objects can
+# share a hash code, and an object can be wrapped as more than one class.
+_identity_map = {}
+
+_use_identity_map = False
+
+
+def set_identity_map(enabled):
+    """Enable or disable the identity map for Java objects.
+
+    When enabled, a Java object that is passed to Python more than once is
+    represented by the same wrapper (as long as it is still alive), rather
+    than a new wrapper and global reference each time. This costs a call
+    to System.identityHashCode() each time an object crosses the bridge.
+    """
+    global _use_identity_map
+    _use_identity_map = bool(enabled)
+    if not enabled:
+        _identity_map.clear()
+
+
+def _identity(ref):
+    return java.CallStaticIntMethod(reflect.System, reflect.System__identityHashCode, ref)
+
+
+def _forget_wrapper(identity, wrapper_ref):
+    try:
+        wrappers = _identity_map[identity]
+        wrappers.remove(wrapper_ref)
+        if not wrappers:
+            del _identity_map[identity]
+    except (KeyError, ValueError):
+        pass
+
+
+def _remember_wrapper(wrapper, identity):
+    _identity_map.setdefault(identity, []).append(
+        weakref.ref(wrapper, functools.partial(_forget_wrapper, identity))
+    )
+
+
+def _java_instance(klass, ref, local):
+    """Retrieve a wrapper of the given JavaClass for a Java object.
+
+    If local is True, ref is a local reference, which is consumed;
+    otherwise, ref is left untouched.
+    """
+    if _use_identity_map:
+        identity = _identity(ref)
+        for wrapper_ref in tuple(_identity_map.get(identity, ())):
+            wrapper = wrapper_ref()
+            if type(wrapper) is klass and java.IsSameObject(wrapper._jni, ref):
+                if local:
+                    java.DeleteLocalRef(ref)
+                return wrapper
+
+    wrapper = klass(jni=_global_ref(ref) if local else _new_global_ref(ref))
+    if _use_identity_map:
+        _remember_wrapper(wrapper, identity)
+    return wrapper
+
+
+def _frame_capacity(params_signature, return_signature):
+    """Determine the number of local references an invocation can create.
+
+    Strings and arrays passed as arguments, and objects returned by the
+    method, are local references. If there are none, the invocation
+    doesn't need a local frame.
+    """
+    capacity = sum(1 for type_name in _split_signature(params_signature) if type_name[0] in 'L[')
+    if return_signature[0] in 'L[':
+        capacity += 1
+    return capacity
 
 
 ###########################################################################
@@ -59,59 +329,391 @@ def dispatch(instance, method, args):
 # Methods to convert argument lists into a signature, and vice versa
 ###########################################################################
 
+# The codec that matches the in-memory representation of Java strings.
+_UTF16 = 'utf-16-le' if sys.byteorder == 'little' else 'utf-16-be'
+
+
+def _string_value(jstr):
+    """Convert a Java string into a Python unicode object.
+
+    The characters are copied directly from the string's UTF-16
+    representation; the Java string is not modified or deleted.
+    """
+    if _rubicon:
+        return _rubicon.string_value(jstr.value)
+    if jstr.value is None:
+        return None
+
+    length = java.GetStringLength(jstr)
+    chars = (jchar * length)()
+    java.GetStringRegion(jstr, 0, length, chars)
+    return string_at(chars, length * sizeof(jchar)).decode(_UTF16)
+
+
+def _check_java_exception():
+    """If a Java exception is pending, clear it, and raise it as a RuntimeError.
+
+    The message is the description of the Java exception, as it is for
+    calls made through the native fast path.
+    """
+    if not java.ExceptionCheck():
+        return
+    exc = java.ExceptionOccurred()
+    java.ExceptionClear()
+    try:
+        description = java.CallObjectMethod(exc, reflect.Throwable__toString)
+        if java.ExceptionCheck():
+            java.ExceptionClear()
+            message = None
+        else:
+            message = _string_value(description)
+            if description.value:
+                java.DeleteLocalRef(description)
+    finally:
+        java.DeleteLocalRef(exc)
+    raise RuntimeError(message)
+
+
+def _java_string(value):
+    """Create a Java string from a Python string.
+
+    If the native Rubicon module is available, short strings are served
+    from a cache of interned Java strings; the returned reference may be a
+    cached global reference, so it must not be deleted.
+    """
+    if _rubicon:
+        return jstring(_rubicon.java_string(value))
+    if isinstance(value, bytes):
+        value = value.decode('utf-8')
+    chars = value.encode(_UTF16)
+    return java.NewString(cast(c_char_p(chars), jchar_p), len(chars) // sizeof(jchar))
+
+
+def set_string_cache_size(size):
+    """Set the maximum number of strings in the cache of interned Java strings.
+
+    Short Python strings that are passed to Java are cached, so they are
+    only converted once. Once the cache is full, no more strings are added.
+    Setting the size to 0 disables the cache. Reducing the size of the
+    cache empties it; this must not be done while other threads are
+    invoking Java methods.
+    """
+    if _rubicon:
+        _rubicon.set_string_cache_size(size)
+
+
+def _jvalue_buffer(size):
+    """Retrieve a jvalue array that can hold at least `size` arguments.
+
+    Each thread has its own buffer; it is allocated the first time it is
+    needed, and only reallocated when a call needs more arguments than
+    it can hold.
+    """
+    try:
+        buf = _thread_state.jvalues
+        if len(buf) >= size:
+            return buf
+    except AttributeError:
+        pass
+    buf = (jvalue * max(size, 8))()
+    _thread_state.jvalues = buf
+    return buf
+
+
 def convert_args(args, type_names):
     """Convert a list of arguments to be in a format compliant with the JNI signature.
 
-    This means:
-     * casting primitives into the apprpriate jXXX ctypes objects,
+    The arguments are packed into this thread's jvalue buffer, which can then
+    be passed to the Call*MethodA family of JNI functions. This means:
+     * storing primitives in the jvalue field for their JNI type,
      * Strings into Java string objects, and
      * JavaInstance/JavaProxy objects into their JNI references.
+
+    The buffer is reused by the next call on the same thread, so it must be
+    passed to JNI before any other Java method is invoked.
     """
-    converted = []
-    for type_name, arg in zip(type_names, args):
-        if isinstance(arg, jboolean):
-            converted.append(arg)
-        elif isinstance(arg, bool):
-            converted.append(jboolean(arg))
-        elif isinstance(arg, jbyte):
-            converted.append(arg)
-        elif isinstance(arg, jchar):
-            converted.append(arg)
-        elif isinstance(arg, jshort):
-            converted.append(arg)
-        elif isinstance(arg, jint):
-            converted.append(arg)
-        elif isinstance(arg, int):
-            if type_name == 'I':
-                converted.append(jint(arg))
-            elif type_name == 'J':
-                converted.append(jlong(arg))
-            elif type_name == 'S':
-                converted.append(jshort(arg))
-            else:
-                raise ValueError("Unexpected type name for int argument.")
-        elif isinstance(arg, jlong):
-            converted.append(arg)
-        elif isinstance(arg, jfloat):
-            converted.append(jdouble(arg.value))
-        elif isinstance(arg, float):
-            # The JNI method uses VA_ARGS, and VA_ARGS transparently
-            # converts floats to doubles; so regardless of whether the
-            # argument is F or D, cast to jdouble.
-            converted.append(jdouble(arg))
-        elif isinstance(arg, jdouble):
-            converted.append(arg)
+    converted = _jvalue_buffer(len(args))
+    for i, (type_name, arg) in enumerate(zip(type_names, args)):
+        if isinstance(arg, (jboolean, jbyte, jchar, jshort, jint, jlong, jfloat, jdouble)):
+            arg = arg.value
+
+        if type_name == 'Z':
+            converted[i].z = arg
+        elif type_name == 'B':
+            converted[i].b = arg
+        elif type_name == 'C':
+            converted[i].c = ord(arg) if isinstance(arg, basestring) else arg
+        elif type_name == 'S':
+            converted[i].s = arg
+        elif type_name == 'I':
+            converted[i].i = arg
+        elif type_name == 'J':
+            converted[i].j = arg
+        elif type_name == 'F':
+            converted[i].f = arg
+        elif type_name == 'D':
+            converted[i].d = arg
         elif isinstance(arg, basestring):
-            converted.append(java.NewStringUTF(arg.encode('utf-8')))
-        elif isinstance(arg, (JavaInstance, JavaProxy)):
-            converted.append(arg._jni)
+            converted[i].l = _java_string(arg)
+        elif isinstance(arg, (JavaInstance, JavaProxy, JavaArray)):
+            converted[i].l = arg._jni
+        elif type_name[0] == '[':
+            converted[i].l = _new_array(type_name[1], arg)
         else:
             raise ValueError("Unknown argument type", arg, type(arg))
 
     return converted
 
 
-def select_polymorph(polymorphs, args):
+def _buffer_signature(data):
+    """Determine the Java array type that matches the content of a Python buffer.
+
+    Returns the JNI signature of the array type (e.g., '[D' for a buffer of
+    doubles), or None if data isn't a buffer of a type Java can represent.
+    """
+    if isinstance(data, bytearray):
+        return '[B'
+    elif isinstance(data, array.array):
+        format, itemsize = data.typecode, data.itemsize
+    else:
+        try:
+            view = memoryview(data)
+        except TypeError:
+            return None
+        format, itemsize = view.format.lstrip('@=<!'), view.itemsize
+
+    if format == '?':
+        return '[Z'
+    elif format in ('f', 'd'):
+        return {4: '[F', 8: '[D'}.get(itemsize)
+    elif format in ('b', 'h', 'i', 'l', 'q'):
+        return {1: '[B', 2: '[S', 4: '[I', 8: '[J'}.get(itemsize)
+    elif format in ('c', 'B', 'H', 'I', 'L', 'Q'):
+        return {1: '[B', 2: '[C', 4: '[I', 8: '[J'}.get(itemsize)
+    return None
+
+
+def _new_array(type_code, data):
+    """Create a new Java primitive array, holding a copy of the content of a Python buffer.
+
+    type_code is the JNI type of the array elements (e.g., 'I' for an int[]).
+    The content of the buffer is used as-is; it must be in the native
+    representation of the element type.
+
+    Returns a local reference to the new array.
+    """
+    if _rubicon:
+        return jobject(_rubicon.new_array(type_code.encode('ascii'), data))
+
+    ctype, array_type, new_array, get_region, set_region = _PRIMITIVE_ARRAYS[type_code]
+    content = buffer(data)
+    count, remainder = divmod(len(content), sizeof(ctype))
+    if remainder:
+        raise ValueError("Buffer size (%s bytes) is not a multiple of the element size of '%s' arrays" % (len(content), type_code))
+    java_array = new_array(count)
+    set_region(java_array, 0, count, (ctype * count).from_buffer_copy(content))
+    return java_array
+
+
+# The maximum number of argument type combinations that will be remembered
+# by a single resolution cache.
+RESOLUTION_CACHE_SIZE = 64
+
+# A cache of parameter signatures, split into individual type signatures.
+_split_signature_cache = {}
+
+
+def _split_signature(params_signature):
+    """Split a JNI parameter signature into the signatures of each parameter.
+
+    e.g., 'ILjava/lang/String;[Z' => ('I', 'Ljava/lang/String;', '[Z')
+    """
+    try:
+        return _split_signature_cache[params_signature]
+    except KeyError:
+        pass
+
+    types = []
+    start = 0
+    i = 0
+    while i < len(params_signature):
+        while params_signature[i] == '[':
+            i += 1
+        if params_signature[i] == 'L':
+            i = params_signature.index(';', i)
+        i += 1
+        types.append(params_signature[start:i])
+        start = i
+
+    types = tuple(types)
+    _split_signature_cache[params_signature] = types
+    return types
+
+
+def _candidate_types(arg):
+    """Determine the Java types that could be used to represent a Python argument.
+
+    The types are returned in order of preference; the first type is the
+    most specific representation of the argument. For Java objects, only
+    the type of the object is returned; the other types that can represent
+    the object are determined by _object_ranks().
+    """
+    if isinstance(arg, (bool, jboolean)):
+        return ['Z']
+    elif isinstance(arg, jbyte):
+        return ['B']
+    elif isinstance(arg, jchar):
+        return ['C']
+    elif isinstance(arg, jshort):
+        return ['S']
+    elif isinstance(arg, jint):
+        return ['I']
+    elif isinstance(arg, int):
+        return ['I', 'J', 'S']
+    elif isinstance(arg, jlong):
+        return ['J']
+    elif isinstance(arg, jfloat):
+        return ['F']
+    elif isinstance(arg, float):
+        return ['D', 'F']
+    elif isinstance(arg, jdouble):
+        return ['D']
+    elif isinstance(arg, basestring):
+        return [
+            "Ljava/lang/String;",
+            "Ljava/io/Serializable;",
+            "Ljava/lang/Comparable;",
+            "Ljava/lang/CharSequence;",
+            "Ljava/lang/Object;",
+        ]
+    elif isinstance(arg, (JavaInstance, JavaProxy)):
+        return ['L%s;' % arg.__class__.__dict__['_descriptor']]
+    elif isinstance(arg, JavaArray):
+        return [
+            arg._signature,
+            "Ljava/lang/Cloneable;",
+            "Ljava/io/Serializable;",
+            "Ljava/lang/Object;",
+        ]
+
+    # Any other buffer can be passed as a primitive array.
+    signature = _buffer_signature(arg)
+    if signature:
+        return [signature]
+    raise ValueError("Unknown argument type", arg, type(arg))
+
+
+# A cache of the results of IsAssignableFrom, keyed by the descriptors of
+# the two classes.
+_assignable_cache = {}
+
+
+def _is_assignable(from_descriptor, to_descriptor):
+    """Determine if an object of one Java class can be used as another."""
+    key = (from_descriptor, to_descriptor)
+    try:
+        return _assignable_cache[key]
+    except KeyError:
+        pass
+
+    if from_descriptor == to_descriptor or to_descriptor == 'java/lang/Object':
+        result = True
+    else:
+        try:
+            result = bool(java.IsAssignableFrom(
+                JavaClass(from_descriptor).__dict__['_jni'],
+                JavaClass(to_descriptor).__dict__['_jni'],
+            ))
+        except UnknownClassException:
+            result = False
+    _assignable_cache[key] = result
+    return result
+
+
+def _object_ranks(descriptor, param_types):
+    """Rank the parameter types that could accept an instance of a Java class.
+
+    Returns a dictionary of type signature: rank for each of param_types
+    that an instance of the class described by descriptor can be assigned
+    to. Lower ranks are more specific; the rank of a type is the number of
+    other acceptable types that are more specific than it.
+    """
+    acceptable = [
+        param_type for param_type in param_types
+        if param_type[0] == 'L' and _is_assignable(descriptor, param_type[1:-1])
+    ]
+    return dict(
+        (param_type, sum(
+            1 for other in acceptable
+            if other != param_type and _is_assignable(other[1:-1], param_type[1:-1])
+        ))
+        for param_type in acceptable
+    )
+
+
+def _resolution_key(arg):
+    """Determine the key used to remember the resolution of an argument.
+
+    For most arguments, the outcome of resolution depends only on the Python
+    type of the argument; the type of a Java object determines its
+    alternates. Java arrays and buffers are resolved using the type of
+    their content.
+    """
+    if isinstance(arg, (int, long, float, basestring, JavaInstance, JavaProxy,
+            jboolean, jbyte, jchar, jshort, jint, jlong, jfloat, jdouble)):
+        return type(arg)
+    elif isinstance(arg, JavaArray):
+        return arg._signature
+    return type(arg), _buffer_signature(arg)
+
+
+def _resolve_polymorph(polymorphs, args):
+    """Determine the arg_sig and match_types for an argument list.
+
+    Every polymorph whose parameters could all accept the corresponding
+    argument is a candidate. As in Java, the most specific candidate is
+    selected - the candidate that is at least as specific as every other
+    candidate for every argument. If there isn't a single most specific
+    candidate, the candidate with the most specific parameters overall is
+    used; ties are resolved in favor of the first candidate found.
+    """
+    arg_types = [_candidate_types(arg) for arg in args]
+    arg_sig = ''.join(types[0] for types in arg_types)
+
+    signatures = [
+        match_types for match_types in (_split_signature(params_signature) for params_signature in polymorphs)
+        if len(match_types) == len(args)
+    ]
+
+    # For each argument, the rank of each type that could represent it.
+    ranks = []
+    for i, (arg, types) in enumerate(zip(args, arg_types)):
+        if isinstance(arg, (JavaInstance, JavaProxy)):
+            ranks.append(_object_ranks(arg.__class__.__dict__['_descriptor'], set(match_types[i] for match_types in signatures)))
+        else:
+            ranks.append(dict((t, r) for r, t in enumerate(types)))
+
+    candidates = []
+    for match_types in signatures:
+        try:
+            candidates.append((match_types, [rank[t] for rank, t in zip(ranks, match_types)]))
+        except KeyError:
+            pass
+
+    if not candidates:
+        raise KeyError(arg_sig)
+
+    for match_types, score in candidates:
+        if all(
+            all(r <= other_r for r, other_r in zip(score, other_score))
+            for other_types, other_score in candidates
+        ):
+            return arg_sig, match_types
+
+    return arg_sig, min(candidates, key=lambda candidate: sum(candidate[1]))[0]
+
+
+def select_polymorph(polymorphs, args, cache=None):
     """Determine the polymorphic signature that will match a given argument list.
 
     This is the mechanism used to reconcile Java's strict-typing polymorphism with
@@ -125,6 +727,11 @@ def select_polymorph(polymorphs, args):
 
     args is a list of arguments that have been passed to invoke the method.
 
+    cache is an optional dictionary used to remember previous resolutions.
+    The cache is keyed by the types of the arguments (see _resolution_key).
+    The owner of the cache must clear it if the content of polymorphs
+    changes.
+
     Returns a 3-tuple:
      * arg_sig - the actual signature of the provided arguments
      * match_types - the type list that was matched. This is a list of individual
@@ -138,56 +745,112 @@ def select_polymorph(polymorphs, args):
      * polymorph - the value from the input polymorphs that matched. Equivalent
        to polymorphs[match_types]
     """
-    arg_types = []
-    if len(args) == 0:
-        arg_sig = ''
-        options = [[]]
+    if cache is None:
+        arg_sig, match_types = _resolve_polymorph(polymorphs, args)
     else:
-        for arg in args:
-            if isinstance(arg, (bool, jboolean)):
-                arg_types.append(['Z'])
-            elif isinstance(arg, jbyte):
-                arg_types.append(['B'])
-            elif isinstance(arg, jchar):
-                arg_types.append(['C'])
-            elif isinstance(arg, jshort):
-                arg_types.append(['S'])
-            elif isinstance(arg, jint):
-                arg_types.append(['I'])
-            elif isinstance(arg, int):
-                arg_types.append(['I', 'J', 'S'])
-            elif isinstance(arg, jlong):
-                arg_types.append(['J'])
-            elif isinstance(arg, jfloat):
-                arg_types.append(['F'])
-            elif isinstance(arg, float):
-                arg_types.append(['D', 'F'])
-            elif isinstance(arg, jdouble):
-                arg_types.append(['D'])
-            elif isinstance(arg, basestring):
-                arg_types.append([
-                    "Ljava/lang/String;",
-                    "Ljava/io/Serializable;",
-                    "Ljava/lang/Comparable;",
-                    "Ljava/lang/CharSequence;",
-                    "Ljava/lang/Object;",
-                ])
-            elif isinstance(arg, (JavaInstance, JavaProxy)):
-                arg_types.append(arg.__class__.__dict__['_alternates'])
-            else:
-                raise ValueError("Unknown argument type", arg, type(arg))
-
-        arg_sig = ''.join(t[0] for t in arg_types)
-
-        options = list(itertools.product(*arg_types))
-
-    for option in options:
+        key = tuple(_resolution_key(arg) for arg in args)
         try:
-            return arg_sig, option, polymorphs[''.join(option)]
+            arg_sig, match_types = cache[key]
         except KeyError:
-            pass
+            arg_sig, match_types = _resolve_polymorph(polymorphs, args)
+            if len(cache) >= RESOLUTION_CACHE_SIZE:
+                cache.clear()
+            cache[key] = arg_sig, match_types
+
+    return arg_sig, match_types, polymorphs[''.join(match_types)]
+
+
+def _parse_description(description):
+    """Decode the description of a Java class produced by Python.describe().
+
+    Returns a dictionary containing:
+     * alternates - the type signatures that can represent an instance of
+       the class, in order of preference
+     * constructors - the parameter signatures of the public constructors
+     * methods, static_methods - dictionaries of method name: list of
+       (parameter signature, return signature) for public methods
+     * fields, static_fields - dictionaries of field name: type signature
+       for public fields
+    """
+    metadata = {
+        'alternates': [],
+        'constructors': [],
+        'methods': {},
+        'static_methods': {},
+        'fields': {},
+        'static_fields': {},
+    }
+    for line in description.splitlines():
+        kind, _, rest = line.partition(' ')
+        if kind == 'A':
+            metadata['alternates'].append(rest)
+        elif kind == 'C':
+            metadata['constructors'].append(rest[1:rest.index(')')])
+        elif kind in ('M', 'S'):
+            name, signature = rest.split(' ')
+            params_signature, return_signature = signature[1:].split(')')
+            methods = metadata['static_methods' if kind == 'S' else 'methods']
+            methods.setdefault(name, []).append((params_signature, return_signature))
+        elif kind in ('F', 'G'):
+            name, signature = rest.split(' ')
+            metadata['static_fields' if kind == 'G' else 'fields'][name] = signature
+    return metadata
+
+
+def _call_describer(method, java_class):
+    result = java.CallStaticObjectMethod(reflect.Python, method, java_class)
+    if result.value is None:
+        raise RuntimeError("Couldn't describe Java class %s" % java_class)
+    try:
+        return _string_value(cast(result, jstring))
+    finally:
+        java.DeleteLocalRef(result)
+
+
+def _describe(descriptor, java_class):
+    """Retrieve the metadata for a Java class with a single call into Java.
+
+    descriptor is the name of the class (e.g., 'java/lang/String'), and
+    java_class is a JNI reference to the class. If a metadata cache is in
+    use, the description is retrieved from the cache if the class hasn't
+    changed. See _parse_description() for the format of the result.
+    """
+    if _metadata_cache is None:
+        return _parse_description(_call_describer(reflect.Python__describe, java_class))
 
-    raise KeyError(arg_sig)
+    version = _call_describer(reflect.Python__version, java_class)
+    if version == _UNCACHEABLE:
+        return _parse_description(_call_describer(reflect.Python__describe, java_class))
+    description = _metadata_cache.get(descriptor, version)
+    if description is None:
+        description = _call_describer(reflect.Python__describe, java_class)
+        _metadata_cache.put(descriptor, version, description)
+    return _parse_description(description)
+
+
+# The persistent cache of class descriptions, if one is in use.
+_metadata_cache = None
+
+# The version reported for classes that can't be identified between runs
+# (see Python.version()); their descriptions aren't cached.
+_UNCACHEABLE = 'uncacheable'
+
+
+def set_metadata_cache(path):
+    """Use a persistent cache of class metadata, stored in the file at path.
+
+    The first time a Java class is used, its public API is discovered
+    using reflection. If a metadata cache is in use, the result is stored
+    in the cache, so later runs can skip the reflection (unless the class
+    has changed). A path of None disables the cache.
+
+    The cache can also be enabled by setting the RUBICON_METADATA_CACHE
+    environment variable before the Python runtime is started.
+    """
+    global _metadata_cache
+    if _metadata_cache is not None:
+        _metadata_cache.close()
+    _metadata_cache = MetadataCache(path) if path else None
 
 
 def signature_for_type_name(type_name):
@@ -239,7 +902,7 @@ def type_names_for_params(params):
         if type_name.value is None:
             raise RuntimeError("Unable to get name of type for parameter.")
 
-        param_type = java.GetStringUTFChars(cast(type_name, jstring), None)
+        param_type = _string_value(cast(type_name, jstring))
 
         sig.append(signature_for_type_name(param_type))
 
@@ -267,14 +930,23 @@ def return_cast(raw, return_signature):
     Strings are turned into Python unicode objects.
     Objects are provided as JNI references, which are wrapped into an
     instance of the relevant JavaClass.
+
+    Local references to returned objects are consumed; objects are promoted
+    to global references owned by their Python wrapper.
     """
-    if return_signature in ('V', 'Z', 'B', 'C', 'S', 'I', 'J', 'F', 'D'):
+    if return_signature in ('V', 'Z', 'B', 'S', 'I', 'J', 'F', 'D'):
         return raw
 
+    elif return_signature == 'C':
+        return unichr(raw)
+
     elif return_signature == 'Ljava/lang/String;':
         # Check for NULL return values
         if raw.value:
-            return java.GetStringUTFChars(cast(raw, jstring), None).decode('utf-8')
+            try:
+                return _string_value(raw)
+            finally:
+                java.DeleteLocalRef(raw)
         return None
 
     elif return_signature.startswith('L'):
@@ -284,61 +956,64 @@ def return_cast(raw, return_signature):
                 klass = _class_cache[return_signature[1:-1]]
             except KeyError:
                 klass = JavaClass(return_signature[1:-1])
-            return klass(jni=raw)
+            return _java_instance(klass, raw, local=True)
+        return None
+
+    elif return_signature.startswith('['):
+        # Check for NULL return values
+        if raw.value:
+            try:
+                return JavaArray(return_signature, jni=raw)
+            finally:
+                java.DeleteLocalRef(raw)
         return None
 
     raise ValueError("Don't know how to cast return signature '%s'" % return_signature)
 
 
-def dispatch_cast(raw, type_signature):
-    """Convert a raw argument provided via a callback into a Python object matching the provided signature.
+def _wrap_object(address, return_signature):
+    """Wrap an object reference returned by the native fast path.
 
-    This is used by the callback dispatch mechanism. The values passed back will
-    be raw pointers to Java objects (even primitives are passed as pointers).
-    They need to be converted into Python objects to be passed to the proxied
-    interface implementation.
+    The native fast path converts primitives and strings itself; all
+    other return values are passed back as the address of a JNI reference.
     """
-    if type_signature == 'Z':
-        return java.CallBooleanMethod(jobject(raw), reflect.Boolean__booleanValue)
-
-    elif type_signature == 'B':
-        return java.CallByteMethod(jobject(raw), reflect.Byte__byteValue)
-
-    elif type_signature == 'C':
-        return java.CallCharMethod(jobject(raw), reflect.Char__charValue)
-
-    elif type_signature == 'S':
-        return java.CallShortMethod(jobject(raw), reflect.Short__shortValue)
-
-    elif type_signature == 'I':
-        return java.CallIntMethod(jobject(raw), reflect.Integer__intValue)
+    return return_cast(jobject(address), return_signature)
 
-    elif type_signature == 'J':
-        return java.CallLongMethod(jobject(raw), reflect.Long__longValue)
 
-    elif type_signature == 'F':
-        return java.CallFloatMethod(jobject(raw), reflect.Float__floatValue)
+def dispatch_cast(raw, type_signature):
+    """Convert a raw argument provided via a callback into a Python object matching the provided signature.
 
-    elif type_signature == 'D':
-        return java.CallDoubleMethod(jobject(raw), reflect.Double__doubleValue)
+    This is used by the callback dispatch mechanism. Primitive arguments are
+    unboxed by the native side of the bridge, and are passed back as Python
+    values; all other values will be raw pointers to Java objects. They need
+    to be converted into Python objects to be passed to the proxied interface
+    implementation.
+    """
+    if type_signature in ('Z', 'B', 'C', 'S', 'I', 'J', 'F', 'D'):
+        return raw
 
     elif type_signature == 'Ljava/lang/String;':
         # Check for NULL return values
         if c_void_p(raw).value:
-            return java.GetStringUTFChars(cast(raw, jstring), None).decode('utf-8')
+            return _string_value(jstring(raw))
         return None
 
     elif type_signature.startswith('L'):
         # Check for NULL return values
         if jobject(raw).value:
-            gref = java.NewGlobalRef(jobject(raw))
             # print ("Return type", type_signature)
             try:
                 klass = _class_cache[type_signature[1:-1]]
             except KeyError:
                 klass = JavaClass(type_signature[1:-1])
             # print("Create returned instance")
-            return klass(jni=gref)
+            return _java_instance(klass, jobject(raw), local=False)
+        return None
+
+    elif type_signature.startswith('['):
+        # Check for NULL return values
+        if jobject(raw).value:
+            return JavaArray(type_signature, jni=jobject(raw))
         return None
 
     raise ValueError("Don't know how to convert argument with type signature '%s'" % type_signature)
@@ -359,20 +1034,29 @@ class StaticJavaMethod(object):
         self.java_class = java_class
         self.name = name
         self._polymorphs = {}
+        self._resolutions = {}
+        self.blocking = True
+        if _rubicon:
+            self._fast = _rubicon.Method(java_class.__dict__['_descriptor'], name, java_class.__dict__['_jni'].value, True)
+        else:
+            self._fast = None
+
+    def set_blocking(self, blocking):
+        _set_invokers_blocking(self, blocking)
 
     def add(self, params_signature, return_signature):
         if params_signature not in self._polymorphs:
-            invoker = {
-                'V': java.CallStaticVoidMethod,
-                'Z': java.CallStaticBooleanMethod,
-                'B': java.CallStaticByteMethod,
-                'C': java.CallStaticCharMethod,
-                'S': java.CallStaticShortMethod,
-                'I': java.CallStaticIntMethod,
-                'J': java.CallStaticLongMethod,
-                'F': java.CallStaticFloatMethod,
-                'D': java.CallStaticDoubleMethod,
-            }.get(return_signature, java.CallStaticObjectMethod)
+            invoker_name = {
+                'V': 'CallStaticVoidMethodA',
+                'Z': 'CallStaticBooleanMethodA',
+                'B': 'CallStaticByteMethodA',
+                'C': 'CallStaticCharMethodA',
+                'S': 'CallStaticShortMethodA',
+                'I': 'CallStaticIntMethodA',
+                'J': 'CallStaticLongMethodA',
+                'F': 'CallStaticFloatMethodA',
+                'D': 'CallStaticDoubleMethodA',
+            }.get(return_signature, 'CallStaticObjectMethodA')
 
             full_signature = '(%s)%s' % (params_signature, return_signature)
             jni = java.GetStaticMethodID(self.java_class.__dict__['_jni'], self.name, full_signature)
@@ -385,19 +1069,18 @@ class StaticJavaMethod(object):
 
             self._polymorphs[params_signature] = {
                 'return_signature': return_signature,
-                'invoker': invoker,
-                'jni': jni
+                'invoker_name': invoker_name,
+                'invoker': _invoker(invoker_name, self.blocking),
+                'jni': jni,
+                'frame': _frame_capacity(params_signature, return_signature),
             }
+            self._resolutions.clear()
+            if self._fast:
+                self._fast.add(params_signature, return_signature, jni.value)
 
     def __call__(self, *args):
         try:
-            arg_sig, match_types, polymorph = select_polymorph(self._polymorphs, args)
-            result = polymorph['invoker'](
-                self.java_class.__dict__['_jni'],
-                polymorph['jni'],
-                *convert_args(args, match_types)
-            )
-            return return_cast(result, polymorph['return_signature'])
+            arg_sig, match_types, polymorph = select_polymorph(self._polymorphs, args, self._resolutions)
         except KeyError as e:
             raise ValueError(
                 "Can't find Java static method '%s.%s' matching argument signature '%s'. Options are: %s" % (
@@ -408,24 +1091,57 @@ class StaticJavaMethod(object):
                     )
             )
 
+        if polymorph['frame']:
+            with local_frame(polymorph['frame']):
+                result = polymorph['invoker'](
+                    self.java_class.__dict__['_jni'],
+                    polymorph['jni'],
+                    convert_args(args, match_types)
+                )
+                _check_java_exception()
+                return return_cast(result, polymorph['return_signature'])
+
+        result = polymorph['invoker'](
+            self.java_class.__dict__['_jni'],
+            polymorph['jni'],
+            convert_args(args, match_types)
+        )
+        _check_java_exception()
+        return return_cast(result, polymorph['return_signature'])
+
+
 class JavaMethod(object):
     def __init__(self, java_class, name):
         self.java_class = java_class
         self.name = name
         self._polymorphs = {}
+        self._resolutions = {}
+        self.blocking = True
+        if _rubicon:
+            self._fast = _rubicon.Method(java_class.__dict__['_descriptor'], name, java_class.__dict__['_jni'].value, False)
+        else:
+            self._fast = None
+
+    def set_blocking(self, blocking):
+        _set_invokers_blocking(self, blocking)
 
     def add(self, params_signature, return_signature):
-        invoker = {
-            'V': java.CallVoidMethod,
-            'Z': java.CallBooleanMethod,
-            'B': java.CallByteMethod,
-            'C': java.CallCharMethod,
-            'S': java.CallShortMethod,
-            'I': java.CallIntMethod,
-            'J': java.CallLongMethod,
-            'F': java.CallFloatMethod,
-            'D': java.CallDoubleMethod,
-        }.get(return_signature, java.CallObjectMethod)
+        # As with the native fast path, the first method with a given
+        # parameter signature wins.
+        if params_signature in self._polymorphs:
+            return
+
+        invoker_name = {
+            'V': 'CallVoidMethodA',
+            'Z': 'CallBooleanMethodA',
+            'B': 'CallByteMethodA',
+            'C': 'CallCharMethodA',
+            'S': 'CallShortMethodA',
+            'I': 'CallIntMethodA',
+            'J': 'CallLongMethodA',
+            'F': 'CallFloatMethodA',
+            'D': 'CallDoubleMethodA',
+        }.get(return_signature, 'CallObjectMethodA')
 
         full_signature = '(%s)%s' % (params_signature, return_signature)
         jni = java.GetMethodID(self.java_class.__dict__['_jni'], self.name, full_signature)
@@ -438,19 +1154,18 @@ class JavaMethod(object):
 
         self._polymorphs[params_signature] = {
             'return_signature': return_signature,
-            'invoker': invoker,
-            'jni': jni
+            'invoker_name': invoker_name,
+            'invoker': _invoker(invoker_name, self.blocking),
+            'jni': jni,
+            'frame': _frame_capacity(params_signature, return_signature),
         }
+        self._resolutions.clear()
+        if self._fast:
+            self._fast.add(params_signature, return_signature, jni.value)
 
     def __call__(self, instance, *args):
         try:
-            arg_sig, match_types, polymorph = select_polymorph(self._polymorphs, args)
-            result = polymorph['invoker'](
-                instance,
-                polymorph['jni'],
-                *convert_args(args, match_types)
-            )
-            return return_cast(result, polymorph['return_signature'])
+            arg_sig, match_types, polymorph = select_polymorph(self._polymorphs, args, self._resolutions)
         except KeyError as e:
             raise ValueError(
                 "Can't find Java instance method '%s.%s' matching argument signature '%s'. Options are: %s" % (
@@ -461,6 +1176,87 @@ class JavaMethod(object):
                     )
             )
 
+        if polymorph['frame']:
+            with local_frame(polymorph['frame']):
+                result = polymorph['invoker'](
+                    instance,
+                    polymorph['jni'],
+                    convert_args(args, match_types)
+                )
+                _check_java_exception()
+                return return_cast(result, polymorph['return_signature'])
+
+        result = polymorph['invoker'](
+            instance,
+            polymorph['jni'],
+            convert_args(args, match_types)
+        )
+        _check_java_exception()
+        return return_cast(result, polymorph['return_signature'])
+
+
+###########################################################################
+# Blocking and non-blocking Java methods
+#
+# By default, the GIL is released while a Java method runs, so that other
+# Python threads can run if the method blocks. Methods that are known to
+# return quickly can be declared non-blocking, so that they run with the
+# GIL held (see rubicon.java.jni for the GIL policy).
+###########################################################################
+
+# Methods that have been declared blocking or non-blocking, keyed by
+# (class descriptor, method name); a name of None applies to every method
+# of the class.
+_blocking = {}
+
+
+def set_blocking(java_class, blocking, *names):
+    """Declare whether methods of a Java class can block.
+
+    If no method names are provided, the declaration applies to every
+    method of the class that hasn't been declared individually.
+
+    A method must only be declared non-blocking if it returns quickly, and
+    never waits for another thread that might need the GIL - including a
+    thread invoking a Python implementation of an interface. Declarations
+    are ignored under the 'always' GIL policy.
+    """
+    descriptor = java_class.__dict__['_descriptor']
+    for name in names or (None,):
+        _blocking[(descriptor, name)] = blocking
+
+    # Update any methods that are already in use.
+    for methods in (java_class.__dict__['_members']['methods'], java_class.__dict__['_static']['methods']):
+        for name, wrapper in methods.items():
+            if wrapper:
+                wrapper.set_blocking(_is_blocking(java_class, name))
+
+
+def _is_blocking(java_class, name):
+    if gil_policy == GIL_RELEASE_ALWAYS:
+        return True
+    descriptor = java_class.__dict__['_descriptor']
+    try:
+        return _blocking[(descriptor, name)]
+    except KeyError:
+        return _blocking.get((descriptor, None), True)
+
+
+def _invoker(name, blocking):
+    """Retrieve the JNI function used to invoke a Java method."""
+    if blocking:
+        return getattr(java, name)
+    return held(name)
+
+
+def _set_invokers_blocking(method, blocking):
+    """Update a StaticJavaMethod or JavaMethod to be blocking or non-blocking."""
+    method.blocking = blocking
+    for polymorph in method._polymorphs.values():
+        polymorph['invoker'] = _invoker(polymorph['invoker_name'], blocking)
+    if method._fast:
+        method._fast.set_blocking(blocking)
+
 
 class BoundJavaMethod(object):
     def __init__(self, instance, method):
@@ -505,6 +1301,12 @@ class StaticJavaField(object):
         if self._jni.value is None:
             raise RuntimeError("Couldn't find static Java field '%s.%s'" % (self.java_class.__dict__['_jni'], self.name))
 
+        # If the native fast path is available, use it for access.
+        if _rubicon:
+            fast = _rubicon.Field(self.java_class.__dict__['_jni'].value, self._jni.value, self._signature, True)
+            self.get = fast.get
+            self.set = fast.set
+
     def get(self):
         result = self._accessor(self.java_class.__dict__['_jni'], self._jni)
         return return_cast(result, self._signature)
@@ -544,6 +1346,12 @@ class JavaField(object):
         if self._jni.value is None:
             raise RuntimeError("Couldn't find Java field '%s.%s'" % (self.java_class.__dict__['_jni'], self.name))
 
+        # If the native fast path is available, use it for access.
+        if _rubicon:
+            fast = _rubicon.Field(self.java_class.__dict__['_jni'].value, self._jni.value, self._signature, False)
+            self.get = fast.get
+            self.set = fast.set
+
     def get(self, instance):
         result = self._accessor(instance._jni, self._jni)
         return return_cast(result, self._signature)
@@ -553,71 +1361,191 @@ class JavaField(object):
 
 
 ###########################################################################
-# Representations of Java classes and instances
+# Representations of Java arrays
 ###########################################################################
 
+class JavaArray(object):
+    """The representation of a Java array.
 
-def _cache_field(java_class, name, static):
-    # print("%s: Look up %sfield %s" % (java_class.__dict__['_descriptor'], 'static ' if static else '', name))
-    java_field = java.CallStaticObjectMethod(reflect.Python, reflect.Python__getField, java_class.__dict__['_jni'], java.NewStringUTF(name), jboolean(static))
-    if java_field.value:
-        # print("%s: Registering %sfield %s" % (java_class.__dict__['_descriptor'], 'static ' if static else '', name))
-        java_type = java.CallObjectMethod(java_field, reflect.Field__getType)
-        type_name = java.CallObjectMethod(java_type, reflect.Class__getName)
+    Constructor requires:
+     * signature - the JNI type signature of the array (e.g., '[I')
+     * jni - a JNI reference to the array. The JavaArray creates (and
+       owns) its own global reference to the array, which is deleted when
+       the JavaArray is garbage collected.
+
+    The content of primitive arrays can be accessed without copying by
+    using view(); the returned ArrayView supports the buffer protocol, so
+    it can be wrapped by a memoryview or a NumPy array.
+    """
+    def __init__(self, signature, jni):
+        jni = _new_global_ref(jni)
+        self._signature = signature
+        self._jni = jni
+        self._as_parameter_ = jni
+
+    @classmethod
+    def from_buffer(cls, data, signature=None):
+        """Create a new Java primitive array holding a copy of the content of a buffer.
+
+        If a signature isn't provided, the array type is determined from
+        the format of the buffer.
+        """
+        if signature is None:
+            signature = _buffer_signature(data)
+            if signature is None:
+                raise ValueError("Can't determine the Java array type for %s" % type(data))
+        if signature[1:] not in _PRIMITIVE_ARRAYS:
+            raise ValueError("Can't create a Java array of type '%s' from a buffer" % signature)
+
+        jni = _new_array(signature[1], data)
+        try:
+            return cls(signature, jni)
+        finally:
+            java.DeleteLocalRef(jni)
+
+    def __repr__(self):
+        return "<JavaArray %s: %s>" % (self._signature, self._jni.value)
 
-        signature = signature_for_type_name(java.GetStringUTFChars(cast(type_name, jstring), None))
+    def __len__(self):
+        return java.GetArrayLength(self._jni)
 
-        if static:
-            wrapper = StaticJavaField(java_class=java_class, name=name, signature=signature)
+    def __getitem__(self, index):
+        length = len(self)
+        if index < 0:
+            index += length
+        if not 0 <= index < length:
+            raise IndexError("Java array index out of range")
+
+        element_signature = self._signature[1:]
+        try:
+            ctype, array_type, new_array, get_region, set_region = _PRIMITIVE_ARRAYS[element_signature]
+        except KeyError:
+            return return_cast(java.GetObjectArrayElement(cast(self._jni, jobjectArray), index), element_signature)
+
+        value = ctype()
+        get_region(cast(self._jni, array_type), index, 1, byref(value))
+        if element_signature == 'C':
+            return unichr(value.value)
+        return value.value
+
+    def view(self, readonly=False):
+        """Access the content of a primitive array using the buffer protocol.
+
+        The elements of the array are pinned (or, if the JVM can't pin the
+        array, copied) until the view is released. Changes made through the
+        view are visible to Java once the view is released (or committed).
+        The view can be used as a context manager; it is released when the
+        with block exits.
+
+        If readonly is True, the view can't be modified, and no copy will
+        be made when the view is released.
+        """
+        if _rubicon is None:
+            raise RuntimeError("Array views require the native Rubicon module.")
+        if self._signature[1:] not in _PRIMITIVE_ARRAYS:
+            raise TypeError("Only primitive arrays can be viewed as buffers.")
+        return _rubicon.ArrayView(self._jni.value, self._signature[1].encode('ascii'), readonly)
+
+    def copy_into(self, data):
+        """Copy the content of a primitive array into a writable buffer.
+
+        The buffer must be exactly the size of the array. The array is only
+        pinned (using GetPrimitiveArrayCritical) for the duration of the
+        copy, so this is the cheapest way to take a snapshot of an array.
+        """
+        element_signature = self._signature[1:]
+        if element_signature not in _PRIMITIVE_ARRAYS:
+            raise TypeError("Only primitive arrays can be copied into buffers.")
+        if _rubicon:
+            _rubicon.copy_array(self._jni.value, element_signature.encode('ascii'), data)
         else:
-            wrapper = JavaField(java_class=java_class, name=name, signature=signature)
+            ctype, array_type, new_array, get_region, set_region = _PRIMITIVE_ARRAYS[element_signature]
+            length = len(self)
+            if len(buffer(data)) != length * sizeof(ctype):
+                raise ValueError("Buffer size doesn't match the size of the array")
+            get_region(cast(self._jni, array_type), 0, length, (ctype * length).from_buffer(data))
 
-        java.DeleteLocalRef(java_field)
-        java.DeleteLocalRef(java_type)
-        java.DeleteLocalRef(type_name)
-    else:
-        # print ("%s: %s %s does not exist" % (java_class.__dict__['_descriptor'], 'Static field' if static else 'Field', name))
-        wrapper = None
 
-    return wrapper
+###########################################################################
+# Sharing memory with Java
+###########################################################################
 
+def direct_buffer(data):
+    """Expose the memory of a Python buffer to Java as a direct java.nio.ByteBuffer.
 
-def _cache_methods(java_class, name, static):
-    # print("%s: Look up %smethod %s" % (java_class.__dict__['_descriptor'], 'static ' if static else '', name))
-    java_methods = java.CallStaticObjectMethod(reflect.Python, reflect.Python__getMethods, java_class.__dict__['_jni'], java.NewStringUTF(name), jboolean(static))
-    if java_methods.value:
-        # print("%s: Registering %smethod %s" % (java_class.__dict__['_descriptor'], 'static ' if static else '', name))
+    No copy is made; changes made by either side are visible to the other.
+    The Python object is kept alive until Java has collected the ByteBuffer
+    (and any buffers derived from it). Read only Python buffers are exposed
+    as read only ByteBuffers.
 
-        if static:
-            wrapper = StaticJavaMethod(java_class=java_class, name=name)
-        else:
-            wrapper = JavaMethod(java_class=java_class, name=name)
+    Objects that only support the old buffer protocol (such as mmap objects)
+    can't prevent their memory from being released; they must not be closed
+    while Java is using the buffer.
+    """
+    if _rubicon is None:
+        raise RuntimeError("Sharing buffers requires the native Rubicon module.")
+    jni = jobject(_rubicon.new_direct_buffer(data))
+    return JavaClass('java/nio/ByteBuffer')(jni=_global_ref(jni))
 
-        java_methods = cast(java_methods, jobjectArray)
-        method_count = java.GetArrayLength(java_methods)
-        for i in range(0, method_count):
-            java_method = java.GetObjectArrayElement(java_methods, i)
 
-            params = java.CallObjectMethod(java_method, reflect.Method__getParameterTypes)
-            params = cast(params, jobjectArray)
+def buffer_view(byte_buffer):
+    """Access the memory of a direct java.nio.ByteBuffer as a Python buffer.
 
-            java_type = java.CallObjectMethod(java_method, reflect.Method__getReturnType)
-            type_name = java.CallObjectMethod(java_type, reflect.Class__getName)
-            return_type_name = java.GetStringUTFChars(cast(type_name, jstring), None)
+    This includes buffers that are backed by a memory mapped file. The view
+    covers the full capacity of the buffer, regardless of its position and
+    limit, and keeps the ByteBuffer alive for as long as the view exists.
+    """
+    if _rubicon is None:
+        raise RuntimeError("Sharing buffers requires the native Rubicon module.")
+    return _rubicon.DirectBuffer(byte_buffer._jni.value, byte_buffer.isReadOnly())
 
-            wrapper.add(signature_for_params(params), signature_for_type_name(return_type_name))
-            java.DeleteLocalRef(type_name)
-            java.DeleteLocalRef(java_type)
-            java.DeleteLocalRef(params)
-            java.DeleteLocalRef(java_method)
-        java.DeleteLocalRef(java_methods)
 
-        # print("%s: Registered %smethod %s: %s" % (java_class.__dict__['_descriptor'], 'static ' if static else '', name, wrapper._polymorphs))
+###########################################################################
+# Representations of Java classes and instances
+###########################################################################
 
-    else:
+
+def _class_metadata(java_class):
+    """Retrieve the metadata for a JavaClass, describing the class on first use."""
+    metadata = java_class.__dict__['_metadata']
+    if metadata is None:
+        metadata = _describe(java_class.__dict__['_descriptor'], java_class.__dict__['_jni'])
+        type.__setattr__(java_class, '_metadata', metadata)
+    return metadata
+
+
+def _cache_field(java_class, name, static):
+    # print("%s: Look up %sfield %s" % (java_class.__dict__['_descriptor'], 'static ' if static else '', name))
+    signature = _class_metadata(java_class)['static_fields' if static else 'fields'].get(name)
+    if signature is None:
+        # print ("%s: %s %s does not exist" % (java_class.__dict__['_descriptor'], 'Static field' if static else 'Field', name))
+        return None
+
+    # print("%s: Registering %sfield %s" % (java_class.__dict__['_descriptor'], 'static ' if static else '', name))
+    if static:
+        return StaticJavaField(java_class=java_class, name=name, signature=signature)
+    return JavaField(java_class=java_class, name=name, signature=signature)
+
+
+def _cache_methods(java_class, name, static):
+    # print("%s: Look up %smethod %s" % (java_class.__dict__['_descriptor'], 'static ' if static else '', name))
+    polymorphs = _class_metadata(java_class)['static_methods' if static else 'methods'].get(name)
+    if polymorphs is None:
         # print ("%s: %s %s does not exist" % (java_class.__dict__['_descriptor'], 'Static method' if static else 'Method', name))
-        wrapper = None
+        return None
 
+    # print("%s: Registering %smethod %s" % (java_class.__dict__['_descriptor'], 'static ' if static else '', name))
+    if static:
+        wrapper = StaticJavaMethod(java_class=java_class, name=name)
+    else:
+        wrapper = JavaMethod(java_class=java_class, name=name)
+    if not _is_blocking(java_class, name):
+        wrapper.set_blocking(False)
+
+    for params_signature, return_signature in polymorphs:
+        wrapper.add(params_signature, return_signature)
+
+    # print("%s: Registered %smethod %s: %s" % (java_class.__dict__['_descriptor'], 'static ' if static else '', name, wrapper._polymorphs))
     return wrapper
 
 
@@ -628,64 +1556,31 @@ class JavaInstance(object):
         if kwargs:
             raise ValueError("Can't construct instance of %s using keywork arguments." % (self.__class__))
 
-        if jni is None:
+        constructed = jni is None
+        if constructed:
             klass = self.__class__._jni
-
-            ##################################################################
-            # Check that we know the constructors for the class
-            ##################################################################
             constructors = self.__class__.__dict__['_constructors']
             if constructors is None:
-                # print("   %s: Loading constructors" % self.__class__.__dict__['_descriptor'])
-                constructors = {}
-                constructors_j = java.CallObjectMethod(self.__class__.__dict__['_jni'], reflect.Class__getConstructors)
-                if constructors_j.value is None:
-                    raise RuntimeError("Couldn't get constructor for '%s'" % self)
-                constructors_j = cast(constructors_j, jobjectArray)
-
-                constructor_count = java.GetArrayLength(constructors_j)
-                for i in range(0, constructor_count):
-                    constructor = java.GetObjectArrayElement(constructors_j, i)
-
-                    modifiers = java.CallIntMethod(constructor, reflect.Constructor__getModifiers)
-                    public = java.CallStaticBooleanMethod(reflect.Modifier, reflect.Modifier__isPublic, modifiers)
-
-                    if public:
-                        # We now know that a constructor exists, and we know the signature
-                        # of those constructors. However, we won't resolve the method
-                        # implementing the constructor until we need it.
-                        params = java.CallObjectMethod(constructor, reflect.Constructor__getParameterTypes)
-                        params = cast(params, jobjectArray)
-
-                        # print("  %s: registering '%s' constructor " % (self.__class__.__dict__['_descriptor'], signature_for_params(params)))
-                        constructors[signature_for_params(params)] = None
-                    # else:
-                        # print("  %s: ignoring nonpublic constructor" % self.__class__.__dict__['_descriptor'])
-
-                    java.DeleteLocalRef(params)
-                    java.DeleteLocalRef(constructor)
-                java.DeleteLocalRef(constructors_j)
+                constructors = dict.fromkeys(_class_metadata(self.__class__)['constructors'])
                 type.__setattr__(self.__class__, '_constructors', constructors)
 
-
             ##################################################################
             # Invoke the JNI constructor
             ##################################################################
             try:
-                arg_sig, match_types, constructor = select_polymorph(constructors, args)
+                arg_sig, match_types, constructor = select_polymorph(constructors, args, self.__class__.__dict__['_constructor_resolutions'])
                 if constructor is None:
                     sig = ''.join(match_types)
                     constructor = java.GetMethodID(klass, '<init>', '(%s)V' % ''.join(sig))
-                    if constructor is None:
+                    if constructor.value is None:
                         raise RuntimeError("Couldn't get method ID for %s constructor of %s" % (sig, self.__class__))
                     self.__class__.__dict__['_constructors'][sig] = constructor
 
-                jni = java.NewObject(klass, constructor, *convert_args(args, match_types))
-                if not jni:
-                    raise RuntimeError("Couldn't instantiate Java instance of %s." % self.__class__)
-                jni = cast(java.NewGlobalRef(jni), jclass)
-                if jni.value is None:
-                    raise RuntimeError("Unable to create global reference to instance.")
+                with local_frame(len(args) + 1):
+                    jni = java.NewObjectA(klass, constructor, convert_args(args, match_types))
+                    if not jni:
+                        raise RuntimeError("Couldn't instantiate Java instance of %s." % self.__class__)
+                    jni = _global_ref(jni)
 
             except KeyError as e:
                 raise ValueError(
@@ -703,6 +1598,9 @@ class JavaInstance(object):
         object.__setattr__(self, '_jni', jni)
         object.__setattr__(self, '_as_parameter_', jni)
 
+        if constructed and _use_identity_map:
+            _remember_wrapper(self, _identity(jni))
+
     def __repr__(self):
         return "<%s: %s>" % (self.__class__.__name__, self._jni.value)
 
@@ -737,6 +1635,8 @@ class JavaInstance(object):
             self.__class__.__dict__['_members']['methods'][name] = method_wrapper
 
         if method_wrapper:
+            if method_wrapper._fast:
+                return functools.partial(method_wrapper._fast, self)
             return BoundJavaMethod(self, method_wrapper)
 
         raise AttributeError("'%s' Java object has no attribute '%s'" % (self.__class__.__name__, name))
@@ -773,59 +1673,18 @@ class JavaClass(type):
         except KeyError:
             jni = java.FindClass(descriptor)
             if jni.value is None:
+                java.ExceptionClear()
                 raise UnknownClassException(descriptor)
-            jni = cast(java.NewGlobalRef(jni), jclass)
-            if jni.value is None:
-                raise RuntimeError("Unable to create global reference to class.")
-
-            ##################################################################
-            # Determine the alternate types for this class
-            ##################################################################
-
-            # Best option is the type itself
-            alternates = ['L%s;' % descriptor]
-
-            # Next preference is an interfaces
-            java_interfaces = java.CallObjectMethod(jni, reflect.Class__getInterfaces)
-            if java_interfaces.value is None:
-                raise RuntimeError("Couldn't get interfaces for '%s'" % self)
-            java_interfaces = cast(java_interfaces, jobjectArray)
-
-            interface_count = java.GetArrayLength(java_interfaces)
-            for i in range(0, interface_count):
-                java_interface = java.GetObjectArrayElement(java_interfaces, i)
-
-                name = java.CallObjectMethod(java_interface, reflect.Class__getName)
-                name_str = java.GetStringUTFChars(cast(name, jstring), None)
-
-                # print("  %s: adding interface alternate %s" % (self.__dict__['_descriptor'], name_str))
-                alternates.append('L%s;' % name_str.replace('.', '/'))
-
-                java.DeleteLocalRef(name)
-                java.DeleteLocalRef(java_interface)
-            java.DeleteLocalRef(java_interfaces)
-
-            # Then check all the superclasses
-            java_superclass = java.CallObjectMethod(jni, reflect.Class__getSuperclass)
-            while java_superclass.value is not None:
-                name = java.CallObjectMethod(java_superclass, reflect.Class__getName)
-                name_str = java.GetStringUTFChars(cast(name, jstring), None)
-
-                # print("  %s: adding superclass alternate %s" % (self.__dict__['_descriptor'], name_str))
-                alternates.append('L%s;' % name_str.replace('.', '/'))
-
-                java.DeleteLocalRef(name)
-
-                super2 = java.CallObjectMethod(java_superclass, reflect.Class__getSuperclass)
-                java.DeleteLocalRef(java_superclass)
-                java_superclass = super2
-            java.DeleteLocalRef(java_superclass)
+            jni = _global_ref(jni)
 
+            # The rest of the metadata for the class is only retrieved
+            # when it is needed (see _class_metadata()).
             java_class = super(JavaClass, cls).__new__(cls, descriptor.encode('utf-8'), (JavaInstance,), {
                     '_descriptor': descriptor,
                     '_jni': jni,
-                    '_alternates': alternates,
+                    '_metadata': None,
                     '_constructors': None,
+                    '_constructor_resolutions': {},
                     '_members': {
                         'fields': {},
                         'methods': {},
@@ -840,6 +1699,15 @@ class JavaClass(type):
 
         return java_class
 
+    @property
+    def _alternates(self):
+        """The type signatures that can represent an instance of the class.
+
+        In order of preference: the class itself, its interfaces, then its
+        superclasses.
+        """
+        return _class_metadata(self)['alternates']
+
     def __getattr__(self, name):
         # print ("GETATTR %s on JavaClass %s" % (name, self))
         # First, try to find a field match
@@ -864,6 +1732,8 @@ class JavaClass(type):
             self.__dict__['_static']['methods'][name] = method_wrapper
 
         if method_wrapper:
+            if method_wrapper._fast:
+                return method_wrapper._fast
             return method_wrapper
 
         # If that didn't work, try an attribute on the object itself
@@ -897,33 +1767,87 @@ class JavaClass(type):
 ###########################################################################
 
 class JavaProxy(object):
+    """The base class for Python implementations of Java interfaces.
+
+    Each instance is represented in Java by a java.lang.reflect.Proxy,
+    created the first time the instance is passed to Java. The proxy keeps
+    the Python object alive for as long as it is reachable from Java; the
+    Python object only holds a weak reference to the proxy, so neither side
+    leaks once both have finished with it. If Java collects the proxy while
+    the Python object is still in use, a new proxy is created the next time
+    the object is passed to Java.
+    """
+    # A weak global reference to the Java proxy.
+    _weak_jni = None
+    # The dispatch table for callbacks; see _callback_handlers().
+    _handlers = []
+    # If True, callbacks are run on the callback dispatcher thread; see
+    # asynchronous().
+    _asynchronous = False
+    # The maximum size of a batch of calls to a void method, and the
+    # maximum time (in seconds) a call can wait to be delivered; see
+    # batched(). A batch size of 0 disables batching.
+    _batch_size = 0
+    _batch_latency = 0
+
     def __init__(self):
-        # Create a Java-side proxy for this Python-side object
+        pass
+
+    @property
+    def _jni(self):
+        """A new local reference to the Java proxy for this object.
+
+        The caller owns the reference; it must be deleted, or created
+        inside a local_frame().
+        """
+        if self._weak_jni is not None:
+            jni = java.NewLocalRef(self._weak_jni)
+            if jni.value:
+                return jni
+
+        # Create a Java-side proxy for this Python-side object. The proxy
+        # refers to the Python object by a handle, which owns a reference
+        # to the object until the proxy is collected.
         # print("Create new Java Interface instance ", self.__class__)
-        klass = self.__class__._jni
-        jni = java.CallStaticObjectMethod(reflect.Python, reflect.Python__proxy, klass, jlong(id(self)))
+        if _rubicon is None:
+            raise RuntimeError("Java can only invoke Python objects once the Python runtime has been started by Java.")
+        handle = jlong(_rubicon.new_handle(self))
+        configured = self._asynchronous or self._batch_size
+        proxy_class = _proxy_class(self.__class__) if _use_proxy_classes and not configured else None
+        if configured:
+            if self._asynchronous:
+                _start_callback_dispatcher()
+            # Variadic JNI calls receive a jboolean promoted to an int.
+            jni = java.CallStaticObjectMethod(
+                reflect.Python, reflect.Python__configuredProxy,
+                self._interface_jni, handle,
+                jint(1 if self._asynchronous else 0),
+                jint(self._batch_size), jlong(int(self._batch_latency * 1e9))
+            )
+        elif proxy_class:
+            jni = java.NewObject(proxy_class.jni, proxy_class.constructor, handle)
+            if jni.value is not None:
+                java.CallStaticVoidMethod(reflect.Python, reflect.Python__track, jni, handle)
+        else:
+            jni = java.CallStaticObjectMethod(reflect.Python, reflect.Python__proxy, self._interface_jni, handle)
         if jni.value is None:
+            _rubicon.release_handle(handle.value)
             raise RuntimeError("Unable to create proxy instance.")
-        jni = cast(java.NewGlobalRef(jni), jclass)
-        if jni.value is None:
-            raise RuntimeError("Unable to create global reference to proxy instance.")
-        self._jni = jni
-
-        # Register this Python instance with the proxy cache
-        # This is a weak reference because _proxy_cache is a registry,
-        # not an actual user of proxy objects. If all references to the
-        # proxy disappear, the proxy cache should be cleaned to avoid
-        # leaking memory on objects that aren't being used.
-        _proxy_cache[id(self)] = self
-
-        self._as_parameter_ = self._jni
+        weak_jni = java.NewWeakGlobalRef(jni)
+        if weak_jni.value is None:
+            raise RuntimeError("Unable to create weak global reference to proxy instance.")
+        self._weak_jni = WeakGlobalRef(weak_jni.value)
+        return jni
+
+    @property
+    def _as_parameter_(self):
+        # ctypes keeps the parameter alive until the call returns; the
+        # global reference is then deleted, so passing a proxy directly to
+        # a JNI function doesn't leak a local reference.
+        return _global_ref(self._jni)
 
     def __repr__(self):
-        return "<%s: %s>" % (self.__class__.__name__, self._jni.value)
-
-    # def __del__(self):
-    #     # If this object is garbage collected, remove it from the proxy cache.
-    #     del _proxy_cache[id(self)]
+        return "<%s: %s>" % (self.__class__.__name__, self._weak_jni.value if self._weak_jni is not None else None)
 
 
 class JavaInterface(type):
@@ -934,7 +1858,6 @@ class JavaInterface(type):
             java_class = super(JavaInterface, cls).__new__(cls, descriptor.encode('utf-8'), (JavaProxy,), {
                     '_descriptor': descriptor,
                     '_alternates': ['L%s;' % descriptor],
-                    '_methods': {}
                 })
         else:
             name, bases, attrs = args
@@ -942,47 +1865,428 @@ class JavaInterface(type):
             descriptor = bases[-1].__dict__['_descriptor']
             attrs['_descriptor'] = descriptor
             attrs['_alternates'] = ['L%s;' % descriptor]
-            attrs['_methods'] = {}
             java_class = super(JavaInterface, cls).__new__(cls, name, bases, attrs)
 
         jni = java.FindClass(descriptor)
         if jni is None:
             raise UnknownClassException(descriptor)
-        java_class._jni = cast(java.NewGlobalRef(jni), jclass)
-        if java_class._jni.value is None:
+        # The interface is stored as _interface_jni; on instances, _jni is
+        # the Java proxy.
+        java_class._interface_jni = cast(java.NewGlobalRef(jni), jclass)
+        if java_class._interface_jni.value is None:
             raise RuntimeError("Unable to create global reference to interface.")
 
         ##################################################################
-        # Load the methods for the class
+        # Number the methods of the interface, and build the dispatch
+        # table for the class
         ##################################################################
-        methods = java.CallObjectMethod(jni, reflect.Class__getMethods)
-        if methods is None:
-            raise RuntimeError("Couldn't get methods for '%s'" % self)
-        methods = cast(methods, jobjectArray)
-
-        method_count = java.GetArrayLength(methods)
-        for i in range(0, method_count):
-            java_method = java.GetObjectArrayElement(methods, i)
-            modifiers = java.CallIntMethod(java_method, reflect.Method__getModifiers)
-
-            public = java.CallStaticBooleanMethod(reflect.Modifier, reflect.Modifier__isPublic, modifiers)
-            if public:
-                static = java.CallStaticBooleanMethod(reflect.Modifier, reflect.Modifier__isStatic, modifiers)
-                if not static:
-                    name = java.CallObjectMethod(java_method, reflect.Method__getName)
-                    name_str = java.GetStringUTFChars(cast(name, jstring), None)
-
-                    params = java.CallObjectMethod(java_method, reflect.Method__getParameterTypes)
-                    params = cast(params, jobjectArray)
-
-                    # print("  %s: registering interface method %s", (self.__dict__['_descriptor'], name_str))
-                    java_class._methods.setdefault(name_str, set()).add(type_names_for_params(params))
-            #     else:
-            #         print("  %s: ignoring static method" % self.__dict__['_descriptor'])
-            # else:
-            #     print("  %s: ignoring private method" % self.__dict__['_descriptor'])
+        metadata = _describe(descriptor, java_class._interface_jni)
+        for name, polymorphs in metadata['methods'].items():
+            # print("  %s: registering interface method %s", (self.__dict__['_descriptor'], name))
+            for params_signature, return_signature in polymorphs:
+                callback_slot(name, params_signature)
+        java_class._handlers = _callback_handlers(java_class)
 
         return java_class
 
     def __repr__(self):
         return "<JavaInterface: %s>" % self._descriptor
+
+
+###########################################################################
+# Asynchronous callbacks
+#
+# Callbacks to an asynchronous implementation of an interface are queued by
+# Java, and run in order on a single dispatcher thread owned by Python, so
+# Java threads never wait for the GIL, or for a slow Python implementation.
+#
+# Calls to the void methods of a batched implementation are buffered by
+# Java, and delivered to Python in batches.
+###########################################################################
+
+_callback_dispatcher = None
+_callback_dispatcher_lock = threading.Lock()
+
+
+def asynchronous(java_class):
+    """A class decorator that makes a Python implementation of a Java interface asynchronous.
+
+    Calls to void interface methods are queued, and return to Java
+    immediately. Calls to methods that return a CompletableFuture (or a
+    Future or CompletionStage) are also queued; Java receives a future that
+    is completed with the value returned by the Python method. All other
+    methods are invoked synchronously, as Java needs their return value.
+
+    Queued calls are run in the order they were made, on a dedicated
+    thread. Asynchronous implementations are always represented in Java by
+    a java.lang.reflect.Proxy.
+    """
+    java_class._asynchronous = True
+    return java_class
+
+
+def batched(size=256, latency=0.005):
+    """A class decorator that batches calls to the void methods of a Python implementation of a Java interface.
+
+    Calls to void interface methods are buffered by Java, and delivered to
+    Python together; the Python method is invoked once per batch, with a
+    list containing a tuple of the arguments of each call, in the order the
+    calls were made. This amortizes the cost of crossing the bridge (and
+    acquiring the GIL) over many calls, for methods that are called at a
+    high rate.
+
+    A batch is delivered when it holds `size` calls, or when the oldest
+    call in it has waited `latency` seconds. Calls that fill a batch
+    deliver it on the calling thread; other batches are delivered on a Java
+    timer thread. If the class is also asynchronous(), batches are
+    delivered on the callback dispatcher thread instead.
+
+    Methods that return a value are not batched.
+    """
+    if size < 1:
+        raise ValueError("Batch size must be at least 1")
+    if latency <= 0:
+        raise ValueError("Batch latency must be positive")
+
+    def decorator(java_class):
+        java_class._batch_size = size
+        java_class._batch_latency = latency
+        return java_class
+    return decorator
+
+
+def _start_callback_dispatcher():
+    """Start the thread that runs queued callbacks, if it isn't running."""
+    global _callback_dispatcher
+    with _callback_dispatcher_lock:
+        if _callback_dispatcher is None or not _callback_dispatcher.is_alive():
+            java.CallStaticVoidMethod(reflect.PythonInstance, reflect.PythonInstance__resetDispatcher)
+            _callback_dispatcher = threading.Thread(target=_run_callback_dispatcher, name='Rubicon callback dispatcher')
+            _callback_dispatcher.start()
+
+
+def _run_callback_dispatcher():
+    # This only returns once the Python runtime is being stopped. The GIL
+    # is released while waiting; each callback reacquires it.
+    java.CallStaticVoidMethod(reflect.PythonInstance, reflect.PythonInstance__dispatchCallbacks)
+
+
+###########################################################################
+# Generated proxy classes
+#
+# Optionally, Python implementations of Java interfaces are represented in
+# Java by a class generated at runtime, rather than by a
+# java.lang.reflect.Proxy. Each interface method of the generated class is
+# a native method, bound to a ctypes trampoline that dispatches directly
+# to Python; arguments arrive unboxed, with no argument array.
+###########################################################################
+
+# The ctypes type used to pass each primitive type to a native method;
+# all objects are passed as pointers.
+_NATIVE_TYPES = {
+    'Z': jboolean,
+    'B': jbyte,
+    'C': jchar,
+    'S': jshort,
+    'I': jint,
+    'J': jlong,
+    'F': jfloat,
+    'D': jdouble,
+    'V': None,
+}
+
+# The value returned by a native method if the Python implementation fails.
+_NATIVE_DEFAULTS = {
+    'Z': False,
+    'B': 0,
+    'C': 0,
+    'S': 0,
+    'I': 0,
+    'J': 0,
+    'F': 0.0,
+    'D': 0.0,
+}
+
+# A cache of ctypes function prototypes, keyed by JNI method signature.
+_native_prototypes = {}
+
+# The generated proxy class for each interface, keyed by descriptor. The
+# entry is None if a class couldn't be generated for the interface.
+_proxy_classes = {}
+_proxy_class_lock = threading.Lock()
+
+_use_proxy_classes = False
+
+
+def set_proxy_classes(enabled):
+    """Use generated classes to represent Python implementations of Java interfaces.
+
+    When enabled, a class implementing the interface is generated the first
+    time an implementation is passed to Java. Callbacks then reach Python
+    without boxing their arguments, which is significantly faster for
+    interfaces with primitive arguments. Calls to methods inherited from
+    java.lang.Object (such as toString()) are handled by Java, rather than
+    being dispatched to Python.
+
+    Not every VM can define classes at runtime (Android can't); if a class
+    can't be generated, java.lang.reflect.Proxy is used instead.
+    Only affects Java objects created after the setting is changed.
+    """
+    global _use_proxy_classes
+    _use_proxy_classes = enabled
+
+
+def _native_prototype(params_signature, return_signature):
+    """Retrieve the ctypes function prototype for a native method.
+
+    The function receives the JNIEnv and the object (or class) that the
+    method was invoked on, followed by the arguments of the method.
+    """
+    key = (params_signature, return_signature)
+    try:
+        return _native_prototypes[key]
+    except KeyError:
+        pass
+
+    prototype = CFUNCTYPE(
+        _NATIVE_TYPES.get(return_signature, c_void_p),
+        c_void_p,
+        c_void_p,
+        *[_NATIVE_TYPES.get(type_name, c_void_p) for type_name in _split_signature(params_signature)]
+    )
+    _native_prototypes[key] = prototype
+    return prototype
+
+
+def _native_args(args, type_names):
+    """Convert the arguments received by a native method into the values
+    expected by dispatch_cast()."""
+    if 'C' in type_names or 'Z' in type_names:
+        return [
+            unichr(arg) if type_name == 'C' else bool(arg) if type_name == 'Z' else arg
+            for arg, type_name in zip(args, type_names)
+        ]
+    return args
+
+
+def _native_result(value, return_signature):
+    """Convert the value returned by Python into the return value of a native method.
+
+    Objects are returned as new local references; the JVM releases them
+    when the native method returns.
+    """
+    if return_signature == 'V':
+        return None
+    elif return_signature in _NATIVE_DEFAULTS:
+        if value is None:
+            return _NATIVE_DEFAULTS[return_signature]
+        elif return_signature == 'C' and isinstance(value, basestring):
+            return ord(value)
+        return value
+    elif value is None:
+        return None
+    elif isinstance(value, basestring):
+        return java.NewLocalRef(_java_string(value)).value
+    elif isinstance(value, JavaProxy):
+        return value._jni.value
+    elif isinstance(value, (JavaInstance, JavaArray)):
+        return java.NewLocalRef(value._jni).value
+    elif return_signature[0] == '[':
+        return _new_array(return_signature[1], value).value
+    raise TypeError("Can't convert %s object to a Java object" % type(value).__name__)
+
+
+def _native_failure(return_signature):
+    """Report an exception raised by a native method implementation, and
+    return the value the method should return.
+
+    The exception is raised in Java as a RuntimeException once the native
+    method returns.
+    """
+    import traceback
+    traceback.print_exc()
+    exc_type, exc_value = sys.exc_info()[:2]
+    message = '%s: %s' % (exc_type.__name__, exc_value)
+    java.ThrowNew(java.FindClass(b'java/lang/RuntimeException'), message.encode('utf-8'))
+    return _NATIVE_DEFAULTS.get(return_signature)
+
+
+def _native_method(params_signature, return_signature, invoke):
+    """Create a trampoline that implements a Java native method in Python.
+
+    The trampoline is a C function with the signature JNI expects of the
+    native method; ctypes acquires the GIL when it is called. invoke is
+    then called with the object (or class, for static methods) that the
+    method was invoked on, and the list of arguments. Primitive arguments
+    are Python values; all other arguments are raw pointers to Java
+    objects, suitable for dispatch_cast(). The value returned by invoke is
+    converted into the return type of the method.
+
+    The trampoline must be kept alive for as long as it is registered.
+    """
+    type_names = _split_signature(params_signature)
+
+    def trampoline(env, this, *args):
+        try:
+            return _native_result(invoke(this, _native_args(args, type_names)), return_signature)
+        except Exception:
+            return _native_failure(return_signature)
+
+    return _native_prototype(params_signature, return_signature)(trampoline)
+
+
+class _ProxyClass(object):
+    """A Java class generated to represent Python implementations of an interface."""
+    def __init__(self, interface):
+        descriptor = interface._descriptor
+        self.name = 'org/pybee/rubicon/proxy/%s$Python%s' % (descriptor.replace('/', '$'), uuid.uuid4().hex[:8])
+
+        methods = []
+        for name, polymorphs in _describe(descriptor, interface._interface_jni)['methods'].items():
+            for params_signature, return_signature in polymorphs:
+                methods.append((name, params_signature, return_signature))
+
+        data = classfile.proxy_class(
+            self.name,
+            descriptor,
+            [(name, '(%s)%s' % (params_signature, return_signature)) for name, params_signature, return_signature in methods]
+        )
+
+        # Define the class in the same class loader as the interface, so
+        # that the interface can be resolved.
+        loader = java.CallObjectMethod(interface._interface_jni, reflect.Class__getClassLoader)
+        jni = java.DefineClass(self.name.encode('utf-8'), loader, cast(c_char_p(data), jbyte_p), len(data))
+        if loader.value:
+            java.DeleteLocalRef(loader)
+        if jni.value is None:
+            java.ExceptionClear()
+            raise RuntimeError("Unable to define proxy class for %s" % descriptor)
+        self.jni = _global_ref(jni)
+
+        self.constructor = java.GetMethodID(self.jni, b'<init>', b'(J)V')
+        self.instance = java.GetFieldID(self.jni, b'instance', b'J')
+
+        # The trampolines must live as long as the class; they are kept
+        # with the class, which is never released.
+        self.trampolines = [self._trampoline(name, params_signature, return_signature) for name, params_signature, return_signature in methods]
+        natives = (JNINativeMethod * len(methods))()
+        for native, (name, params_signature, return_signature), trampoline in zip(natives, methods, self.trampolines):
+            native.name = name.encode('utf-8')
+            native.signature = ('(%s)%s' % (params_signature, return_signature)).encode('utf-8')
+            native.fnPtr = cast(trampoline, c_void_p)
+        if java.RegisterNatives(self.jni, natives, len(methods)) != 0:
+            java.ExceptionClear()
+            raise RuntimeError("Unable to register native methods for %s" % descriptor)
+
+    def _trampoline(self, name, params_signature, return_signature):
+        slot = callback_slot(name, params_signature)
+        instance_field = self.instance
+
+        def invoke(this, args):
+            return dispatch(_rubicon.resolve_handle(java.GetLongField(jobject(this), instance_field)), slot, args)
+
+        return _native_method(params_signature, return_signature, invoke)
+
+
+# The trampolines for native methods bound with bind_native(), keyed by
+# class descriptor, then by (method name, signature).
+_bound_natives = {}
+
+
+def bind_native(java_class, name, function, signature=None, static=None):
+    """Implement a native method of a Java class with a Python callable.
+
+    Java code can then call the method directly; the call goes straight
+    from Java into Python, with no proxy, reflection or boxing. The
+    function is invoked with the arguments of the method (converted in the
+    same way as callback arguments); if the method is an instance method,
+    the Java object is passed as the first argument. The value returned by
+    the function is converted into the return type of the method. If the
+    function raises an exception, the traceback is printed, and the
+    exception is raised in Java as a RuntimeException.
+
+    :param java_class: The JavaClass declaring the native method.
+    :param name: The name of the native method.
+    :param function: The Python callable implementing the method.
+    :param signature: The JNI signature of the method (e.g., '(II)I').
+        Only required if the method isn't public, or is overloaded.
+    :param static: Whether the method is static. Only required if the
+        method isn't public.
+
+    The method stays bound until unbind_natives() is called, or the Python
+    runtime is stopped; it must not be called by Java after that.
+    """
+    metadata = _class_metadata(java_class)
+    candidates = [
+        ('(%s)%s' % polymorph, is_static)
+        for is_static, methods in ((False, metadata['methods']), (True, metadata['static_methods']))
+        for polymorph in methods.get(name, [])
+    ]
+    if signature is not None:
+        candidates = [candidate for candidate in candidates if candidate[0] == signature] or [(signature, static)]
+    if len(candidates) != 1:
+        raise ValueError("Can't determine which %s.%s() to bind; provide a signature" % (java_class._descriptor, name))
+    signature, is_static = candidates[0]
+    if is_static is None:
+        is_static = bool(static)
+
+    params_signature, return_signature = signature[1:].split(')')
+    type_names = _split_signature(params_signature)
+
+    if is_static:
+        def invoke(this, args):
+            return function(*[dispatch_cast(arg, type_name) for arg, type_name in zip(args, type_names)])
+    else:
+        def invoke(this, args):
+            instance = _java_instance(java_class, jobject(this), local=False)
+            return function(instance, *[dispatch_cast(arg, type_name) for arg, type_name in zip(args, type_names)])
+
+    trampoline = _native_method(params_signature, return_signature, invoke)
+    natives = (JNINativeMethod * 1)()
+    natives[0].name = name.encode('utf-8')
+    natives[0].signature = signature.encode('utf-8')
+    natives[0].fnPtr = cast(trampoline, c_void_p)
+    if java.RegisterNatives(java_class.__dict__['_jni'], natives, 1) != 0:
+        java.ExceptionClear()
+        raise RuntimeError("Unable to bind %s.%s%s" % (java_class._descriptor, name, signature))
+
+    _bound_natives.setdefault(java_class._descriptor, {})[(name, signature)] = trampoline
+
+
+def unbind_natives(java_class):
+    """Unbind all the native methods of a Java class.
+
+    This unbinds every native method of the class, including any that
+    weren't bound with bind_native().
+    """
+    java.UnregisterNatives(java_class.__dict__['_jni'])
+    _bound_natives.pop(java_class._descriptor, None)
+
+
+def _proxy_class(java_class):
+    """Retrieve the generated proxy class for a Python implementation of an interface.
+
+    Returns None if a class can't be generated.
+    """
+    descriptor = java_class._descriptor
+    try:
+        return _proxy_classes[descriptor]
+    except KeyError:
+        pass
+
+    with _proxy_class_lock:
+        if descriptor not in _proxy_classes:
+            try:
+                _proxy_classes[descriptor] = _ProxyClass(java_class)
+            except Exception as e:
+                # print("Unable to generate proxy class; using java.lang.reflect.Proxy", e)
+                _proxy_classes[descriptor] = None
+        return _proxy_classes[descriptor]
+
+
+if os.environ.get('RUBICON_METADATA_CACHE'):
+    set_metadata_cache(os.environ['RUBICON_METADATA_CACHE'])
+
+# Register the hooks used by the native fast path.
+if _rubicon:
+    _rubicon.initialize(select_polymorph, _wrap_object)
@@ -0,0 +1,156 @@
+from __future__ import print_function, absolute_import, division, unicode_literals
+
+import struct
+
+# Access flags
+ACC_PUBLIC = 0x0001
+ACC_FINAL = 0x0010
+ACC_SUPER = 0x0020
+ACC_NATIVE = 0x0100
+
+# Constant pool tags
+CONSTANT_UTF8 = 1
+CONSTANT_CLASS = 7
+CONSTANT_FIELDREF = 9
+CONSTANT_METHODREF = 10
+CONSTANT_NAME_AND_TYPE = 12
+
+# Opcodes
+ALOAD_0 = 0x2a
+LLOAD_1 = 0x1f
+INVOKESPECIAL = 0xb7
+PUTFIELD = 0xb5
+RETURN = 0xb1
+
+
+class ClassFile(object):
+    """A minimal writer for Java class files.
+
+    This only supports what is needed to generate classes at runtime:
+    fields, native methods, and methods with straight-line code (i.e., no
+    branches, so no stack map frames are required). The class file is
+    written in the Java 6 format.
+    """
+    MAJOR_VERSION = 50
+
+    def __init__(self, name, superclass='java/lang/Object', interfaces=(), access=ACC_PUBLIC | ACC_FINAL | ACC_SUPER):
+        self._constants = []
+        self._constant_index = {}
+        self.access = access
+        self.this_class = self.class_ref(name)
+        self.super_class = self.class_ref(superclass)
+        self.interfaces = [self.class_ref(interface) for interface in interfaces]
+        self.fields = []
+        self.methods = []
+
+    def _constant(self, key, data):
+        try:
+            return self._constant_index[key]
+        except KeyError:
+            self._constants.append(data)
+            # Constant pool indices start at 1.
+            index = len(self._constants)
+            self._constant_index[key] = index
+            return index
+
+    def utf8(self, value):
+        # Class, member and type names never contain the characters that
+        # are encoded differently by the JVM's "modified" UTF-8.
+        data = value.encode('utf-8')
+        return self._constant((CONSTANT_UTF8, value), struct.pack('>BH', CONSTANT_UTF8, len(data)) + data)
+
+    def class_ref(self, name):
+        return self._constant((CONSTANT_CLASS, name), struct.pack('>BH', CONSTANT_CLASS, self.utf8(name)))
+
+    def name_and_type(self, name, descriptor):
+        return self._constant(
+            (CONSTANT_NAME_AND_TYPE, name, descriptor),
+            struct.pack('>BHH', CONSTANT_NAME_AND_TYPE, self.utf8(name), self.utf8(descriptor))
+        )
+
+    def field_ref(self, klass, name, descriptor):
+        return self._constant(
+            (CONSTANT_FIELDREF, klass, name, descriptor),
+            struct.pack('>BHH', CONSTANT_FIELDREF, self.class_ref(klass), self.name_and_type(name, descriptor))
+        )
+
+    def method_ref(self, klass, name, descriptor):
+        return self._constant(
+            (CONSTANT_METHODREF, klass, name, descriptor),
+            struct.pack('>BHH', CONSTANT_METHODREF, self.class_ref(klass), self.name_and_type(name, descriptor))
+        )
+
+    def add_field(self, access, name, descriptor):
+        self.fields.append(struct.pack('>HHHH', access, self.utf8(name), self.utf8(descriptor), 0))
+
+    def add_method(self, access, name, descriptor, code=None, max_stack=0, max_locals=0):
+        """Add a method to the class.
+
+        If code is None, the method has no Code attribute (e.g., it is a
+        native method); otherwise, code is the bytecode of the method.
+        """
+        if code is None:
+            self.methods.append(struct.pack('>HHHH', access, self.utf8(name), self.utf8(descriptor), 0))
+        else:
+            # Code attribute: max stack, max locals, the code, no exception
+            # table, and no attributes.
+            attribute = struct.pack('>HHI', max_stack, max_locals, len(code)) + code + struct.pack('>HH', 0, 0)
+            self.methods.append(
+                struct.pack('>HHHH', access, self.utf8(name), self.utf8(descriptor), 1)
+                + struct.pack('>HI', self.utf8('Code'), len(attribute))
+                + attribute
+            )
+
+    def to_bytes(self):
+        # All constants must be in the pool before it is written.
+        parts = [
+            struct.pack('>IHHH', 0xCAFEBABE, 0, self.MAJOR_VERSION, len(self._constants) + 1),
+        ]
+        parts.extend(self._constants)
+        parts.append(struct.pack('>HHHH', self.access, self.this_class, self.super_class, len(self.interfaces)))
+        parts.extend(struct.pack('>H', interface) for interface in self.interfaces)
+        parts.append(struct.pack('>H', len(self.fields)))
+        parts.extend(self.fields)
+        parts.append(struct.pack('>H', len(self.methods)))
+        parts.extend(self.methods)
+        parts.append(struct.pack('>H', 0))
+        return b''.join(parts)
+
+
+def proxy_class(name, interface, methods):
+    """Generate a class that implements a Java interface with native methods.
+
+    The class has a single field, `instance`, which holds the handle of the
+    Python object that the proxy represents; it is set by the constructor,
+    which takes that handle as its only argument. Each interface method is
+    declared as a native method, to be bound using RegisterNatives.
+
+    :param name: The JNI name of the class to generate.
+    :param interface: The JNI name of the interface to implement.
+    :param methods: A list of (name, JNI signature) for the methods of the
+        interface.
+    :return: The bytes of the class file.
+    """
+    classfile = ClassFile(name, interfaces=[interface])
+
+    classfile.add_field(ACC_PUBLIC | ACC_FINAL, 'instance', 'J')
+
+    # public <init>(long instance) {
+    #     super();
+    #     this.instance = instance;
+    # }
+    code = struct.pack(
+        '>BBHBBBHB',
+        ALOAD_0,
+        INVOKESPECIAL, classfile.method_ref('java/lang/Object', '<init>', '()V'),
+        ALOAD_0,
+        LLOAD_1,
+        PUTFIELD, classfile.field_ref(name, 'instance', 'J'),
+        RETURN
+    )
+    classfile.add_method(ACC_PUBLIC, '<init>', '(J)V', code, max_stack=3, max_locals=3)
+
+    for method_name, signature in methods:
+        classfile.add_method(ACC_PUBLIC | ACC_FINAL | ACC_NATIVE, method_name, signature)
+
+    return classfile.to_bytes()
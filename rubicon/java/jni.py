@@ -6,7 +6,8 @@ from .types import *
 
 # If we're on Android, the SO file isn't on the LD_LIBRARY_PATH,
 # so we have to manually specify it using the environment.
-java = cdll.LoadLibrary(os.environ.get('RUBICON_LIBRARY', util.find_library('rubicon')))
+_library_path = os.environ.get('RUBICON_LIBRARY', util.find_library('rubicon'))
+java = cdll.LoadLibrary(_library_path)
 
 JNI_VERSION_1_1 = 0x00010001
 JNI_VERSION_1_2 = 0x00010002
@@ -75,6 +76,8 @@ java.AllocObject.restype = jobject
 java.AllocObject.argtypes = [jclass]
 java.NewObject.restype = jobject
 java.NewObject.argtypes = [jclass, jmethodID]
+java.NewObjectA.restype = jobject
+java.NewObjectA.argtypes = [jclass, jmethodID, jvalue_p]
 
 java.GetObjectClass.restype = jclass
 java.GetObjectClass.argtypes = [jobject]
@@ -105,6 +108,27 @@ java.CallDoubleMethod.argtypes = [jobject, jmethodID]
 java.CallVoidMethod.restype = None
 java.CallVoidMethod.argtypes = [jobject, jmethodID]
 
+java.CallObjectMethodA.restype = jobject
+java.CallObjectMethodA.argtypes = [jobject, jmethodID, jvalue_p]
+java.CallBooleanMethodA.restype = jboolean
+java.CallBooleanMethodA.argtypes = [jobject, jmethodID, jvalue_p]
+java.CallByteMethodA.restype = jbyte
+java.CallByteMethodA.argtypes = [jobject, jmethodID, jvalue_p]
+java.CallCharMethodA.restype = jchar
+java.CallCharMethodA.argtypes = [jobject, jmethodID, jvalue_p]
+java.CallShortMethodA.restype = jshort
+java.CallShortMethodA.argtypes = [jobject, jmethodID, jvalue_p]
+java.CallIntMethodA.restype = jint
+java.CallIntMethodA.argtypes = [jobject, jmethodID, jvalue_p]
+java.CallLongMethodA.restype = jlong
+java.CallLongMethodA.argtypes = [jobject, jmethodID, jvalue_p]
+java.CallFloatMethodA.restype = jfloat
+java.CallFloatMethodA.argtypes = [jobject, jmethodID, jvalue_p]
+java.CallDoubleMethodA.restype = jdouble
+java.CallDoubleMethodA.argtypes = [jobject, jmethodID, jvalue_p]
+java.CallVoidMethodA.restype = None
+java.CallVoidMethodA.argtypes = [jobject, jmethodID, jvalue_p]
+
 java.CallNonvirtualObjectMethod.restype = jobject
 java.CallNonvirtualObjectMethod.argtypes = [jobject, jclass, jmethodID]
 java.CallNonvirtualBooleanMethod.restype = jboolean
@@ -126,6 +150,27 @@ java.CallNonvirtualDoubleMethod.argtypes = [jobject, jclass, jmethodID]
 java.CallNonvirtualVoidMethod.restype = None
 java.CallNonvirtualVoidMethod.argtypes = [jobject, jclass, jmethodID]
 
+java.CallNonvirtualObjectMethodA.restype = jobject
+java.CallNonvirtualObjectMethodA.argtypes = [jobject, jclass, jmethodID, jvalue_p]
+java.CallNonvirtualBooleanMethodA.restype = jboolean
+java.CallNonvirtualBooleanMethodA.argtypes = [jobject, jclass, jmethodID, jvalue_p]
+java.CallNonvirtualByteMethodA.restype = jbyte
+java.CallNonvirtualByteMethodA.argtypes = [jobject, jclass, jmethodID, jvalue_p]
+java.CallNonvirtualCharMethodA.restype = jchar
+java.CallNonvirtualCharMethodA.argtypes = [jobject, jclass, jmethodID, jvalue_p]
+java.CallNonvirtualShortMethodA.restype = jshort
+java.CallNonvirtualShortMethodA.argtypes = [jobject, jclass, jmethodID, jvalue_p]
+java.CallNonvirtualIntMethodA.restype = jint
+java.CallNonvirtualIntMethodA.argtypes = [jobject, jclass, jmethodID, jvalue_p]
+java.CallNonvirtualLongMethodA.restype = jlong
+java.CallNonvirtualLongMethodA.argtypes = [jobject, jclass, jmethodID, jvalue_p]
+java.CallNonvirtualFloatMethodA.restype = jfloat
+java.CallNonvirtualFloatMethodA.argtypes = [jobject, jclass, jmethodID, jvalue_p]
+java.CallNonvirtualDoubleMethodA.restype = jdouble
+java.CallNonvirtualDoubleMethodA.argtypes = [jobject, jclass, jmethodID, jvalue_p]
+java.CallNonvirtualVoidMethodA.restype = None
+java.CallNonvirtualVoidMethodA.argtypes = [jobject, jclass, jmethodID, jvalue_p]
+
 java.GetFieldID.restype = jfieldID
 java.GetFieldID.argtypes = [jclass, c_char_p, c_char_p]
 
@@ -191,6 +236,27 @@ java.CallStaticDoubleMethod.argtypes = [jclass, jmethodID]
 java.CallStaticVoidMethod.restype = None
 java.CallStaticVoidMethod.argtypes = [jclass, jmethodID]
 
+java.CallStaticObjectMethodA.restype = jobject
+java.CallStaticObjectMethodA.argtypes = [jclass, jmethodID, jvalue_p]
+java.CallStaticBooleanMethodA.restype = jboolean
+java.CallStaticBooleanMethodA.argtypes = [jclass, jmethodID, jvalue_p]
+java.CallStaticByteMethodA.restype = jbyte
+java.CallStaticByteMethodA.argtypes = [jclass, jmethodID, jvalue_p]
+java.CallStaticCharMethodA.restype = jchar
+java.CallStaticCharMethodA.argtypes = [jclass, jmethodID, jvalue_p]
+java.CallStaticShortMethodA.restype = jshort
+java.CallStaticShortMethodA.argtypes = [jclass, jmethodID, jvalue_p]
+java.CallStaticIntMethodA.restype = jint
+java.CallStaticIntMethodA.argtypes = [jclass, jmethodID, jvalue_p]
+java.CallStaticLongMethodA.restype = jlong
+java.CallStaticLongMethodA.argtypes = [jclass, jmethodID, jvalue_p]
+java.CallStaticFloatMethodA.restype = jfloat
+java.CallStaticFloatMethodA.argtypes = [jclass, jmethodID, jvalue_p]
+java.CallStaticDoubleMethodA.restype = jdouble
+java.CallStaticDoubleMethodA.argtypes = [jclass, jmethodID, jvalue_p]
+java.CallStaticVoidMethodA.restype = None
+java.CallStaticVoidMethodA.argtypes = [jclass, jmethodID, jvalue_p]
+
 java.GetStaticFieldID.restype = jfieldID
 java.GetStaticFieldID.argtypes = [jclass, c_char_p, c_char_p]
 
@@ -391,6 +457,82 @@ java.GetObjectRefType.restype = c_int
 java.GetObjectRefType.argtypes = [jobject]
 
 
+# GIL policy
+#
+# ctypes releases the GIL around every call to a function in `java`. That is
+# only worthwhile for calls that can block - that is, calls that can run
+# arbitrary Java code (method invocations, object construction, and class
+# lookup and initialization). Releasing and reacquiring the GIL for a trivial
+# call such as GetArrayLength just causes contention with other threads.
+#
+# Under the default 'blocking' policy, the JNI functions listed below are
+# bound so that the GIL is held while they run, and Java methods can be
+# declared non-blocking (see rubicon.java.set_blocking()). Under the 'always'
+# policy, the GIL is released for every call. The policy is selected with
+# the RUBICON_GIL_POLICY environment variable.
+
+GIL_RELEASE_ALWAYS = 'always'
+GIL_RELEASE_BLOCKING = 'blocking'
+
+gil_policy = os.environ.get('RUBICON_GIL_POLICY', GIL_RELEASE_BLOCKING)
+if gil_policy not in (GIL_RELEASE_ALWAYS, GIL_RELEASE_BLOCKING):
+    raise ValueError("Unknown RUBICON_GIL_POLICY '%s'" % gil_policy)
+
+# JNI functions that don't run Java code, and don't wait for other threads.
+# Static field accessors are excluded, as they can trigger the
+# initialization of the class, as is NewDirectByteBuffer, which runs the
+# constructor of the buffer.
+NON_BLOCKING = [
+    'GetVersion',
+    'FromReflectedMethod', 'FromReflectedField',
+    'GetSuperclass', 'IsAssignableFrom', 'GetObjectClass', 'IsInstanceOf',
+    'ExceptionOccurred', 'ExceptionClear', 'ExceptionCheck',
+    'PushLocalFrame', 'PopLocalFrame', 'EnsureLocalCapacity',
+    'NewGlobalRef', 'DeleteGlobalRef', 'NewLocalRef', 'DeleteLocalRef',
+    'NewWeakGlobalRef', 'DeleteWeakGlobalRef', 'IsSameObject', 'GetObjectRefType',
+] + [
+    '%s%sField' % (access, type_name)
+    for access in ('Get', 'Set')
+    for type_name in ('Object', 'Boolean', 'Byte', 'Char', 'Short', 'Int', 'Long', 'Float', 'Double')
+] + [
+    'NewString', 'GetStringLength', 'GetStringRegion',
+    'NewStringUTF', 'GetStringUTFLength', 'GetStringUTFRegion',
+    'GetArrayLength', 'GetObjectArrayElement', 'SetObjectArrayElement',
+] + [
+    '%s%sArray%s' % (access, type_name, suffix)
+    for type_name in ('Boolean', 'Byte', 'Char', 'Short', 'Int', 'Long', 'Float', 'Double')
+    for access, suffix in (('New', ''), ('Get', 'Region'), ('Set', 'Region'))
+] + [
+    'GetDirectBufferAddress', 'GetDirectBufferCapacity',
+]
+
+# The library, bound so that the GIL is held for the duration of each call.
+_java_held = PyDLL(_library_path)
+_held_functions = {}
+
+
+def held(name):
+    """Retrieve a version of a JNI function that holds the GIL while it runs.
+
+    This must only be used for calls that can't block, or wait for a thread
+    that might need the GIL.
+    """
+    try:
+        return _held_functions[name]
+    except KeyError:
+        released = getattr(java, name)
+        function = getattr(_java_held, name)
+        function.restype = released.restype
+        function.argtypes = released.argtypes
+        _held_functions[name] = function
+        return function
+
+
+if gil_policy == GIL_RELEASE_BLOCKING:
+    for _name in NON_BLOCKING:
+        setattr(java, _name, held(_name))
+
+
 
 
 class _ReflectionAPI(object):
@@ -404,6 +546,7 @@ class _ReflectionAPI(object):
             'Class__getMethods': ('GetMethodID', 'Class', 'getMethods', '()[Ljava/lang/reflect/Method;'),
             'Class__getInterfaces': ('GetMethodID', 'Class', 'getInterfaces', '()[Ljava/lang/Class;'),
             'Class__getSuperclass': ('GetMethodID', 'Class', 'getSuperclass', '()Ljava/lang/Class;'),
+            'Class__getClassLoader': ('GetMethodID', 'Class', 'getClassLoader', '()Ljava/lang/ClassLoader;'),
 
             'Constructor': ('FindClass', 'java/lang/reflect/Constructor'),
             'Constructor__getParameterTypes': ('GetMethodID', 'Constructor', 'getParameterTypes', '()[Ljava/lang/Class;'),
@@ -422,10 +565,24 @@ class _ReflectionAPI(object):
             'Modifier__isStatic': ('GetStaticMethodID', 'Modifier', 'isStatic', '(I)Z'),
             'Modifier__isPublic': ('GetStaticMethodID', 'Modifier', 'isPublic', '(I)Z'),
 
+            'Throwable': ('FindClass', 'java/lang/Throwable'),
+            'Throwable__toString': ('GetMethodID', 'Throwable', 'toString', '()Ljava/lang/String;'),
+
+            'System': ('FindClass', 'java/lang/System'),
+            'System__identityHashCode': ('GetStaticMethodID', 'System', 'identityHashCode', '(Ljava/lang/Object;)I'),
+
             'Python': ('FindClass', 'org/pybee/rubicon/Python'),
             'Python__proxy': ('GetStaticMethodID', 'Python', 'proxy', '(Ljava/lang/Class;J)Ljava/lang/Object;'),
+            'Python__track': ('GetStaticMethodID', 'Python', 'track', '(Ljava/lang/Object;J)V'),
+            'Python__configuredProxy': ('GetStaticMethodID', 'Python', 'proxy', '(Ljava/lang/Class;JZIJ)Ljava/lang/Object;'),
+
+            'PythonInstance': ('FindClass', 'org/pybee/rubicon/PythonInstance'),
+            'PythonInstance__dispatchCallbacks': ('GetStaticMethodID', 'PythonInstance', 'dispatchCallbacks', '()V'),
+            'PythonInstance__resetDispatcher': ('GetStaticMethodID', 'PythonInstance', 'resetDispatcher', '()V'),
             'Python__getField': ('GetStaticMethodID', 'Python', 'getField', '(Ljava/lang/Class;Ljava/lang/String;Z)Ljava/lang/reflect/Field;'),
             'Python__getMethods': ('GetStaticMethodID', 'Python', 'getMethods', '(Ljava/lang/Class;Ljava/lang/String;Z)[Ljava/lang/reflect/Method;'),
+            'Python__describe': ('GetStaticMethodID', 'Python', 'describe', '(Ljava/lang/Class;)Ljava/lang/String;'),
+            'Python__version': ('GetStaticMethodID', 'Python', 'version', '(Ljava/lang/Class;)Ljava/lang/String;'),
 
             'Boolean': ('FindClass', 'java/lang/Boolean'),
             'Boolean__booleanValue': ('GetMethodID', 'Boolean', 'booleanValue', '()Z'),
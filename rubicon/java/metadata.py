@@ -0,0 +1,170 @@
+from __future__ import print_function, absolute_import, division, unicode_literals
+
+import mmap
+import os
+import threading
+
+
+class MetadataCache(object):
+    """A persistent cache of Java class descriptions.
+
+    Class descriptions (as produced by Python.describe()) are stored in a
+    file, so that later runs don't need to use reflection to discover the
+    API of a class. Each description is stored with the name of the class,
+    and an identifier for the version of the class (as produced by
+    Python.version()); a description is only used if the version of the
+    class hasn't changed.
+
+    The file is memory mapped when the cache is opened, and descriptions
+    are only decoded when they are needed. New descriptions are appended
+    to the file as they are discovered, each with a single write to a file
+    opened for appending, so that processes sharing the file don't
+    interleave their records. If a class is described more than once, the
+    latest description wins; the file is compacted when it is next opened
+    if it contains more superseded descriptions than current ones, or if
+    it ends with a record that was only partially written.
+
+    The cache is an optimization; any problem reading or writing the file
+    causes the cache to be ignored, rather than raising an error.
+    """
+    # The header of the file. If the format of the file changes, this
+    # must be changed.
+    MAGIC = b'RUBICON METADATA 2\n'
+
+    def __init__(self, path):
+        self.path = path
+        self._lock = threading.Lock()
+        self._mmap = None
+        self._fd = None
+        self._valid = False
+        # True if the file contains data after the last complete record.
+        self._torn = False
+
+        # A dictionary of class name: (version, description), where the
+        # description is either a string, or the (offset, length) of the
+        # encoded description in the memory mapped file.
+        self._entries = {}
+        # The number of descriptions in the file that have been superseded.
+        self._superseded = 0
+
+        try:
+            self._load()
+            if self._torn or self._superseded > len(self._entries):
+                self._compact()
+        except (IOError, OSError, ValueError):
+            self._entries = {}
+            self._superseded = 0
+            self._valid = False
+
+    def _load(self):
+        try:
+            with open(self.path, 'rb') as f:
+                size = os.fstat(f.fileno()).st_size
+                if size < len(self.MAGIC):
+                    return
+                self._mmap = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        except (IOError, OSError):
+            return
+
+        if self._mmap[:len(self.MAGIC)] != self.MAGIC:
+            # A file from an incompatible version; it will be replaced.
+            return
+        self._valid = True
+
+        # Each record is a header line of "name<TAB>version<TAB>length",
+        # followed by length bytes of UTF-8 encoded description.
+        pos = len(self.MAGIC)
+        while pos < size:
+            end = self._mmap.find(b'\n', pos)
+            if end < 0:
+                break
+            try:
+                name, version, length = self._mmap[pos:end].decode('utf-8').split('\t')
+                length = int(length)
+            except ValueError:
+                break
+            start = end + 1
+            if start + length > size:
+                # A record that was only partially written.
+                break
+            if name in self._entries:
+                self._superseded += 1
+            self._entries[name] = (version, (start, length))
+            pos = start + length
+
+        # Anything after the last complete record can't be read, and would
+        # hide any record appended after it.
+        self._torn = pos < size
+
+    def _record(self, name, version, description):
+        data = description.encode('utf-8')
+        return ('%s\t%s\t%d\n' % (name, version, len(data))).encode('utf-8') + data
+
+    def _compact(self):
+        """Rewrite the file, keeping only the current descriptions."""
+        temp_path = '%s.%d.tmp' % (self.path, os.getpid())
+        with open(temp_path, 'wb') as f:
+            f.write(self.MAGIC)
+            for name, (version, description) in self._entries.items():
+                f.write(self._record(name, version, self._decode(description)))
+        os.rename(temp_path, self.path)
+
+        self._mmap.close()
+        self._mmap = None
+        self._entries = {}
+        self._superseded = 0
+        self._torn = False
+        self._load()
+
+    def _decode(self, description):
+        if isinstance(description, tuple):
+            start, length = description
+            return self._mmap[start:start + length].decode('utf-8')
+        return description
+
+    def get(self, name, version):
+        """Retrieve the description of a class.
+
+        Returns None if the class isn't in the cache, or if the cached
+        description is for a different version of the class.
+        """
+        try:
+            cached_version, description = self._entries[name]
+        except KeyError:
+            return None
+        if cached_version != version:
+            return None
+        return self._decode(description)
+
+    def put(self, name, version, description):
+        """Store the description of a class in the cache."""
+        if '\t' in name or '\n' in name or '\t' in version or '\n' in version:
+            return
+
+        with self._lock:
+            if name in self._entries:
+                self._superseded += 1
+            self._entries[name] = (version, description)
+
+            try:
+                if self._fd is None:
+                    if self._valid:
+                        self._fd = os.open(self.path, os.O_WRONLY | os.O_APPEND)
+                    else:
+                        self._fd = os.open(self.path, os.O_WRONLY | os.O_APPEND | os.O_CREAT | os.O_TRUNC, 0o666)
+                        os.write(self._fd, self.MAGIC)
+                        self._valid = True
+                os.write(self._fd, self._record(name, version, description))
+            except (IOError, OSError):
+                # The file can't be written; continue as an in-memory cache.
+                pass
+
+    def close(self):
+        with self._lock:
+            if self._fd is not None:
+                os.close(self._fd)
+                self._fd = None
+            if self._mmap is not None:
+                self._mmap.close()
+                self._mmap = None
+            self._entries = {}
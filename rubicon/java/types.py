@@ -7,13 +7,13 @@ __all__ = [
     'jobject', 'jmethodID', 'jfieldID',
     'jclass', 'jthrowable', 'jstring', 'jarray',
     'jbooleanArray', 'jbyteArray', 'jcharArray', 'jshortArray', 'jintArray', 'jlongArray', 'jfloatArray', 'jdoubleArray', 'jobjectArray',
-    'jweak', 'JNINativeMethod', 'JNINativeMethod_p',
+    'jweak', 'jvalue', 'jvalue_p', 'JNINativeMethod', 'JNINativeMethod_p',
     'JavaVM', 'JavaVM_p', 'JNIEnv',
 ]
 
 jboolean = c_bool
 jbyte = c_byte
-jchar = c_wchar
+jchar = c_uint16
 jshort = c_short
 jint = c_int
 jlong = c_longlong
@@ -85,6 +85,20 @@ class jobjectArray(jarray):
 class jweak(jobject):
     pass
 
+class jvalue(Union):
+    _fields_ = [
+        ("z", jboolean),
+        ("b", jbyte),
+        ("c", jchar),
+        ("s", jshort),
+        ("i", jint),
+        ("j", jlong),
+        ("f", jfloat),
+        ("d", jdouble),
+        ("l", jobject),
+    ]
+jvalue_p = POINTER(jvalue)
+
 class JNINativeMethod(Structure):
      _fields_ = [
         ("name", c_char_p),
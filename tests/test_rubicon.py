@@ -1,10 +1,20 @@
 # -*- coding: utf-8 -*-
 from __future__ import print_function, division, unicode_literals
 
+import array
 import math
+import os
+import tempfile
+import threading
+import time
+import weakref
+from ctypes import c_double, c_int
 from unittest import TestCase
 
-from rubicon.java import JavaClass, JavaInterface
+from rubicon.java import JavaArray, JavaClass, JavaInterface, asynchronous, batched, bind_native, buffer_view, callback_slot, direct_buffer, local_frame, set_identity_map, set_metadata_cache, set_blocking, set_proxy_classes, set_string_cache_size, unbind_natives
+from rubicon.java.jni import GIL_RELEASE_ALWAYS, gil_policy, java
+from rubicon.java.metadata import MetadataCache
+from rubicon.java.types import jlong
 
 
 class JNITest(TestCase):
@@ -209,6 +219,12 @@ class JNITest(TestCase):
         self.assertEqual(obj1.doubler(42), 84)
         self.assertEqual(obj1.doubler("wibble"), "wibblewibble")
 
+        # Resolution is remembered per argument type; alternating
+        # argument types still invokes the right method.
+        self.assertEqual(obj1.doubler(21), 42)
+        self.assertEqual(obj1.doubler(b"wobble"), "wobblewobble")
+        self.assertEqual(obj1.doubler(jlong(2 ** 40)), 2 ** 41)
+
         # If arguments don't match available options, an error is raised
         with self.assertRaises(ValueError):
             obj1.doubler(1.234)
@@ -224,6 +240,88 @@ class JNITest(TestCase):
         with self.assertRaises(ValueError):
             Example.tripler(1.234)
 
+    def test_primitive_arrays(self):
+        "Python buffers can be passed as Java arrays, and Java arrays can be viewed as buffers"
+        Example = JavaClass('org/pybee/rubicon/test/Example')
+
+        obj = Example()
+
+        # Any buffer of a suitable type can be passed as an array argument.
+        self.assertEqual(obj.sum(array.array(b'i', [1, 2, 3, 4])), 10)
+
+        result = obj.scaled(array.array(b'd', [1.5, 2.5]), 2.0)
+        self.assertEqual(len(result), 2)
+        self.assertEqual(result[0], 3.0)
+        self.assertEqual(result[-1], 5.0)
+        with self.assertRaises(IndexError):
+            result[2]
+
+        # The content of a Java array can be accessed as a buffer...
+        with result.view() as view:
+            self.assertEqual(len(view), 2)
+            self.assertEqual(array.array(b'd', memoryview(view).tobytes()).tolist(), [3.0, 5.0])
+
+            # ... and modified in place.
+            (c_double * len(view)).from_buffer(view)[0] = 7.0
+        self.assertEqual(result[0], 7.0)
+
+        # A released view can't be used.
+        self.assertTrue(view.released)
+        with self.assertRaises(ValueError):
+            memoryview(view)
+
+        # Changes to a read only view are discarded.
+        values = JavaArray.from_buffer(array.array(b'i', [1, 2, 3]))
+        with values.view(readonly=True) as view:
+            with self.assertRaises(TypeError):
+                (c_int * len(view)).from_buffer(view)
+
+        # Java changes to an array are visible through a view.
+        Example.increment(values)
+        with values.view() as view:
+            self.assertEqual(array.array(b'i', memoryview(view).tobytes()).tolist(), [2, 3, 4])
+
+        # The content of an array can be copied into a buffer.
+        snapshot = array.array(b'i', [0, 0, 0])
+        values.copy_into(snapshot)
+        self.assertEqual(snapshot.tolist(), [2, 3, 4])
+        with self.assertRaises(ValueError):
+            values.copy_into(array.array(b'i', [0, 0]))
+
+    def test_direct_buffers(self):
+        "Memory can be shared between Python buffers and Java direct ByteBuffers"
+        Example = JavaClass('org/pybee/rubicon/test/Example')
+
+        # A direct ByteBuffer can be accessed from Python without copying.
+        buf = Example.allocate_buffer(4)
+        view = buffer_view(buf)
+        self.assertEqual(len(view), 4)
+        self.assertEqual(bytearray(view), bytearray([0, 1, 2, 3]))
+
+        memoryview(view)[0] = b'\x0a'
+        self.assertEqual(Example.sum_buffer(buf), 16)
+
+        # Python memory can be shared with Java.
+        data = bytearray(4)
+        shared = direct_buffer(data)
+        Example.fill_buffer(shared, 5)
+        self.assertEqual(data, bytearray([5, 5, 5, 5]))
+
+        # Read only Python buffers are shared as read only ByteBuffers.
+        self.assertTrue(direct_buffer(b'abcd').isReadOnly())
+
+        # The Python object is released once Java has collected the buffer.
+        data = array.array(b'b', [1, 2, 3, 4])
+        data_ref = weakref.ref(data)
+        shared = direct_buffer(data)
+        del data, shared
+        for attempt in range(50):
+            Example.collect()
+            if data_ref() is None:
+                break
+            time.sleep(0.1)
+        self.assertIsNone(data_ref())
+
     def test_static_access_non_static(self):
         "An instance field/method cannot be accessed from the static context"
         Example = JavaClass('org/pybee/rubicon/test/Example')
@@ -252,6 +350,30 @@ class JNITest(TestCase):
         example = Example()
         self.assertEqual(example.duplicate_string("Wagga"), "WaggaWagga")
 
+    def test_string_content(self):
+        "Strings are converted without loss, whatever their content or length."
+        Example = JavaClass('org/pybee/rubicon/test/Example')
+        example = Example()
+
+        # Non-ASCII, non-BMP and embedded null characters
+        self.assertEqual(example.duplicate_string("Wägga\U0001F40D\0"), "Wägga\U0001F40D\0Wägga\U0001F40D\0")
+
+        # Byte strings are interpreted as UTF-8
+        self.assertEqual(example.duplicate_string("Wägga".encode('utf-8')), "WäggaWägga")
+
+        # Long strings
+        self.assertEqual(example.duplicate_string("Wagga" * 1000), "Wagga" * 2000)
+
+        # Repeated strings are served from the string cache; the cache
+        # can be disabled.
+        for i in range(3):
+            self.assertEqual(example.duplicate_string("Wagga"), "WaggaWagga")
+        set_string_cache_size(0)
+        try:
+            self.assertEqual(example.duplicate_string("Wagga"), "WaggaWagga")
+        finally:
+            set_string_cache_size(512)
+
     def test_string_return(self):
         "If a method or field returns a string, you get a Python string back"
         Example = JavaClass('org/pybee/rubicon/test/Example')
@@ -294,6 +416,113 @@ class JNITest(TestCase):
         the_thing = example.get_thing()
         self.assertEqual(the_thing.toString(), "This is thing 2")
 
+    def test_bridge_methods(self):
+        "Covariant bridge methods don't hide the methods they bridge to."
+        StringBuilder = JavaClass('java/lang/StringBuilder')
+        builder = StringBuilder('Wagga')
+
+        # StringBuilder.append() returns a StringBuilder; the bridges that
+        # return AbstractStringBuilder and Appendable are ignored.
+        result = builder.append(' Wagga')
+        self.assertEqual(type(result).__dict__['_descriptor'], 'java/lang/StringBuilder')
+        self.assertEqual(result.toString(), 'Wagga Wagga')
+
+    def test_metadata_cache(self):
+        "Class descriptions can be cached between runs."
+        path = os.path.join(tempfile.mkdtemp(), 'metadata.cache')
+        set_metadata_cache(path)
+        try:
+            StringBuilder = JavaClass('java/lang/StringBuilder')
+            builder = StringBuilder('Wagga')
+            builder.append(' Wagga')
+            self.assertEqual(builder.toString(), 'Wagga Wagga')
+        finally:
+            set_metadata_cache(None)
+
+        # The description has been stored, and can be retrieved.
+        cache = MetadataCache(path)
+        try:
+            self.assertIn('java/lang/StringBuilder', cache._entries)
+            version, description = cache._entries['java/lang/StringBuilder']
+            self.assertIn('A Ljava/lang/StringBuilder;', cache.get('java/lang/StringBuilder', version))
+            self.assertIsNone(cache.get('java/lang/StringBuilder', 'some other version'))
+        finally:
+            cache.close()
+            os.remove(path)
+
+    def test_metadata_cache_torn_record(self):
+        "A partially written record doesn't hide records appended after it."
+        path = os.path.join(tempfile.mkdtemp(), 'metadata.cache')
+        cache = MetadataCache(path)
+        cache.put('com/example/First', 'v1', 'first')
+        cache.close()
+
+        # Simulate a writer that died part way through a record.
+        with open(path, 'ab') as f:
+            f.write(b'com/example/Torn\tv1\t100\npartial')
+
+        cache = MetadataCache(path)
+        try:
+            self.assertEqual(cache.get('com/example/First', 'v1'), 'first')
+            self.assertIsNone(cache.get('com/example/Torn', 'v1'))
+            cache.put('com/example/Second', 'v1', 'second')
+        finally:
+            cache.close()
+
+        cache = MetadataCache(path)
+        try:
+            self.assertEqual(cache.get('com/example/First', 'v1'), 'first')
+            self.assertEqual(cache.get('com/example/Second', 'v1'), 'second')
+        finally:
+            cache.close()
+            os.remove(path)
+
+    def test_identity_map(self):
+        "If enabled, a Java object is represented by a single Python object."
+        Example = JavaClass('org/pybee/rubicon/test/Example')
+        example = Example()
+
+        Thing = JavaClass('org/pybee/rubicon/test/Thing')
+
+        # Without the identity map, every return creates a new wrapper.
+        example.set_thing(Thing('This is thing', 2))
+        self.assertIsNot(example.get_thing(), example.get_thing())
+
+        set_identity_map(True)
+        try:
+            thing = Thing('This is thing', 3)
+            example.set_thing(thing)
+
+            self.assertIs(example.get_thing(), thing)
+            self.assertIs(example.get_thing(), example.get_thing())
+
+            # Distinct Java objects have distinct wrappers.
+            example.set_thing(Thing('This is thing', 4))
+            self.assertIsNot(example.get_thing(), thing)
+            self.assertEqual(example.get_thing().toString(), "This is thing 4")
+        finally:
+            set_identity_map(False)
+
+    def test_local_references(self):
+        "Objects returned by Java outlive the invocation that returned them."
+        Example = JavaClass('org/pybee/rubicon/test/Example')
+        example = Example()
+
+        Thing = JavaClass('org/pybee/rubicon/test/Thing')
+        example.set_thing(Thing('This is thing', 2))
+
+        # Enough invocations to exhaust the local reference table, if
+        # local references weren't being released.
+        things = [example.get_thing() for i in range(100000)]
+        self.assertEqual(things[0].toString(), "This is thing 2")
+        self.assertEqual(things[-1].toString(), "This is thing 2")
+
+        # Raw JNI work can be scoped explicitly.
+        with local_frame(4):
+            local = java.NewLocalRef(example._jni)
+            self.assertTrue(java.IsSameObject(local, example._jni))
+        self.assertEqual(example.toString(), "This is a Java Example object")
+
     def test_interface(self):
         "An Java interface can be defined in Python and proxied."
         ICallback = JavaInterface('org/pybee/rubicon/test/ICallback')
@@ -334,12 +563,545 @@ class JNITest(TestCase):
         self.assertEqual(results['string'], 'This is a Java Example object')
         self.assertEqual(results['int'], 47)
 
+    def test_interface_lifetime(self):
+        "A Python implementation of an interface lives as long as Java uses it."
+        ICallback = JavaInterface('org/pybee/rubicon/test/ICallback')
+
+        results = {}
+
+        class MyInterface(ICallback):
+            def poke(self, example, value):
+                results['int'] = value
+
+            def peek(self, example, value):
+                results['int'] = value * 2
+
+        handler = MyInterface()
+        handler_ref = weakref.ref(handler)
+
+        Example = JavaClass('org/pybee/rubicon/test/Example')
+        example = Example()
+        example.set_callback(handler)
+
+        # Java keeps the Python object alive...
+        del handler
+        self.assertIsNotNone(handler_ref())
+
+        # ... and can still invoke it.
+        example.test_peek(21)
+        self.assertEqual(results['int'], 42)
+
+    def test_interface_dispatch_slots(self):
+        "Callbacks are dispatched through a per-class table of interface methods."
+        ICallback = JavaInterface('org/pybee/rubicon/test/ICallback')
+
+        results = {}
+
+        class MyInterface(ICallback):
+            def poke(self, example, value):
+                results['poke'] = value
+
+            def peek(self, example, value):
+                results['peek'] = value
+
+        class MySubInterface(MyInterface):
+            def peek(self, example, value):
+                results['peek'] = value * 2
+
+        # Each interface method has a slot, which can be found from the
+        # full JNI signature of the method.
+        poke_slot = callback_slot('poke', 'Lorg/pybee/rubicon/test/Example;I')
+        peek_slot = callback_slot('peek', 'Lorg/pybee/rubicon/test/Example;I')
+        self.assertNotEqual(poke_slot, peek_slot)
+        self.assertEqual(callback_slot('poke', '(Lorg/pybee/rubicon/test/Example;I)V'), poke_slot)
+
+        # The dispatch table resolves inherited and overridden methods.
+        self.assertIs(MySubInterface._handlers[poke_slot][0], MyInterface.__dict__['poke'])
+        self.assertIs(MySubInterface._handlers[peek_slot][0], MySubInterface.__dict__['peek'])
+
+        Example = JavaClass('org/pybee/rubicon/test/Example')
+        example = Example()
+        handler = MySubInterface()
+        example.set_callback(handler)
+
+        example.test_poke(37)
+        example.test_peek(21)
+        self.assertEqual(results, {'poke': 37, 'peek': 42})
+
+    def test_proxy_parameter_references(self):
+        "Passing a proxy to a JNI function doesn't leak a local reference."
+        ICallback = JavaInterface('org/pybee/rubicon/test/ICallback')
+
+        class MyCallback(ICallback):
+            pass
+
+        callback = MyCallback()
+        with local_frame():
+            Proxy = java.FindClass(b'java/lang/reflect/Proxy')
+            self.assertTrue(java.IsInstanceOf(callback, Proxy))
+
+        # The parameter is a global reference, deleted once the call returns.
+        JNIGlobalRefType = 2
+        self.assertEqual(java.GetObjectRefType(callback._as_parameter_), JNIGlobalRefType)
+
+    def test_proxy_handles(self):
+        "Java refers to Python objects by generation-tagged handles."
+        import _rubicon
+
+        class Thing(object):
+            pass
+
+        thing = Thing()
+        handle = _rubicon.new_handle(thing)
+        self.assertIs(_rubicon.resolve_handle(handle), thing)
+
+        # Once a handle is released, it is stale, even if its slot is
+        # reused by a new handle.
+        _rubicon.release_handle(handle)
+        self.assertRaises(KeyError, _rubicon.resolve_handle, handle)
+        self.assertRaises(KeyError, _rubicon.release_handle, handle)
+
+        other = Thing()
+        new_handle = _rubicon.new_handle(other)
+        self.assertNotEqual(new_handle, handle)
+        self.assertRaises(KeyError, _rubicon.resolve_handle, handle)
+        self.assertIs(_rubicon.resolve_handle(new_handle), other)
+        _rubicon.release_handle(new_handle)
+
+    def test_asynchronous_interface(self):
+        "Callbacks to an asynchronous interface implementation are run on a dispatcher thread."
+        IAsyncCallback = JavaInterface('org/pybee/rubicon/test/IAsyncCallback')
+
+        results = {}
+        recorded = threading.Event()
+
+        @asynchronous
+        class MyAsyncCallback(IAsyncCallback):
+            def record(self, value):
+                results['value'] = value
+                results['thread'] = threading.current_thread()
+                recorded.set()
+
+            def square(self, value):
+                return value * value
+
+        Example = JavaClass('org/pybee/rubicon/test/Example')
+        example = Example()
+        example.set_async_callback(MyAsyncCallback())
+
+        # A void method returns immediately, and runs on another thread.
+        example.test_record(42)
+        recorded.wait(10)
+        self.assertEqual(results['value'], 42)
+        self.assertIsNot(results['thread'], threading.current_thread())
+
+        # A method returning a Future is completed by the dispatcher.
+        self.assertEqual(example.test_square(7), 49)
+
+    def test_asynchronous_failures(self):
+        "An exception raised by a queued void callback is reported."
+        IAsyncCallback = JavaInterface('org/pybee/rubicon/test/IAsyncCallback')
+        IFailureHandler = JavaInterface('java/lang/Thread$UncaughtExceptionHandler')
+        PythonInstance = JavaClass('org/pybee/rubicon/PythonInstance')
+
+        failures = []
+        failed = threading.Event()
+
+        @asynchronous
+        class BrokenAsyncCallback(IAsyncCallback):
+            def record(self, value):
+                raise ValueError("Can't record %s" % value)
+
+            def square(self, value):
+                return value * value
+
+        class FailureHandler(IFailureHandler):
+            def uncaughtException(self, thread, exception):
+                failures.append(exception.toString())
+                failed.set()
+
+        Example = JavaClass('org/pybee/rubicon/test/Example')
+        PythonInstance.setFailureHandler(FailureHandler())
+        try:
+            example = Example()
+            example.set_async_callback(BrokenAsyncCallback())
+
+            example.test_record(42)
+            failed.wait(10)
+            self.assertEqual(len(failures), 1)
+            self.assertIn("ValueError: Can't record 42", failures[0])
+
+            # The dispatcher keeps running after a failure.
+            self.assertEqual(example.test_square(7), 49)
+        finally:
+            Example.reset_failure_handler()
+
+    def test_batched_interface(self):
+        "Calls to a void method of a batched interface implementation are delivered in batches."
+        IAsyncCallback = JavaInterface('org/pybee/rubicon/test/IAsyncCallback')
+
+        batches = []
+        delivered = threading.Event()
+
+        @batched(size=10, latency=0.5)
+        class MyBatchedCallback(IAsyncCallback):
+            def record(self, batch):
+                batches.append(batch)
+                if sum(len(b) for b in batches) == 25:
+                    delivered.set()
+
+            def square(self, value):
+                return value * value
+
+        Example = JavaClass('org/pybee/rubicon/test/Example')
+        example = Example()
+        example.set_async_callback(MyBatchedCallback())
+
+        # Two full batches are delivered immediately; the rest is
+        # delivered once the latency bound expires.
+        example.test_record_many(25)
+        delivered.wait(10)
+        self.assertEqual(batches[0], [(i,) for i in range(10)])
+        self.assertEqual([args for batch in batches for args in batch], [(i,) for i in range(25)])
+        self.assertEqual(len(batches), 3)
+
+    def test_batched_failures(self):
+        "An exception raised by a batched implementation is rethrown, or reported."
+        IAsyncCallback = JavaInterface('org/pybee/rubicon/test/IAsyncCallback')
+        IFailureHandler = JavaInterface('java/lang/Thread$UncaughtExceptionHandler')
+        PythonInstance = JavaClass('org/pybee/rubicon/PythonInstance')
+
+        failures = []
+        failed = threading.Event()
+
+        @batched(size=5, latency=0.1)
+        class BrokenBatchedCallback(IAsyncCallback):
+            def record(self, batch):
+                raise ValueError("Can't record %s calls" % len(batch))
+
+            def square(self, value):
+                return value * value
+
+        class FailureHandler(IFailureHandler):
+            def uncaughtException(self, thread, exception):
+                failures.append(exception.toString())
+                failed.set()
+
+        Example = JavaClass('org/pybee/rubicon/test/Example')
+        PythonInstance.setFailureHandler(FailureHandler())
+        try:
+            example = Example()
+            example.set_async_callback(BrokenBatchedCallback())
+
+            # A full batch is delivered on the calling thread, so the
+            # failure is rethrown to the caller...
+            with self.assertRaises(RuntimeError) as context:
+                example.test_record_many(5)
+            self.assertIn("ValueError: Can't record 5 calls", str(context.exception))
+
+            # ... but a batch delivered once the latency bound expires
+            # has no caller, so the failure is reported.
+            example.test_record_many(2)
+            failed.wait(10)
+            self.assertEqual(len(failures), 1)
+            self.assertIn("ValueError: Can't record 2 calls", failures[0])
+        finally:
+            Example.reset_failure_handler()
+
+    def test_interface_return_values(self):
+        "A Java interface implemented in Python can return values to Java."
+        ICalculator = JavaInterface('org/pybee/rubicon/test/ICalculator')
+        Thing = JavaClass('org/pybee/rubicon/test/Thing')
+
+        class MyCalculator(ICalculator):
+            def add(self, a, b):
+                return a + b
+
+            def scale(self, value, factor):
+                return value * factor
+
+            def is_even(self, value):
+                return value % 2 == 0
+
+            def describe(self, label, count):
+                return label * count
+
+            def choose(self, first, second):
+                return second
+
+            def length(self, value):
+                return len(value)
+
+        calculator = MyCalculator()
+
+        Example = JavaClass('org/pybee/rubicon/test/Example')
+        example = Example()
+        example.set_calculator(calculator)
+
+        self.assertEqual(example.test_add(37, 5), 42)
+        self.assertEqual(example.test_scale(1.5, 2.0), 3.0)
+        self.assertTrue(example.test_is_even(42))
+        self.assertFalse(example.test_is_even(37))
+        self.assertEqual(example.test_describe("Wagga", 2), "WaggaWagga")
+
+        first = Thing('This is thing', 1)
+        second = Thing('This is thing', 2)
+        self.assertEqual(example.test_choose(first, second).toString(), "This is thing 2")
+
+        # A value returned as a box class is boxed as the declared class.
+        self.assertEqual(example.test_length("Wagga").longValue(), 5)
+
+    def test_proxy_classes(self):
+        "A Java interface can be implemented in Python using a generated class."
+        ICalculator = JavaInterface('org/pybee/rubicon/test/ICalculator')
+        ICallback = JavaInterface('org/pybee/rubicon/test/ICallback')
+        Thing = JavaClass('org/pybee/rubicon/test/Thing')
+
+        results = {}
+
+        class MyCalculator(ICalculator):
+            def add(self, a, b):
+                return a + b
+
+            def scale(self, value, factor):
+                return value * factor
+
+            def is_even(self, value):
+                return value % 2 == 0
+
+            def describe(self, label, count):
+                return label * count
+
+            def choose(self, first, second):
+                return second
+
+        class MyCallback(ICallback):
+            def poke(self, example, value):
+                results['string'] = example.toString()
+                results['int'] = value
+
+            def peek(self, example, value):
+                results['int'] = value * 2
+
+        set_proxy_classes(True)
+        try:
+            calculator = MyCalculator()
+            callback = MyCallback()
+
+            Example = JavaClass('org/pybee/rubicon/test/Example')
+            example = Example()
+            example.set_calculator(calculator)
+            example.set_callback(callback)
+
+            # The implementations are not java.lang.reflect.Proxy instances.
+            with local_frame():
+                Proxy = java.FindClass(b'java/lang/reflect/Proxy')
+                self.assertFalse(java.IsInstanceOf(calculator._jni, Proxy))
+                self.assertFalse(java.IsInstanceOf(callback._jni, Proxy))
+
+            self.assertEqual(example.test_add(37, 5), 42)
+            self.assertEqual(example.test_scale(1.5, 2.0), 3.0)
+            self.assertTrue(example.test_is_even(42))
+            self.assertFalse(example.test_is_even(37))
+            self.assertEqual(example.test_describe("Wagga", 2), "WaggaWagga")
+
+            first = Thing('This is thing', 1)
+            second = Thing('This is thing', 2)
+            self.assertEqual(example.test_choose(first, second).toString(), "This is thing 2")
+
+            example.test_poke(37)
+            self.assertEqual(results['string'], 'This is a Java Example object')
+            self.assertEqual(results['int'], 37)
+
+            example.test_peek(21)
+            self.assertEqual(results['int'], 42)
+        finally:
+            set_proxy_classes(False)
+
+    def test_bind_native(self):
+        "A Java native method can be implemented in Python."
+        Example = JavaClass('org/pybee/rubicon/test/Example')
+
+        def native_add(a, b):
+            return a + b
+
+        def native_describe(example, label, separator):
+            return separator.join([example.toString(), label])
+
+        def native_flag(flag):
+            return repr(flag)
+
+        bind_native(Example, 'native_add', native_add)
+        bind_native(Example, 'native_describe', native_describe, signature='(Ljava/lang/String;C)Ljava/lang/String;')
+        bind_native(Example, 'native_flag', native_flag)
+        try:
+            example = Example()
+
+            # Java can invoke the native methods...
+            self.assertEqual(example.test_native_add(37, 5), 42)
+            self.assertEqual(example.test_native_describe("Wagga", ":"), "This is a Java Example object:Wagga")
+            self.assertEqual(example.test_native_flag(True), "True")
+            self.assertEqual(example.test_native_flag(False), "False")
+
+            # ... and so can Python.
+            self.assertEqual(Example.native_add(20, 22), 42)
+        finally:
+            unbind_natives(Example)
+
+        with self.assertRaises(ValueError):
+            bind_native(Example, 'no_such_method', native_add)
+
+    def test_method_exceptions(self):
+        "An exception thrown by a Java method is raised in Python as a RuntimeError."
+        import rubicon.java
+        from rubicon.java import JavaMethod, StaticJavaMethod
+        Example = JavaClass('org/pybee/rubicon/test/Example')
+        example = Example()
+
+        with self.assertRaises(RuntimeError) as context:
+            Example.fail_static("Wagga")
+        self.assertEqual(str(context.exception), 'java.lang.IllegalStateException: Wagga')
+
+        with self.assertRaises(RuntimeError) as context:
+            example.fail("Wagga")
+        self.assertEqual(str(context.exception), 'java.lang.IllegalStateException: Wagga')
+
+        # Without the native module, the ctypes bindings behave the same way,
+        # and don't leave the exception pending.
+        native = rubicon.java._rubicon
+        rubicon.java._rubicon = None
+        try:
+            fail_static = StaticJavaMethod(Example, 'fail_static')
+            fail = JavaMethod(Example, 'fail')
+        finally:
+            rubicon.java._rubicon = native
+        fail_static.add('Ljava/lang/String;', 'I')
+        fail.add('Ljava/lang/String;', 'I')
+
+        with self.assertRaises(RuntimeError) as context:
+            fail_static("Wagga")
+        self.assertEqual(str(context.exception), 'java.lang.IllegalStateException: Wagga')
+        self.assertFalse(java.ExceptionCheck())
+
+        with self.assertRaises(RuntimeError) as context:
+            fail(example, "Wagga")
+        self.assertEqual(str(context.exception), 'java.lang.IllegalStateException: Wagga')
+        self.assertFalse(java.ExceptionCheck())
+
+    def test_implementation_exceptions(self):
+        "An exception raised by a Python implementation is rethrown in Java."
+        ICalculator = JavaInterface('org/pybee/rubicon/test/ICalculator')
+        Example = JavaClass('org/pybee/rubicon/test/Example')
+
+        class BrokenCalculator(ICalculator):
+            def add(self, a, b):
+                raise ValueError("Can't add %s and %s" % (a, b))
+
+            def is_even(self, value):
+                return None
+
+        example = Example()
+        example.set_calculator(BrokenCalculator())
+        with self.assertRaises(RuntimeError) as context:
+            example.test_add(37, 5)
+        self.assertIn('java.lang.RuntimeException', str(context.exception))
+        self.assertIn("ValueError: Can't add 37 and 5", str(context.exception))
+
+        # A primitive result can't be missing.
+        with self.assertRaises(RuntimeError) as context:
+            example.test_is_even(42)
+        self.assertIn("TypeError: Interface method must return a 'Z' value, not None", str(context.exception))
+
+        set_proxy_classes(True)
+        try:
+            example = Example()
+            example.set_calculator(BrokenCalculator())
+            with self.assertRaises(RuntimeError) as context:
+                example.test_add(37, 5)
+            self.assertIn('java.lang.RuntimeException', str(context.exception))
+            self.assertIn("ValueError: Can't add 37 and 5", str(context.exception))
+        finally:
+            set_proxy_classes(False)
+
+        def native_add(a, b):
+            raise ValueError("Can't add %s and %s" % (a, b))
+
+        bind_native(Example, 'native_add', native_add)
+        try:
+            with self.assertRaises(RuntimeError) as context:
+                Example().test_native_add(37, 5)
+            self.assertIn('java.lang.RuntimeException', str(context.exception))
+            self.assertIn("ValueError: Can't add 37 and 5", str(context.exception))
+        finally:
+            unbind_natives(Example)
+
+    def test_non_blocking_methods(self):
+        "Java methods can be declared non-blocking."
+        Example = JavaClass('org/pybee/rubicon/test/Example')
+        example = Example()
+
+        # Use a method before it is declared non-blocking...
+        self.assertEqual(Example.tripler(14), 42)
+
+        set_blocking(Example, False, 'toString')
+        set_blocking(Example, False)
+        try:
+            # ... and after.
+            self.assertEqual(Example.tripler(14), 42)
+            self.assertEqual(Example.tripler("Wagga"), "WaggaWaggaWagga")
+            self.assertEqual(example.toString(), "This is a Java Example object")
+
+            # A method declared individually isn't affected by the class.
+            set_blocking(Example, True)
+            self.assertEqual(example.toString(), "This is a Java Example object")
+            self.assertEqual(Example.tripler(14), 42)
+        finally:
+            set_blocking(Example, True, 'toString')
+
+    def test_gil_policy(self):
+        "The GIL is released while a Java method runs, unless the method is non-blocking."
+        Example = JavaClass('org/pybee/rubicon/test/Example')
+
+        counter = [0]
+        stop = threading.Event()
+
+        def count():
+            while not stop.is_set():
+                counter[0] += 1
+
+        thread = threading.Thread(target=count)
+        thread.start()
+        try:
+            while counter[0] == 0:
+                stop.wait(0.001)
+
+            # Other Python threads run while a blocking method runs...
+            before = counter[0]
+            Example.spin(200)
+            self.assertGreater(counter[0] - before, 10000)
+
+            # ... but not while a non-blocking method runs. A thread switch
+            # can happen just before the call, so allow a few iterations.
+            set_blocking(Example, False, 'spin')
+            try:
+                before = counter[0]
+                Example.spin(200)
+                if gil_policy == GIL_RELEASE_ALWAYS:
+                    self.assertGreater(counter[0] - before, 10000)
+                else:
+                    self.assertLess(counter[0] - before, 1000)
+            finally:
+                set_blocking(Example, True, 'spin')
+        finally:
+            stop.set()
+            thread.join()
+
     def test_alternatives(self):
         "A class is aware of it's type heirarchy"
         Example = JavaClass('org/pybee/rubicon/test/Example')
 
         self.assertEqual(
-            Example.__dict__['_alternates'],
+            Example._alternates,
             [
                 "Lorg/pybee/rubicon/test/Example;",
                 "Lorg/pybee/rubicon/test/BaseExample;",
@@ -348,7 +1110,7 @@ class JNITest(TestCase):
 
         AbstractCallback = JavaClass('org/pybee/rubicon/test/AbstractCallback')
         self.assertEqual(
-            AbstractCallback.__dict__['_alternates'],
+            AbstractCallback._alternates,
             [
                 "Lorg/pybee/rubicon/test/AbstractCallback;",
                 "Lorg/pybee/rubicon/test/ICallback;",
@@ -358,7 +1120,7 @@ class JNITest(TestCase):
         String = JavaClass('java/lang/String')
 
         self.assertEqual(
-            String.__dict__['_alternates'],
+            String._alternates,
             [
                 "Ljava/lang/String;",
                 "Ljava/io/Serializable;",
@@ -367,6 +1129,22 @@ class JNITest(TestCase):
                 "Ljava/lang/Object;",
             ])
 
+    def test_assignable_arguments(self):
+        "A Java object can be passed as any type it can be assigned to."
+        ArrayList = JavaClass('java/util/ArrayList')
+
+        source = ArrayList()
+        source.add("Wagga")
+
+        # addAll() takes a Collection, which ArrayList only implements
+        # by way of its superclasses and interfaces.
+        target = ArrayList()
+        target.addAll(source)
+        target.addAll(0, source)
+
+        self.assertEqual(target.size(), 2)
+        self.assertEqual(target.toString(), "[Wagga, Wagga]")
+
     def test_inner(self):
         "Inner classes can be accessed"
 